@@ -0,0 +1,60 @@
+#!/bin/sh
+# Measures how batch mode scales: compiles a skewed corpus with 1 to N threads
+# (HoPiler --jobs) and prints the makespan (median wall-clock seconds of the whole
+# batch) and parallel efficiency (time on 1 thread / (threads * time)) of each.
+# The corpus is one large program, a few medium ones and many small ones (sizes
+# fall off as 1/rank), with the large one named last, the worst place for a FIFO
+# order. With a history file, every row is also appended to it as CSV
+# (date,revision,threads,seconds,efficiency) so scaling can be tracked over time.
+#
+# Usage: programTest/bench/batch.sh [path/to/HoPiler] [max threads] [history.csv]
+# CMake runs this as the bench-batch target.
+
+hopiler=${1:-build/HoPiler}
+threads=${2:-$(nproc)}
+history=$3
+repeats=5
+work=$(mktemp -d) || exit 1
+trap 'rm -rf "$work"' EXIT
+revision=$(git -C "$(dirname "$0")" rev-parse --short HEAD 2>/dev/null || echo unknown)
+
+# program of about $2 statements: declarations, arithmetic, branches, loops and strings
+program() {
+    awk -v seed="$1" -v size="$2" 'BEGIN {
+        print "int a = " seed
+        print "string s = \"x\""
+        for (i = 0; i < size / 8; i++) {
+            printf "int v%d = ( a + %d ) * ( %d - a ) %% 97\n", i, i, i + seed
+            printf "if ( v%d > a ) {\n    a += 1\n} else {\n    s = s + \"y\"\n}\n", i
+            printf "while ( a > %d ) {\n    a -= 3\n}\n", i + 50
+        }
+        print "return a % 256"
+    }'
+}
+
+for rank in $(seq 2 40); do
+    program $rank $((48000 / rank)) > "$work/small$rank.ho"
+done
+program 1 48000 > "$work/zlarge.ho"
+
+makespan() {
+    for run in $(seq $repeats); do
+        start=$(date +%s.%N)
+        "$hopiler" --jobs "$1" "$work"/*.ho > /dev/null || exit 1
+        end=$(date +%s.%N)
+        awk "BEGIN { print $end - $start }"
+    done | sort -n | awk '{ times[NR] = $1 } END { print (NR % 2) ? times[(NR + 1) / 2] : (times[NR / 2] + times[NR / 2 + 1]) / 2 }'
+}
+
+echo "$(ls "$work" | wc -l) files, $(cat "$work"/*.ho | wc -l) lines; largest $(wc -l < "$work/zlarge.ho")"
+printf '%7s %9s %10s\n' threads seconds efficiency
+single=
+for count in $(seq "$threads"); do
+    seconds=$(makespan "$count")
+    [ -z "$seconds" ] && exit 1
+    [ -z "$single" ] && single=$seconds
+    efficiency=$(awk "BEGIN { printf \"%.2f\", $single / ($count * $seconds) }")
+    printf '%7d %9.3f %10s\n' "$count" "$seconds" "$efficiency"
+    [ -n "$history" ] && echo "$(date +%Y-%m-%d),$revision,$count,$seconds,$efficiency" >> "$history"
+done
+exit 0
@@ -0,0 +1,49 @@
+#!/bin/sh
+# Compares the execution engines on the benchmark programs:
+#   tree      HoPiler --run                     (tree walking Interpreter)
+#   closures  HoPiler --run --engine closures   (ClosureCompiler)
+#   tiered    HoPiler --run --tiered            (Interpreter plus native hot loops)
+#   native    the generated C built with $CC -O2
+# Every engine must agree on the exit status; the table shows wall-clock seconds.
+#
+# Usage: programTest/bench/engines.sh [path/to/HoPiler] [programs.ho...]
+
+hopiler=${1:-build/HoPiler}
+[ $# -gt 0 ] && shift
+[ $# -eq 0 ] && set -- "$(dirname "$0")"/*.ho
+work=$(mktemp -d) || exit 1
+trap 'rm -rf "$work"' EXIT
+
+seconds() {
+    start=$(date +%s.%N)
+    "$@" > /dev/null 2>&1
+    status=$?
+    end=$(date +%s.%N)
+    elapsed=$(awk "BEGIN { print $end - $start }")
+}
+
+printf '%-14s %9s %9s %9s %9s\n' program tree closures tiered native
+failed=0
+for program in "$@"; do
+    cp "$program" "$work/program.ho"
+    "$hopiler" "$work/program.ho" > /dev/null && ${CC:-cc} -O2 -fwrapv -o "$work/program" "$work/program.c" -lm || exit 1
+
+    row=$(basename "$program" .ho)
+    expected=
+    for engine in tree closures tiered native; do
+        case $engine in
+        tree) seconds "$hopiler" --run "$program" ;;
+        closures) seconds "$hopiler" --run --engine closures "$program" ;;
+        tiered) seconds "$hopiler" --run --tiered "$program" ;;
+        native) seconds "$work/program" ;;
+        esac
+        [ -z "$expected" ] && expected=$status
+        if [ "$status" != "$expected" ]; then
+            echo "$row: $engine exited with $status, tree with $expected" >&2
+            failed=1
+        fi
+        row="$row $elapsed"
+    done
+    printf '%-14s %9.3f %9.3f %9.3f %9.3f\n' $row
+done
+exit $failed
@@ -0,0 +1,98 @@
+#!/bin/sh
+# Builds HoPiler with profile guided optimization and link time optimization:
+#   1. a plain -O2 build, the baseline
+#   2. an instrumented build (-fprofile-generate), run over a synthetic corpus
+#   3. the release build (-fprofile-use -flto) from the profile it wrote
+# then times the baseline and the release build on the corpus and prints the
+# speedup. The corpus mixes lexer-heavy (comments, long literals), parser-heavy
+# (nested expressions and statements) and emit-heavy (string building, branch
+# chains) programs; they are compiled as one batch, without the token dump.
+#
+# Usage: programTest/bench/pgo.sh [output binary] [repeats]
+# Uses $CXX (default c++), which must be GCC (Clang would need llvm-profdata).
+# CMake runs this as the HoPiler-pgo target.
+
+root=$(cd "$(dirname "$0")/../.." && pwd)
+output=${1:-HoPiler-pgo}
+repeats=${2:-5}
+cxx=${CXX:-c++}
+work=$(mktemp -d) || exit 1
+trap 'rm -rf "$work"' EXIT
+flags="-std=c++20 -O2"
+libraries="-lpthread -ldl"
+
+# lexer-heavy: mostly comments and long literals, few tokens per byte
+lexer() {
+    awk -v seed="$1" 'BEGIN {
+        for (i = 0; i < 4000; i++) {
+            print "# " i " lexer corpus line with words, numbers 12345 and punctuation; seed " seed
+            printf "string s%d = \"literal %d with enough text to make the scanner work through it, seed %d\"\n", i, i, seed
+            printf "char c%d = %c%c%c\n", i, 39, 97 + (i + seed) % 26, 39
+        }
+        print "return 0"
+    }'
+}
+
+# parser-heavy: deep expressions and nested statements, many tokens per line
+parser() {
+    awk -v seed="$1" 'BEGIN {
+        print "int a = " seed
+        for (i = 0; i < 2000; i++) {
+            printf "int v%d = ( ( a + %d ) * ( %d - a ) ) / ( %d + 1 ) + ( a %% 7 ) * ( ( %d * a ) - ( a + %d ) )\n", i, i, i + seed, i % 5, i % 11, i % 13
+            printf "if ( v%d > a && ( a < %d || v%d == %d ) ) {\n    while ( a > %d ) {\n        a -= 1\n    }\n} else {\n    a = a + ( v%d %% 3 )\n}\n", i, i, i, seed, i + 100, i
+        }
+        print "return a % 256"
+    }'
+}
+
+# emit-heavy: string building and branch chains, much C per statement
+emit() {
+    awk -v seed="$1" 'BEGIN {
+        print "string s = \"start\""
+        print "int n = " seed
+        for (i = 0; i < 2000; i++) {
+            printf "string t%d = s + \" part %d \" + s\n", i, i
+            printf "if ( n %% 4 == 0 ) {\n    s = t%d + \"a\"\n} elif ( n %% 4 == 1 ) {\n    s = \"b\" + t%d\n} elif ( n %% 4 == 2 ) {\n    n += %d\n} else {\n    s = \"c\"\n}\n", i, i, i
+            printf "for ( int k%d = 0 ) ( k%d < 2 ) ( k%d += 1 ) {\n    n = n + k%d\n}\n", i, i, i, i
+        }
+        print "return n % 256"
+    }'
+}
+
+mkdir -p "$work/corpus" "$work/profile"
+for seed in 1 2 3; do
+    lexer $seed > "$work/corpus/lexer$seed.ho"
+    parser $seed > "$work/corpus/parser$seed.ho"
+    emit $seed > "$work/corpus/emit$seed.ho"
+done
+
+compile() {
+    echo "Building $1" >&2
+    shift
+    $cxx $flags "$@" -o "$work/build" "$root/src/main.cpp" $libraries || exit 1
+}
+
+compile "-O2 baseline" && mv "$work/build" "$work/baseline"
+compile "instrumented" -fprofile-generate -fprofile-update=atomic -fprofile-dir="$work/profile" -flto=auto && mv "$work/build" "$work/instrumented"
+echo "Training on $(ls "$work/corpus" | wc -l) corpus files" >&2
+"$work/instrumented" "$work"/corpus/*.ho > /dev/null || exit 1
+compile "with profile and LTO" -fprofile-use -fprofile-dir="$work/profile" -fprofile-partial-training -Wno-missing-profile -flto=auto && mv "$work/build" "$work/release"
+
+# median of $repeats wall-clock times of compiling the corpus
+timing() {
+    for run in $(seq "$repeats"); do
+        start=$(date +%s.%N)
+        "$1" "$work"/corpus/*.ho > /dev/null || exit 1
+        end=$(date +%s.%N)
+        awk "BEGIN { print $end - $start }"
+    done | sort -n | awk '{ times[NR] = $1 } END { print (NR % 2) ? times[(NR + 1) / 2] : (times[NR / 2] + times[NR / 2 + 1]) / 2 }'
+}
+
+baseline=$(timing "$work/baseline")
+release=$(timing "$work/release")
+cp "$work/release" "$output" || exit 1
+awk -v baseline="$baseline" -v release="$release" -v output="$output" 'BEGIN {
+    printf "-O2:         %.3f s\n", baseline
+    printf "PGO and LTO: %.3f s (%.2fx)\n", release, baseline / release
+    printf "Wrote %s\n", output
+}'
@@ -0,0 +1,333 @@
+/**
+ * @file batch.hpp
+ * @brief Batch mode for the HoPiler transpiler
+ * 
+ * The BatchCompiler class runs the transpilation pipeline over several source files
+ * in one invocation. Inputs are hashed up front so that byte-identical files (which
+ * our generators produce a lot of under different names) go through the pipeline
+ * only once; the result is then shared by every file with that content. The
+ * distinct inputs are compiled on a pool of threads, largest first.
+ * 
+ * @author HoPiler Project
+ */
+
+#pragma once
+
+#include "codegen.hpp"
+#include "parser.hpp"
+#include "rewriter.hpp"
+#include "tokenizer.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+/**
+ * @class BatchCompiler
+ * @brief Transpiles a list of source files, deduplicating identical contents
+ * 
+ * Algorithm:
+ * 1. Every input file is read once and its content is hashed (64-bit FNV-1a)
+ * 2. Files are grouped by hash; a group only accepts a file whose bytes really are
+ *    equal to the group's first file, so hash collisions cannot merge different inputs
+ * 3. Each group is tokenized, parsed, rewritten and turned into C once, using the
+ *    content already in memory
+ * 4. The resulting tree and C program are fanned out to every file of the group
+ * 
+ * Groups are independent, so step 3 and 4 run on several threads. A group's cost
+ * grows with its size, and in a FIFO order the largest input can start last and
+ * leave one thread working alone at the end. Groups are therefore dealt out
+ * largest first, round robin, into one queue per thread. A thread takes the
+ * largest group from its own queue and, once that is empty, steals the largest
+ * one left in another queue, so every thread keeps working on the largest
+ * remaining input and the small groups fill the gaps at the end.
+ * 
+ * The only file specific parts of the generated C are its header comment and the
+ * profile path of an instrumented build; CodeGenerator::getCode() fills those in
+ * per file from the program generated once for the group.
+ * 
+ * Example:
+ * ```
+ * BatchCompiler batch({ "a.ho", "b.ho", "copyOfA.ho" });
+ * batch.run(); // tokenizes and parses 2 distinct inputs, not 3
+ * ```
+ * 
+ * @see Tokenizer
+ * @see Parser
+ */
+class BatchCompiler {
+private:
+    /**
+     * @struct Unit
+     * @brief One distinct source content and the files that share it
+     */
+    struct Unit {
+        uint64_t hash = 0;
+        string sourceCode;
+        vector<int> files; // indices into fileNames, first one is the representative
+        bool compiled = false;
+        string error;
+    };
+
+    vector<string> fileNames;
+    vector<Unit> units;
+    vector<int> unitOfFile; // unit index for each entry of fileNames
+    vector<ExpressionNode> results; // one tree per file, filled by run()
+    CodegenOptions options;
+    int threads;
+
+    /**
+     * @struct WorkQueue
+     * @brief Units of one worker, largest first; the owner and thieves both take from the front
+     */
+    struct WorkQueue {
+        mutex lock;
+        deque<int> units;
+    };
+
+    /**
+     * @brief Reads a source file into memory
+     * 
+     * @param fileName Path of the file to read
+     * @return The complete file contents
+     * @throws invalid_argument if the file cannot be opened
+     */
+    string readFile(string fileName)
+    {
+        ifstream fileStream(fileName);
+        if (!fileStream.is_open())
+            throw invalid_argument("Could not open source file " + fileName);
+        stringstream content;
+        content << fileStream.rdbuf();
+        return content.str();
+    }
+
+    /**
+     * @brief Reads and hashes every input, grouping identical contents into units
+     * 
+     * Groups are looked up by hash first; within a hash bucket the content is
+     * compared byte by byte before a file joins an existing unit. A file that
+     * cannot be read gets a unit of its own that already holds the error.
+     */
+    void groupInputs()
+    {
+        unordered_map<uint64_t, vector<int>> unitsByHash;
+
+        for (int i = 0; i < (int)fileNames.size(); i++) {
+            string content;
+            try {
+                content = readFile(fileNames[i]);
+            } catch (const std::exception& e) {
+                Unit unit;
+                unit.files.push_back(i);
+                unit.error = e.what();
+                unitOfFile.push_back(units.size());
+                units.push_back(std::move(unit));
+                continue;
+            }
+            uint64_t hash = hashContent(content);
+
+            int unitIndex = -1;
+            for (int candidate : unitsByHash[hash]) {
+                if (units[candidate].sourceCode == content) {
+                    unitIndex = candidate;
+                    break;
+                }
+            } // only byte-identical files share a unit, a bare hash match is not enough
+
+            if (unitIndex == -1) {
+                unitIndex = units.size();
+                Unit unit;
+                unit.hash = hash;
+                unit.sourceCode = std::move(content);
+                units.push_back(std::move(unit));
+                unitsByHash[hash].push_back(unitIndex);
+            }
+            units[unitIndex].files.push_back(i);
+            unitOfFile.push_back(unitIndex);
+        }
+    }
+
+    /**
+     * @brief Runs the pipeline on one unit and fans the result out to its files
+     * 
+     * Failures are recorded in the unit; nothing else is shared between units.
+     */
+    void compileUnit(Unit& unit)
+    {
+        string representative = fileNames[unit.files.front()];
+        try {
+            Tokenizer tokenizer = Tokenizer::fromSource(representative, unit.sourceCode, false);
+            Parser parser(tokenizer.getTokens(), false);
+            ExpressionNode tree = parser.getTree();
+            Rewriter().rewrite(tree);
+            CodeGenerator generator(tree, options);
+            for (int file : unit.files) {
+                generator.write(fileNames[file]);
+                results[file] = tree;
+            }
+            unit.compiled = true;
+        } catch (const std::exception& e) {
+            unit.error = e.what();
+        }
+    }
+
+    /// @brief Takes the next unit for a worker: its own largest, else another queue's largest; -1 when all are taken
+    static int nextUnit(vector<unique_ptr<WorkQueue>>& queues, int worker)
+    {
+        {
+            WorkQueue& own = *queues[worker];
+            lock_guard<mutex> guard(own.lock);
+            if (!own.units.empty()) {
+                int unit = own.units.front();
+                own.units.pop_front();
+                return unit;
+            }
+        }
+        for (size_t i = 1; i < queues.size(); i++) {
+            WorkQueue& victim = *queues[(worker + i) % queues.size()];
+            lock_guard<mutex> guard(victim.lock);
+            if (!victim.units.empty()) {
+                int unit = victim.units.front();
+                victim.units.pop_front();
+                return unit;
+            }
+        }
+        return -1; // no unit is ever added, so empty queues stay empty
+    }
+
+public:
+    /**
+     * @brief Hashes a buffer with 64-bit FNV-1a
+     * 
+     * @param content The bytes to hash
+     * @return The 64-bit hash value
+     * 
+     * FNV-1a is used because it is tiny, has no dependencies and is good enough
+     * to bucket inputs; equality is always confirmed by comparing the bytes.
+     */
+    static uint64_t hashContent(const string& content)
+    {
+        uint64_t hash = 14695981039346656037ULL;
+        for (unsigned char c : content) {
+            hash ^= c;
+            hash *= 1099511628211ULL;
+        }
+        return hash;
+    }
+
+    /**
+     * @brief Constructor - reads and groups all input files
+     * 
+     * @param fileNames Paths of the HoPiler source files to transpile
+     * @param options Code generation switches, shared by every file
+     * @param threads Number of worker threads for run(), at least 1
+     *
+     * Files that cannot be read are not an error here; run() fails them.
+     */
+    BatchCompiler(vector<string> fileNames, CodegenOptions options = {}, int threads = 1)
+        : fileNames(fileNames)
+        , options(options)
+        , threads(max(threads, 1))
+    {
+        groupInputs();
+    }
+
+    /**
+     * @brief Runs the pipeline once per distinct input and fans out the results
+     * 
+     * @return true if every input was transpiled successfully, false otherwise
+     * 
+     * Errors are reported once per unit and attributed to every file in it. A failing
+     * unit does not stop the remaining ones from being compiled. Units are compiled
+     * on the worker threads, largest first (see the class comment).
+     */
+    bool run()
+    {
+        results.assign(fileNames.size(), ExpressionNode(Token()));
+
+        vector<int> order;
+        for (size_t i = 0; i < units.size(); i++)
+            if (units[i].error.empty())
+                order.push_back(i); // unreadable files already failed
+        stable_sort(order.begin(), order.end(), [&](int a, int b) { return units[a].sourceCode.size() > units[b].sourceCode.size(); });
+        int workers = min<int>(threads, order.size());
+        vector<unique_ptr<WorkQueue>> queues;
+        for (int i = 0; i < workers; i++)
+            queues.push_back(make_unique<WorkQueue>());
+        for (size_t i = 0; i < order.size(); i++)
+            queues[i % workers]->units.push_back(order[i]);
+
+        auto work = [&](int worker) {
+            for (int unit = nextUnit(queues, worker); unit >= 0; unit = nextUnit(queues, worker))
+                compileUnit(units[unit]);
+        };
+        vector<thread> pool;
+        for (int i = 1; i < workers; i++)
+            pool.emplace_back(work, i);
+        if (workers > 0)
+            work(0); // the calling thread is worker 0
+        for (thread& worker : pool)
+            worker.join();
+
+        bool success = true;
+        for (Unit& unit : units)
+            success = success && unit.compiled;
+        return success;
+    }
+
+    /**
+     * @brief Gets the transpiled tree of one input file
+     * 
+     * @param file Index of the file in the list given to the constructor
+     * @return The root of the file's AST (shared with identical files)
+     */
+    ExpressionNode getTree(int file)
+    {
+        return results.at(file);
+    }
+
+    /// @brief Gets the number of distinct inputs that were transpiled; unreadable and failed ones do not count
+    int getDistinctCount()
+    {
+        return count_if(units.begin(), units.end(), [](const Unit& unit) { return unit.compiled; });
+    }
+
+    /**
+     * @brief Prints one line per input file and a deduplication summary
+     * 
+     * Output example:
+     * ```
+     * a.ho: ok
+     * copyOfA.ho: ok (identical to a.ho)
+     * 3 files, 2 distinct inputs transpiled
+     * ```
+     *
+     * Inputs that could not be read or failed are added as ", N failed".
+     */
+    void printSummary()
+    {
+        for (int i = 0; i < (int)fileNames.size(); i++) {
+            Unit& unit = units[unitOfFile[i]];
+            cout << fileNames[i] << ": " << (unit.compiled ? "ok" : "failed (" + unit.error + ")");
+            if (unit.files.front() != i)
+                cout << " (identical to " << fileNames[unit.files.front()] << ")";
+            cout << endl;
+        }
+        int transpiled = getDistinctCount();
+        cout << fileNames.size() << " files, " << transpiled << " distinct inputs transpiled";
+        if (transpiled < (int)units.size())
+            cout << ", " << units.size() - transpiled << " failed";
+        cout << endl;
+    }
+};
@@ -0,0 +1,403 @@
+/**
+ * @file bench.hpp
+ * @brief Benchmark runner for compiled HoLang programs (--bench)
+ *
+ * The program's C is built with $CC (or cc) -O2 and run a number of times after
+ * some warmup runs. Every run is pinned to one CPU and counted with
+ * perf_event_open: CPU time (the task clock) and user-space instructions and
+ * cycles, enabled at exec so the runner's own fork and wait are not counted. The
+ * report gives the median and the median absolute deviation (MAD) of each,
+ * which unlike the mean and standard deviation are not thrown off by the odd
+ * disturbed run. Results also go to <source>.bench.json:
+ *
+ * ```
+ * {
+ *   "source": "loop.ho",
+ *   "c_bytes": 4817,
+ *   "c_hash": "9f2c4e01a7d35b68",
+ *   "compiler": "cc -O2 -fwrapv",
+ *   "cpu": 3,
+ *   "warmup": 2,
+ *   "exit_status": 58,
+ *   "wall_seconds": { "median": 0.0123, "mad": 0.0001, "runs": [ ... ] },
+ *   "cpu_seconds": { "median": 0.0118, "mad": 0.0001, "runs": [ ... ] },
+ *   "instructions": { "median": 61234567, "mad": 12, "runs": [ ... ] },
+ *   "cycles": { "median": 40123456, "mad": 2345, "runs": [ ... ] }
+ * }
+ * ```
+ *
+ * c_hash is the FNV-1a hash of the generated C, so comparing two files tells
+ * whether a HoPiler change touched the code at all. Counters that the kernel does
+ * not allow (see /proc/sys/kernel/perf_event_paranoid) or the machine does not
+ * have (virtual machines often lack hardware counters) are written as null.
+ *
+ * @author HoPiler Project
+ */
+
+#pragma once
+
+#include "batch.hpp"
+#include "native.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <linux/perf_event.h>
+#include <sched.h>
+#include <stdexcept>
+#include <string>
+#include <sys/syscall.h>
+#include <vector>
+
+using namespace std;
+
+/**
+ * @class PerfCounter
+ * @brief One perf_event_open counter of user-space events
+ *
+ * Either attached to a child that has yet to exec, counting from the exec on
+ * (Benchmark), or counting the calling thread from construction on, e.g. around
+ * the parse (--parse-stats). A counter the kernel refuses reads as -1.
+ *
+ * Example:
+ * ```
+ * PerfCounter misses(0, PERF_TYPE_HW_CACHE, PerfCounter::dtlbReadMisses, false);
+ * parse();
+ * double count = misses.read();
+ * ```
+ */
+class PerfCounter {
+private:
+    int counter = -1;
+
+public:
+    /// @brief Event of PERF_TYPE_HW_CACHE: data TLB misses on loads
+    static constexpr uint64_t dtlbReadMisses = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+
+    /**
+     * @brief Constructor - opens the counter
+     *
+     * @param process The process to count, 0 for the calling thread
+     * @param type A PERF_TYPE_* constant
+     * @param event The event of that type
+     * @param onExec Start counting when process execs instead of right away
+     */
+    PerfCounter(pid_t process, uint32_t type, uint64_t event, bool onExec)
+    {
+        perf_event_attr attributes;
+        memset(&attributes, 0, sizeof(attributes));
+        attributes.type = type;
+        attributes.size = sizeof(attributes);
+        attributes.config = event;
+        attributes.disabled = onExec;
+        attributes.enable_on_exec = onExec;
+        attributes.exclude_kernel = 1;
+        attributes.exclude_hv = 1;
+        counter = syscall(SYS_perf_event_open, &attributes, process, -1, -1, PERF_FLAG_FD_CLOEXEC);
+    }
+
+    PerfCounter(const PerfCounter&) = delete;
+    PerfCounter& operator=(const PerfCounter&) = delete;
+
+    ~PerfCounter()
+    {
+        if (counter >= 0)
+            close(counter);
+    }
+
+    /// @brief Gets the count so far, or -1 if the counter could not be opened or read
+    double read()
+    {
+        uint64_t value = 0;
+        if (counter < 0 || ::read(counter, &value, sizeof(value)) != sizeof(value))
+            return -1;
+        return value;
+    }
+};
+
+/**
+ * @class Benchmark
+ * @brief Builds a generated C program once and times repeated runs of it
+ *
+ * A run forks a child that waits on a pipe; the parent attaches the counters to
+ * the child, releases it and waits. The child pins itself, sends its stdout to
+ * /dev/null and execs the program. The wall time runs from the release to the
+ * child's exit, so it includes the exec (a fixed cost of well under a
+ * millisecond). Every run must end with the same exit status.
+ *
+ * Example:
+ * ```
+ * Benchmark bench("loop.ho", generator.getCode("loop.ho"));
+ * bench.run(10, 2);
+ * bench.print(cout);
+ * bench.writeJson("loop.ho.bench.json");
+ * ```
+ */
+class Benchmark {
+private:
+    /**
+     * @struct Series
+     * @brief One measurement over all runs
+     */
+    struct Series {
+        vector<double> runs;
+        bool available = true;
+
+        static double median(vector<double> values)
+        {
+            sort(values.begin(), values.end());
+            size_t middle = values.size() / 2;
+            return values.size() % 2 ? values[middle] : (values[middle - 1] + values[middle]) / 2;
+        }
+
+        double median() const
+        {
+            return median(runs);
+        }
+
+        /// @brief Gets the median absolute deviation from the median
+        double mad() const
+        {
+            double center = median();
+            vector<double> deviations;
+            for (double value : runs)
+                deviations.push_back(fabs(value - center));
+            return median(deviations);
+        }
+    };
+
+    string sourceName;
+    string code;
+    int cpu = -1;
+    int warmup = 0;
+    int exitStatus = -1;
+    Series wallSeconds, cpuSeconds, instructions, cycles;
+
+    /// @brief Gets the last CPU this process may run on, which is usually the least busy one
+    static int defaultCpu()
+    {
+        cpu_set_t allowed;
+        if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+            return 0;
+        for (int i = CPU_SETSIZE - 1; i > 0; i--)
+            if (CPU_ISSET(i, &allowed))
+                return i;
+        return 0;
+    }
+
+    /**
+     * @brief Runs the program once
+     *
+     * The child says on a second pipe when it could not pin itself, so that an exit
+     * status of 126 from the program itself is not mistaken for that.
+     *
+     * @return The exit status, with the measurements added to the series if record is set
+     * @throws runtime_error if the program cannot be pinned or started, or is killed by a signal
+     */
+    int runOnce(const string& program, bool record)
+    {
+        int gate[2], pinning[2];
+        if (pipe2(gate, O_CLOEXEC) != 0)
+            throw runtime_error("Could not create a pipe for the benchmark");
+        if (pipe2(pinning, O_CLOEXEC) != 0) {
+            close(gate[0]);
+            close(gate[1]);
+            throw runtime_error("Could not create a pipe for the benchmark");
+        }
+        pid_t child = fork();
+        if (child < 0)
+            throw runtime_error("Could not start " + program);
+        if (child == 0) {
+            close(gate[1]);
+            close(pinning[0]);
+            char go;
+            if (read(gate[0], &go, 1) != 1)
+                _exit(127);
+            cpu_set_t pinned;
+            CPU_ZERO(&pinned);
+            CPU_SET(cpu, &pinned);
+            if (sched_setaffinity(0, sizeof(pinned), &pinned) != 0) {
+                (void)!write(pinning[1], "x", 1);
+                _exit(126);
+            }
+            int null = open("/dev/null", O_WRONLY);
+            dup2(null, STDOUT_FILENO);
+            execl(program.c_str(), program.c_str(), (char*)nullptr);
+            _exit(127);
+        } // only async-signal-safe calls between fork and exec
+        close(gate[0]);
+        close(pinning[1]);
+
+        PerfCounter clockCounter(child, PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK, true);
+        PerfCounter instructionCounter(child, PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, true);
+        PerfCounter cycleCounter(child, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, true);
+        auto start = chrono::steady_clock::now();
+        bool released = write(gate[1], "x", 1) == 1;
+        close(gate[1]);
+        int status = -1;
+        while (waitpid(child, &status, 0) < 0)
+            if (errno != EINTR)
+                break;
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        double clockNanoseconds = clockCounter.read();
+        double instructionCount = instructionCounter.read(), cycleCount = cycleCounter.read();
+        char failed;
+        bool unpinned = read(pinning[0], &failed, 1) == 1; // the write end is closed by the exec or the exit
+        close(pinning[0]);
+
+        if (unpinned)
+            throw runtime_error("cannot pin to CPU " + to_string(cpu));
+        if (!released || !WIFEXITED(status))
+            throw runtime_error(program + " did not run to completion");
+        if (record) {
+            wallSeconds.runs.push_back(seconds);
+            cpuSeconds.available = cpuSeconds.available && clockNanoseconds >= 0;
+            cpuSeconds.runs.push_back(clockNanoseconds / 1e9);
+            instructions.available = instructions.available && instructionCount >= 0;
+            instructions.runs.push_back(instructionCount);
+            cycles.available = cycles.available && cycleCount >= 0;
+            cycles.runs.push_back(cycleCount);
+        }
+        return WEXITSTATUS(status);
+    }
+
+    static void writeSeries(ostream& out, string name, const Series& series, bool last)
+    {
+        out << "  \"" << name << "\": ";
+        if (!series.available) {
+            out << "null" << (last ? "\n" : ",\n");
+            return;
+        }
+        char number[32];
+        snprintf(number, sizeof(number), "%.9g", series.median());
+        out << "{ \"median\": " << number;
+        snprintf(number, sizeof(number), "%.9g", series.mad());
+        out << ", \"mad\": " << number << ", \"runs\": [";
+        for (size_t i = 0; i < series.runs.size(); i++) {
+            snprintf(number, sizeof(number), "%.9g", series.runs[i]);
+            out << (i ? ", " : " ") << number;
+        }
+        out << " ] }" << (last ? "\n" : ",\n");
+    }
+
+    static string jsonString(const string& text)
+    {
+        string quoted = "\"";
+        for (char c : text) {
+            if (c == '"' || c == '\\')
+                quoted += '\\';
+            if ((unsigned char)c < 0x20) {
+                char escaped[8];
+                snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                quoted += escaped;
+                continue;
+            }
+            quoted += c;
+        }
+        return quoted + "\"";
+    }
+
+public:
+    /// @brief Checks whether this process may run on a CPU, so a benchmark can be pinned to it
+    static bool isAllowedCpu(int cpu)
+    {
+        cpu_set_t allowed;
+        if (cpu < 0 || cpu >= CPU_SETSIZE || sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+            return false;
+        return CPU_ISSET(cpu, &allowed);
+    }
+
+    /**
+     * @brief Constructor
+     *
+     * @param sourceName The HoLang source, for the report
+     * @param code The C program generated from it
+     * @param cpu The CPU to run on, or -1 for the last one this process may use
+     */
+    Benchmark(string sourceName, string code, int cpu = -1)
+        : sourceName(sourceName)
+        , code(code)
+        , cpu(cpu < 0 ? defaultCpu() : cpu)
+    {
+    }
+
+    /**
+     * @brief Builds the program and runs it
+     *
+     * @param runs Number of measured runs, at least 1
+     * @param warmupRuns Number of runs before them that are not measured
+     * @throws runtime_error if the C does not compile, a run fails or the exit status changes
+     */
+    void run(int runs, int warmupRuns)
+    {
+        NativeBuild build;
+        string program = build.executable(code, "bench");
+        if (program.empty())
+            throw runtime_error("The C compiler rejected the program generated from " + sourceName);
+        warmup = warmupRuns;
+        wallSeconds = cpuSeconds = instructions = cycles = Series();
+        try {
+            for (int i = 0; i < warmupRuns + runs; i++) {
+                int status = runOnce(program, i >= warmupRuns);
+                if (i > 0 && status != exitStatus)
+                    throw runtime_error(sourceName + " exited with " + to_string(status) + " after " + to_string(exitStatus) + " before");
+                exitStatus = status;
+            }
+        } catch (...) {
+            unlink(program.c_str());
+            throw;
+        }
+        unlink(program.c_str());
+    }
+
+    /// @brief Prints the medians and MADs, one line per measurement
+    void print(ostream& out)
+    {
+        char line[160];
+        snprintf(line, sizeof(line), "%s: %zu runs after %d warmup on CPU %d, exit status %d\n", sourceName.c_str(), wallSeconds.runs.size(), warmup, cpu, exitStatus);
+        out << line;
+        snprintf(line, sizeof(line), "  %-13s %14.3f ms  MAD %10.3f ms\n", "time", wallSeconds.median() * 1e3, wallSeconds.mad() * 1e3);
+        out << line;
+        if (cpuSeconds.available) {
+            snprintf(line, sizeof(line), "  %-13s %14.3f ms  MAD %10.3f ms\n", "cpu time", cpuSeconds.median() * 1e3, cpuSeconds.mad() * 1e3);
+            out << line;
+        }
+        const pair<const char*, Series*> counters[] = { { "instructions", &instructions }, { "cycles", &cycles } };
+        for (auto [name, series] : counters) {
+            if (series->available)
+                snprintf(line, sizeof(line), "  %-13s %17.0f  MAD %13.0f\n", name, series->median(), series->mad());
+            else
+                snprintf(line, sizeof(line), "  %-13s %17s\n", name, "unavailable (perf_event_open)");
+            out << line;
+        }
+    }
+
+    /**
+     * @brief Writes the results as JSON
+     *
+     * @throws runtime_error if the file cannot be written
+     */
+    void writeJson(string fileName)
+    {
+        ofstream file(fileName);
+        if (!file.is_open())
+            throw runtime_error("Could not write benchmark results " + fileName);
+        char hash[20];
+        snprintf(hash, sizeof(hash), "%016llx", (unsigned long long)BatchCompiler::hashContent(code));
+        file << "{\n"
+             << "  \"source\": " << jsonString(sourceName) << ",\n"
+             << "  \"c_bytes\": " << code.size() << ",\n"
+             << "  \"c_hash\": \"" << hash << "\",\n"
+             << "  \"compiler\": " << jsonString(string(getenv("CC") ? getenv("CC") : "cc") + " -O2 -fwrapv") << ",\n"
+             << "  \"cpu\": " << cpu << ",\n"
+             << "  \"warmup\": " << warmup << ",\n"
+             << "  \"exit_status\": " << exitStatus << ",\n";
+        writeSeries(file, "wall_seconds", wallSeconds, false);
+        writeSeries(file, "cpu_seconds", cpuSeconds, false);
+        writeSeries(file, "instructions", instructions, false);
+        writeSeries(file, "cycles", cycles, true);
+        file << "}\n";
+    }
+};
@@ -0,0 +1,461 @@
+/**
+ * @file cfg.hpp
+ * @brief Control-flow graph and dominator tree for the HoPiler transpiler
+ * 
+ * The ControlFlowGraph class lowers the statement tree built by the Parser into basic
+ * blocks connected by control-flow edges, and computes the dominator tree over them.
+ * It is the starting point for optimization passes on if/elif/else, while, do-while,
+ * for, break and continue.
+ * 
+ * @author HoPiler Project
+ */
+
+#pragma once
+
+#include "expNode.hpp"
+#include "tokens.hpp"
+#include <iostream>
+#include <vector>
+
+using namespace std;
+
+/**
+ * @struct BasicBlock
+ * @brief A straight-line run of statements with a single entry and a single exit point
+ * 
+ * A block that ends in a branch stores the branch condition; its first successor is
+ * the target taken when the condition is true, its second the one taken when it is false.
+ * Statements and conditions point into the tree owned by the ControlFlowGraph.
+ */
+struct BasicBlock {
+    vector<ExpressionNode*> statements;
+    ExpressionNode* condition = nullptr; // the condition ending the block, if it branches
+    vector<int> successors;
+    vector<int> predecessors;
+};
+
+/**
+ * @class ControlFlowGraph
+ * @brief Basic blocks of a statement tree plus its dominator tree
+ * 
+ * Blocks live in one arena (a vector) and refer to each other by index, so growing
+ * the graph never invalidates a block id. Block 0 is the entry and block 1 the exit.
+ * The graph keeps its own copy of the tree, which blocks point into; nodes are
+ * linked intrusively, so those pointers stay valid while passes edit the tree.
+ * 
+ * Construction:
+ * 1. lowerBlock() walks the statement tree once, appending statements to the current
+ *    block and opening new blocks at every branch, loop header and join point
+ * 2. Reachable blocks are numbered in reverse postorder with an iterative DFS
+ * 3. Immediate dominators are computed with the Cooper-Harvey-Kennedy iterative
+ *    algorithm; on the structured (reducible) graphs the parser produces it converges
+ *    after two passes over the blocks
+ * 4. The dominator tree is numbered with an iterative pre/post-order DFS, which makes
+ *    every dominance query two integer comparisons
+ * 
+ * Steps 2 to 4 are iterative, so programs with 100k+ blocks do not overflow the
+ * stack. Lowering in step 1 recurses once per nesting level of blocks, like the
+ * Parser, so its depth follows how deeply the source nests, not how long it is.
+ * 
+ * Example:
+ * ```
+ * ControlFlowGraph cfg(parser.getTree());
+ * cfg.dominates(cfg.getEntry(), block); // true for every reachable block
+ * ```
+ * 
+ * @see Parser
+ */
+class ControlFlowGraph {
+private:
+    ExpressionNode tree;
+    vector<BasicBlock> blocks;
+    vector<int> reversePostorder; // reachable blocks only
+    vector<int> rpoNumber; // position in reversePostorder, -1 if unreachable
+    vector<int> idom; // immediate dominator, -1 for the entry and unreachable blocks
+    vector<int> domPre; // pre-order number in the dominator tree
+    vector<int> domPost; // post-order number in the dominator tree
+
+    /**
+     * @struct LoopTargets
+     * @brief Where break and continue jump to inside the innermost loop
+     */
+    struct LoopTargets {
+        int breakTarget;
+        int continueTarget;
+    };
+
+    /// @brief Allocates a new empty block in the arena and returns its id
+    int newBlock()
+    {
+        blocks.push_back(BasicBlock());
+        return blocks.size() - 1;
+    }
+
+    /// @brief Adds a control-flow edge from one block to another
+    void addEdge(int from, int to)
+    {
+        blocks[from].successors.push_back(to);
+        blocks[to].predecessors.push_back(from);
+    }
+
+    /**
+     * @brief Ends block current with a two-way branch
+     * 
+     * @param current The block that evaluates the condition
+     * @param condition The branch condition
+     * @param whenTrue Block taken when the condition holds
+     * @param whenFalse Block taken otherwise
+     */
+    void addBranch(int current, ExpressionNode* condition, int whenTrue, int whenFalse)
+    {
+        blocks[current].condition = condition;
+        addEdge(current, whenTrue);
+        addEdge(current, whenFalse);
+    }
+
+    /**
+     * @brief Lowers the statements of a block node into basic blocks
+     * 
+     * @param block The root or block node whose children are statements
+     * @param current The basic block control enters at
+     * @param loops Stack of enclosing loops for break and continue
+     * @return The basic block control leaves from
+     * 
+     * After break, continue and return a fresh block with no predecessors is opened,
+     * so statements following them end up in an unreachable block.
+     */
+    int lowerBlock(ExpressionNode* block, int current, vector<LoopTargets>& loops)
+    {
+        for (ExpressionNode* statement = block->getFirstChild(); statement; statement = statement->getNextSibling())
+            current = lowerStatement(statement, current, loops);
+        return current;
+    }
+
+    /**
+     * @brief Lowers one statement into basic blocks
+     * 
+     * @param statement The statement node (shapes as documented in Parser)
+     * @param current The basic block control enters at
+     * @param loops Stack of enclosing loops for break and continue
+     * @return The basic block control leaves from
+     */
+    int lowerStatement(ExpressionNode* statement, int current, vector<LoopTargets>& loops)
+    {
+        if (statement->getTokenType() == _expression) {
+            return lowerBlock(statement, current, loops);
+        } // nested { } block
+
+        if (statement->getTokenType() != _keyWord || statement->getToken() >= _int) {
+            blocks[current].statements.push_back(statement);
+            return current;
+        } // declarations, assignments and expression statements do not branch
+
+        ExpressionNode* first = statement->getFirstChild();
+        switch (statement->getToken()) {
+        case _if: {
+            int join = newBlock();
+            int condition = current;
+            ExpressionNode* cond = first;
+            ExpressionNode* branch = first->getNextSibling()->getNextSibling(); // first elif/else
+            ExpressionNode* body = first->getNextSibling();
+            while (true) {
+                int thenBlock = newBlock();
+                int elseBlock = branch ? newBlock() : join;
+                addBranch(condition, cond, thenBlock, elseBlock);
+                addEdge(lowerBlock(body, thenBlock, loops), join);
+
+                if (!branch)
+                    break;
+                if (branch->getToken() == _else) {
+                    addEdge(lowerBlock(branch->getFirstChild(), elseBlock, loops), join);
+                    break;
+                }
+                condition = elseBlock;
+                cond = branch->getFirstChild();
+                body = cond->getNextSibling();
+                branch = branch->getNextSibling();
+            } // if and every elif evaluate their condition in their own block
+            return join;
+        }
+        case _while: {
+            int header = newBlock();
+            int body = newBlock();
+            int exit = newBlock();
+            addEdge(current, header);
+            addBranch(header, first, body, exit);
+            loops.push_back(LoopTargets { exit, header });
+            addEdge(lowerBlock(first->getNextSibling(), body, loops), header);
+            loops.pop_back();
+            return exit;
+        }
+        case _do: {
+            int body = newBlock();
+            int latch = newBlock();
+            int exit = newBlock();
+            addEdge(current, body);
+            loops.push_back(LoopTargets { exit, latch });
+            addEdge(lowerBlock(first, body, loops), latch);
+            loops.pop_back();
+            addBranch(latch, first->getNextSibling(), body, exit);
+            return exit;
+        }
+        case _for: {
+            ExpressionNode* condition = first->getNextSibling();
+            ExpressionNode* increment = condition->getNextSibling();
+            blocks[current].statements.push_back(first);
+            int header = newBlock();
+            int body = newBlock();
+            int step = newBlock();
+            int exit = newBlock();
+            addEdge(current, header);
+            addBranch(header, condition, body, exit);
+            loops.push_back(LoopTargets { exit, step });
+            addEdge(lowerBlock(increment->getNextSibling(), body, loops), step);
+            loops.pop_back();
+            blocks[step].statements.push_back(increment);
+            addEdge(step, header);
+            return exit;
+        }
+        case _break:
+        case _continue:
+            if (loops.empty()) {
+                cerr << "break/continue outside of a loop" << endl;
+                throw invalid_argument("break/continue outside of a loop");
+            }
+            addEdge(current, statement->getToken() == _break ? loops.back().breakTarget : loops.back().continueTarget);
+            return newBlock();
+        case _return:
+            blocks[current].statements.push_back(statement);
+            addEdge(current, getExit());
+            return newBlock();
+        default:
+            cerr << "Unexpected keyword in statement position: " << statement->getToken() << endl;
+            throw invalid_argument("Unexpected keyword in statement position");
+        }
+    }
+
+    /**
+     * @brief Numbers the blocks reachable from the entry in reverse postorder
+     * 
+     * Uses an explicit stack of (block, next successor index) pairs instead of
+     * recursion.
+     */
+    void computeReversePostorder()
+    {
+        vector<int> postorder;
+        vector<bool> visited(blocks.size(), false);
+        vector<pair<int, int>> stack = { { getEntry(), 0 } };
+        visited[getEntry()] = true;
+
+        while (!stack.empty()) {
+            auto& [block, next] = stack.back();
+            if (next < (int)blocks[block].successors.size()) {
+                int successor = blocks[block].successors[next++];
+                if (!visited[successor]) {
+                    visited[successor] = true;
+                    stack.push_back({ successor, 0 });
+                }
+            } else {
+                postorder.push_back(block);
+                stack.pop_back();
+            }
+        }
+
+        reversePostorder.assign(postorder.rbegin(), postorder.rend());
+        rpoNumber.assign(blocks.size(), -1);
+        for (int i = 0; i < (int)reversePostorder.size(); i++)
+            rpoNumber[reversePostorder[i]] = i;
+    }
+
+    /**
+     * @brief Walks two dominator-tree paths up to their nearest common ancestor
+     * 
+     * Part of Cooper-Harvey-Kennedy: blocks are compared by reverse postorder number,
+     * the deeper one (larger number) climbs first.
+     */
+    int intersect(int a, int b)
+    {
+        while (a != b) {
+            while (rpoNumber[a] > rpoNumber[b])
+                a = idom[a];
+            while (rpoNumber[b] > rpoNumber[a])
+                b = idom[b];
+        }
+        return a;
+    }
+
+    /**
+     * @brief Computes immediate dominators with the Cooper-Harvey-Kennedy algorithm
+     * 
+     * "A Simple, Fast Dominance Algorithm" (Cooper, Harvey, Kennedy 2001): repeatedly
+     * sets idom(b) to the intersection of the already processed predecessors of b,
+     * visiting blocks in reverse postorder, until nothing changes.
+     */
+    void computeDominators()
+    {
+        int entry = getEntry();
+        idom.assign(blocks.size(), -1);
+        idom[entry] = entry;
+
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (int i = 1; i < (int)reversePostorder.size(); i++) {
+                int block = reversePostorder[i];
+                int newIdom = -1;
+                for (int predecessor : blocks[block].predecessors) {
+                    if (idom[predecessor] == -1)
+                        continue; // unreachable, or not processed yet in this pass
+                    newIdom = newIdom == -1 ? predecessor : intersect(predecessor, newIdom);
+                }
+                if (idom[block] != newIdom) {
+                    idom[block] = newIdom;
+                    changed = true;
+                }
+            }
+        }
+        idom[entry] = -1;
+    }
+
+    /**
+     * @brief Numbers the dominator tree in pre- and post-order
+     * 
+     * With these numbers, a dominates b exactly when b's interval
+     * [domPre, domPost] lies inside a's, which dominates() checks in O(1).
+     */
+    void numberDominatorTree()
+    {
+        vector<vector<int>> children(blocks.size());
+        for (int block : reversePostorder) {
+            if (idom[block] != -1)
+                children[idom[block]].push_back(block);
+        }
+
+        domPre.assign(blocks.size(), -1);
+        domPost.assign(blocks.size(), -1);
+        int preCounter = 0, postCounter = 0;
+        vector<pair<int, int>> stack = { { getEntry(), 0 } };
+        domPre[getEntry()] = preCounter++;
+
+        while (!stack.empty()) {
+            auto& [block, next] = stack.back();
+            if (next < (int)children[block].size()) {
+                int child = children[block][next++];
+                domPre[child] = preCounter++;
+                stack.push_back({ child, 0 });
+            } else {
+                domPost[block] = postCounter++;
+                stack.pop_back();
+            }
+        }
+    }
+
+public:
+    /**
+     * @brief Constructor - builds the CFG of a statement tree and its dominator tree
+     * 
+     * @param root The root node returned by Parser::getTree()
+     * @throws invalid_argument for break/continue outside of a loop
+     */
+    ControlFlowGraph(ExpressionNode root)
+        : tree(std::move(root))
+    {
+        newBlock(); // entry
+        newBlock(); // exit
+        vector<LoopTargets> loops;
+        int first = newBlock();
+        addEdge(getEntry(), first);
+        addEdge(lowerBlock(&tree, first, loops), getExit());
+
+        computeReversePostorder();
+        computeDominators();
+        numberDominatorTree();
+    }
+
+    /// @brief Not copyable: blocks point into this graph's own tree
+    ControlFlowGraph(const ControlFlowGraph&) = delete;
+    ControlFlowGraph& operator=(const ControlFlowGraph&) = delete;
+
+    /// @brief Gets the id of the entry block
+    int getEntry()
+    {
+        return 0;
+    }
+
+    /// @brief Gets the id of the exit block
+    int getExit()
+    {
+        return 1;
+    }
+
+    /// @brief Gets the number of blocks in the arena, including unreachable ones
+    int size()
+    {
+        return blocks.size();
+    }
+
+    /// @brief Gets a block by id
+    BasicBlock& getBlock(int id)
+    {
+        return blocks.at(id);
+    }
+
+    /// @brief Gets the reachable blocks in reverse postorder
+    vector<int> getReversePostorder()
+    {
+        return reversePostorder;
+    }
+
+    /// @brief True if the block can be reached from the entry
+    bool isReachable(int block)
+    {
+        return rpoNumber[block] != -1;
+    }
+
+    /**
+     * @brief Gets the immediate dominator of a block
+     * 
+     * @return The id of the immediate dominator, or -1 for the entry and unreachable blocks
+     */
+    int getImmediateDominator(int block)
+    {
+        return idom[block];
+    }
+
+    /**
+     * @brief Checks whether block a dominates block b in O(1)
+     * 
+     * @return true if every path from the entry to b passes through a (a block
+     *         dominates itself), false otherwise or if either block is unreachable
+     */
+    bool dominates(int a, int b)
+    {
+        if (!isReachable(a) || !isReachable(b))
+            return false;
+        return domPre[a] <= domPre[b] && domPost[b] <= domPost[a];
+    }
+
+    /**
+     * @brief Prints every block with its size, successors and immediate dominator
+     * 
+     * Output example:
+     * ```
+     * Block 2: 1 statements, branch, successors: 3 4, idom: 0
+     * ```
+     */
+    void print()
+    {
+        for (int i = 0; i < (int)blocks.size(); i++) {
+            cout << "Block " << i << ": " << blocks[i].statements.size() << " statements";
+            if (blocks[i].condition)
+                cout << ", branch";
+            cout << ", successors:";
+            for (int successor : blocks[i].successors)
+                cout << " " << successor;
+            if (isReachable(i))
+                cout << ", idom: " << idom[i] << endl;
+            else
+                cout << ", unreachable" << endl;
+        }
+    }
+};
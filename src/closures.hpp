@@ -0,0 +1,709 @@
+/**
+ * @file closures.hpp
+ * @brief Closure-compiling execution engine for HoLang (--run --engine closures)
+ *
+ * The ClosureCompiler turns the parsed tree into a tree of C++ closures once, and
+ * then runs the closures. Everything the Interpreter decides again on every visit
+ * of a node is decided here at compile time:
+ * - the node kind and operator pick which closure is built
+ * - the static types of the operands pick its arithmetic (an int + int closure
+ *   never looks at a tag), and common operand shapes (variable, literal) are read
+ *   in place instead of through another closure
+ * - variables are resolved to fixed storage, so no name is hashed at run time
+ *
+ * The semantics are the interpreter's (64-bit wrapping ints, truncating division,
+ * short-circuit and/or). Type errors and undeclared variables are reported when
+ * compiling, i.e. before the program starts; division by zero at run time.
+ *
+ * @author HoPiler Project
+ */
+
+#pragma once
+
+#include "expNode.hpp"
+#include "interpreter.hpp"
+#include "tokens.hpp"
+#include <cmath>
+#include <deque>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+/**
+ * @class ClosureCompiler
+ * @brief Compiles a HoLang tree into closures and runs them
+ *
+ * Expressions compile to a Code: a closure of the C++ type matching the static
+ * HoLang type (long long for int, char and bool, double for float, string for
+ * string), plus what is known about its shape. Statements compile to closures
+ * returning a Flow.
+ *
+ * Example:
+ * ```
+ * ClosureCompiler program(tree);
+ * program.run();
+ * return program.getExitStatus();
+ * ```
+ *
+ * @see Interpreter
+ */
+class ClosureCompiler {
+private:
+    using Statement = function<Flow()>;
+    using IntFunction = function<long long()>;
+    using FloatFunction = function<double()>;
+    using BoolFunction = function<bool()>;
+    using TextFunction = function<string()>;
+
+    /**
+     * @struct Code
+     * @brief A compiled expression
+     */
+    struct Code {
+        KeyWordType type = _int;
+        IntFunction integer; // int, char and bool
+        FloatFunction real; // float
+        TextFunction text; // string
+        BoolFunction test; // comparisons and logic: the truth value without going through an int
+        long long* variable = nullptr; // the expression is this int, char or bool variable
+        bool constant = false; // the expression is the int literal value
+        long long value = 0;
+    };
+
+    /**
+     * @struct Variable
+     * @brief Storage of one declared variable; exactly one pointer is set
+     */
+    struct Variable {
+        KeyWordType type;
+        long long* integer = nullptr;
+        double* real = nullptr;
+        string* text = nullptr;
+    };
+
+    deque<long long> integers; // deques never move their elements, so closures keep pointers
+    deque<double> reals;
+    deque<string> texts;
+    vector<unordered_map<string, Variable>> scopes;
+    vector<Statement> program;
+    int loopDepth = 0;
+    int exitStatus = 0;
+
+    /// @brief Throws a compile-time or run-time error for a line
+    [[noreturn]] static void error(int line, string message)
+    {
+        throw runtime_error("Line " + to_string(line) + ": " + message);
+    }
+
+    /// @brief Gets the HoLang name of a data type, for diagnostics
+    static string typeName(KeyWordType type)
+    {
+        static const char* const names[] = { "int", "float", "string", "char", "bool" };
+        return names[type - _int];
+    }
+
+    static bool isInteger(KeyWordType type)
+    {
+        return type != _float && type != _string;
+    }
+
+    /// @brief Makes a Code for an int-like closure
+    static Code integerCode(IntFunction function, KeyWordType type = _int)
+    {
+        Code code;
+        code.type = type;
+        code.integer = function;
+        return code;
+    }
+
+    /// @brief Makes a Code for a truth value, usable both as a condition and as an int
+    static Code boolCode(BoolFunction test)
+    {
+        Code code;
+        code.type = _bool;
+        code.test = test;
+        code.integer = [test] { return (long long)test(); };
+        return code;
+    }
+
+    /// @brief Gets a numeric Code as a double
+    static FloatFunction toFloat(const Code& code)
+    {
+        if (code.type == _float)
+            return code.real;
+        if (code.variable) {
+            long long* variable = code.variable;
+            return [variable] { return (double)*variable; };
+        }
+        IntFunction integer = code.integer;
+        return [integer] { return (double)integer(); };
+    }
+
+    /// @brief Gets a numeric Code as a truth value
+    static BoolFunction truth(ExpressionNode* node, const Code& code)
+    {
+        if (code.type == _string)
+            error(node->getLine(), "A string cannot be used as a condition");
+        if (code.test)
+            return code.test;
+        if (code.type == _float) {
+            FloatFunction real = code.real;
+            return [real] { return real() != 0; };
+        }
+        if (code.variable) {
+            long long* variable = code.variable;
+            return [variable] { return *variable != 0; };
+        }
+        IntFunction integer = code.integer;
+        return [integer] { return integer() != 0; };
+    }
+
+    /**
+     * @brief Builds an int operation, reading variable and literal operands in place
+     *
+     * @param combine The operation on the two operand values
+     */
+    template <typename Result, typename Combine>
+    static function<Result()> combineIntegers(const Code& left, const Code& right, Combine combine)
+    {
+        if (left.variable && right.constant) {
+            long long* a = left.variable;
+            long long b = right.value;
+            return [=] { return combine(*a, b); };
+        }
+        if (left.variable && right.variable) {
+            long long *a = left.variable, *b = right.variable;
+            return [=] { return combine(*a, *b); };
+        }
+        if (right.constant) {
+            IntFunction a = left.integer;
+            long long b = right.value;
+            return [=] { return combine(a(), b); };
+        }
+        IntFunction a = left.integer, b = right.integer;
+        return [=] { return combine(a(), b()); };
+    }
+
+    /// @brief Builds a float operation
+    template <typename Result, typename Combine>
+    static function<Result()> combineFloats(const Code& left, const Code& right, Combine combine)
+    {
+        FloatFunction a = toFloat(left), b = toFloat(right);
+        return [=] { return combine(a(), b()); };
+    }
+
+    /// @brief Builds a comparison for whichever operand types it has
+    template <typename Compare>
+    static Code comparison(const Code& left, const Code& right, Compare compare)
+    {
+        if (left.type == _string) {
+            TextFunction a = left.text, b = right.text;
+            return boolCode([=] { return compare(a().compare(b()), 0); });
+        }
+        if (left.type == _float || right.type == _float)
+            return boolCode(combineFloats<bool>(left, right, compare));
+        return boolCode(combineIntegers<bool>(left, right, compare));
+    }
+
+    /**
+     * @brief Compiles a binary operator on two compiled operands
+     *
+     * Used for expressions and for compound assignments (with the variable as left).
+     */
+    Code binary(ExpressionNode* node, int op, const Code& left, const Code& right)
+    {
+        int line = node->getLine();
+        if ((left.type == _string) != (right.type == _string))
+            error(line, "Cannot combine a " + typeName(left.type) + " with a " + typeName(right.type));
+
+        switch (op) {
+        case _and:
+        case _or:
+        case _xor: {
+            BoolFunction a = truth(node, left), b = truth(node, right);
+            if (op == _and)
+                return boolCode([=] { return a() && b(); });
+            if (op == _or)
+                return boolCode([=] { return a() || b(); });
+            return boolCode([=] { return a() != b(); });
+        }
+        case _eq:
+            return comparison(left, right, [](auto a, auto b) { return a == b; });
+        case _neq:
+            return comparison(left, right, [](auto a, auto b) { return a != b; });
+        case _gte:
+            return comparison(left, right, [](auto a, auto b) { return a >= b; });
+        case _lte:
+            return comparison(left, right, [](auto a, auto b) { return a <= b; });
+        case _gt:
+            return comparison(left, right, [](auto a, auto b) { return a > b; });
+        case _lt:
+            return comparison(left, right, [](auto a, auto b) { return a < b; });
+        }
+
+        if (left.type == _string) {
+            if (op != _add)
+                error(line, "Operator does not apply to strings");
+            Code code;
+            code.type = _string;
+            TextFunction a = left.text, b = right.text;
+            code.text = [=] { return a() + b(); };
+            return code;
+        }
+
+        if (left.type == _float || right.type == _float) {
+            Code code;
+            code.type = _float;
+            switch (op) {
+            case _add:
+                code.real = combineFloats<double>(left, right, [](double a, double b) { return a + b; });
+                break;
+            case _sub:
+                code.real = combineFloats<double>(left, right, [](double a, double b) { return a - b; });
+                break;
+            case _mul:
+                code.real = combineFloats<double>(left, right, [](double a, double b) { return a * b; });
+                break;
+            case _div:
+                code.real = combineFloats<double>(left, right, [](double a, double b) { return a / b; });
+                break;
+            case _mod:
+                code.real = combineFloats<double>(left, right, [](double a, double b) { return fmod(a, b); });
+                break;
+            default:
+                code.real = combineFloats<double>(left, right, [](double a, double b) { return pow(a, b); });
+            }
+            return code;
+        }
+
+        switch (op) {
+        case _add:
+            return integerCode(combineIntegers<long long>(left, right, [](long long a, long long b) { return (long long)((unsigned long long)a + b); }));
+        case _sub:
+            return integerCode(combineIntegers<long long>(left, right, [](long long a, long long b) { return (long long)((unsigned long long)a - b); }));
+        case _mul:
+            return integerCode(combineIntegers<long long>(left, right, [](long long a, long long b) { return (long long)((unsigned long long)a * b); }));
+        case _div:
+            return integerCode(combineIntegers<long long>(left, right, [line](long long a, long long b) {
+                if (b == 0)
+                    error(line, "Division by zero");
+                return a / b;
+            }));
+        case _mod:
+            return integerCode(combineIntegers<long long>(left, right, [line](long long a, long long b) {
+                if (b == 0)
+                    error(line, "Division by zero");
+                return a % b;
+            }));
+        default:
+            return integerCode(combineIntegers<long long>(left, right, Interpreter::integerPower));
+        }
+    }
+
+    /// @brief Finds a variable through the scopes being compiled
+    Variable* find(const string& name)
+    {
+        for (int i = scopes.size() - 1; i >= 0; i--) {
+            auto found = scopes[i].find(name);
+            if (found != scopes[i].end())
+                return &found->second;
+        }
+        return nullptr;
+    }
+
+    /// @brief Compiles an expression
+    Code expression(ExpressionNode* node)
+    {
+        switch (node->getTokenType()) {
+        case _literal: {
+            Code code;
+            switch (node->getToken()) {
+            case _intLit:
+                code.value = stoll(node->getTokenValue());
+                break;
+            case _floatLit: {
+                double value = stod(node->getTokenValue());
+                code.type = _float;
+                code.real = [value] { return value; };
+                return code;
+            }
+            case _charLit:
+                code.type = _char;
+                code.value = node->getTokenValue()[0];
+                break;
+            default: {
+                string value = node->getTokenValue();
+                code.type = _string;
+                code.text = [value] { return value; };
+                return code;
+            }
+            }
+            long long value = code.value;
+            code.integer = [value] { return value; };
+            code.constant = true;
+            return code;
+        }
+        case _identifier: {
+            string name = node->getTokenValue();
+            Variable* variable = find(name);
+            if (!variable && (name == "true" || name == "false")) {
+                bool value = name == "true"; // same stand-in as the interpreter
+                Code code = boolCode([value] { return value; });
+                code.constant = true;
+                code.value = value;
+                return code;
+            }
+            if (!variable)
+                error(node->getLine(), "Use of undeclared variable " + name);
+            Code code;
+            code.type = variable->type;
+            if (variable->type == _float) {
+                double* real = variable->real;
+                code.real = [real] { return *real; };
+            } else if (variable->type == _string) {
+                string* text = variable->text;
+                code.text = [text] { return *text; };
+            } else {
+                long long* integer = variable->integer;
+                code.integer = [integer] { return *integer; };
+                code.variable = integer;
+            }
+            return code;
+        }
+        case _operator: {
+            ExpressionNode* left = node->getFirstChild();
+            int op = node->getToken();
+            if (op >= _ass)
+                error(node->getLine(), "Assignment used as a value");
+            Code operand = expression(left);
+            if (node->getChildCount() == 1) {
+                if (operand.type == _string)
+                    error(node->getLine(), "Operator does not apply to strings");
+                if (op == _not) {
+                    BoolFunction test = truth(node, operand);
+                    return boolCode([test] { return !test(); });
+                }
+                if (operand.type == _float) {
+                    FloatFunction real = operand.real;
+                    Code code;
+                    code.type = _float;
+                    code.real = [real] { return -real(); };
+                    return code;
+                }
+                IntFunction integer = operand.integer;
+                return integerCode([integer] { return (long long)(0ULL - integer()); });
+            }
+            return binary(node, op, operand, expression(left->getNextSibling()));
+        }
+        default:
+            error(node->getLine(), "Expected an expression");
+        }
+    }
+
+    /**
+     * @brief Compiles storing a value into a variable, converting it to the variable's type
+     *
+     * @throws runtime_error when a string meets a number
+     */
+    function<void()> store(ExpressionNode* node, const Variable& variable, const Code& value)
+    {
+        if ((variable.type == _string) != (value.type == _string))
+            error(node->getLine(), "Cannot assign a " + typeName(value.type) + " to a " + typeName(variable.type));
+        if (variable.type == _string) {
+            string* text = variable.text;
+            TextFunction function = value.text;
+            return [text, function] { *text = function(); };
+        }
+        if (variable.type == _float) {
+            double* real = variable.real;
+            FloatFunction function = toFloat(value);
+            return [real, function] { *real = function(); };
+        }
+
+        long long* integer = variable.integer;
+        if (variable.type == _bool) {
+            BoolFunction test = truth(node, value);
+            return [integer, test] { *integer = test(); };
+        }
+        bool narrow = variable.type == _char;
+        if (value.type == _float) {
+            FloatFunction real = value.real;
+            if (narrow)
+                return [integer, real] { *integer = (char)(long long)real(); };
+            return [integer, real] { *integer = (long long)real(); };
+        }
+        IntFunction function = value.integer;
+        if (narrow && value.type != _char)
+            return [integer, function] { *integer = (char)function(); };
+        return [integer, function] { *integer = function(); };
+    }
+
+    /// @brief Compiles a declaration; the variable is in scope from the next statement on
+    Statement declaration(ExpressionNode* node)
+    {
+        KeyWordType type = (KeyWordType)node->getToken();
+        ExpressionNode* child = node->getFirstChild();
+        bool initialised = child->getTokenType() == _operator;
+        ExpressionNode* nameNode = initialised ? child->getFirstChild() : child;
+
+        Variable variable { type };
+        if (type == _float)
+            variable.real = &reals.emplace_back(0);
+        else if (type == _string)
+            variable.text = &texts.emplace_back();
+        else
+            variable.integer = &integers.emplace_back(0);
+
+        Code value;
+        value.type = type;
+        if (initialised) {
+            value = expression(nameNode->getNextSibling());
+        } else if (type == _string) {
+            value.text = [] { return string(); };
+        } else if (type == _float) {
+            value.real = [] { return 0.0; };
+        } else {
+            value.integer = [] { return 0LL; };
+        }
+        function<void()> initialise = store(node, variable, value);
+
+        if (!scopes.back().emplace(nameNode->getTokenValue(), variable).second)
+            error(node->getLine(), "Variable " + nameNode->getTokenValue() + " is already declared in this block");
+        return [initialise] {
+            initialise();
+            return _normalFlow;
+        };
+    }
+
+    /// @brief Compiles an assignment (plain or compound)
+    Statement assignment(ExpressionNode* node)
+    {
+        ExpressionNode* target = node->getFirstChild();
+        if (target->getTokenType() != _identifier)
+            error(node->getLine(), "Only variables can be assigned to");
+        Code value = expression(target->getNextSibling());
+        Variable* variable = find(target->getTokenValue());
+        if (!variable)
+            error(node->getLine(), "Use of undeclared variable " + target->getTokenValue());
+
+        static const OperatorType arithmetic[] = { _add, _add, _sub, _mul, _div, _mod, _pow }; // indexed by op - _ass
+        int op = node->getToken();
+        if (op != _ass) {
+            if (variable->type == _string && op != _assAdd)
+                error(node->getLine(), "Operator does not apply to strings");
+            value = binary(node, arithmetic[op - _ass], expression(target), value);
+        }
+        function<void()> assign = store(node, *variable, value);
+        return [assign] {
+            assign();
+            return _normalFlow;
+        };
+    }
+
+    /// @brief Compiles the statements of a block in a new scope
+    Statement block(ExpressionNode* node)
+    {
+        scopes.emplace_back();
+        vector<Statement> statements;
+        for (ExpressionNode* child = node ? node->getFirstChild() : nullptr; child; child = child->getNextSibling())
+            statements.push_back(statement(child));
+        scopes.pop_back();
+
+        if (statements.size() == 1)
+            return statements[0];
+        return [statements] {
+            for (const Statement& statement : statements) {
+                Flow flow = statement();
+                if (flow != _normalFlow)
+                    return flow;
+            }
+            return _normalFlow;
+        };
+    }
+
+    /// @brief Compiles a loop body, keeping track of whether break and continue are allowed
+    Statement loopBody(ExpressionNode* node)
+    {
+        loopDepth++;
+        Statement body = block(node);
+        loopDepth--;
+        return body;
+    }
+
+    /// @brief Compiles a condition
+    BoolFunction condition(ExpressionNode* node)
+    {
+        return truth(node, expression(node));
+    }
+
+    /// @brief Compiles an if statement with its elif and else arms
+    Statement ifStatement(ExpressionNode* node)
+    {
+        vector<pair<BoolFunction, Statement>> arms;
+        Statement otherwise = [] { return _normalFlow; };
+        ExpressionNode* test = node->getFirstChild();
+        arms.emplace_back(condition(test), block(test->getNextSibling()));
+        for (ExpressionNode* arm = test->getNextSibling()->getNextSibling(); arm; arm = arm->getNextSibling()) {
+            if (arm->getToken() == _else) {
+                otherwise = block(arm->getFirstChild());
+                break;
+            }
+            arms.emplace_back(condition(arm->getFirstChild()), block(arm->getFirstChild()->getNextSibling()));
+        }
+        return [arms, otherwise] {
+            for (const auto& [test, body] : arms)
+                if (test())
+                    return body();
+            return otherwise();
+        };
+    }
+
+    /// @brief Compiles one statement
+    Statement statement(ExpressionNode* node)
+    {
+        if (node->getTokenType() == _expression)
+            return block(node);
+        if (node->getTokenType() == _operator && node->getToken() >= _ass)
+            return assignment(node);
+        if (node->getTokenType() != _keyWord) {
+            Code code = expression(node);
+            if (code.type == _string)
+                return [text = code.text] {
+                    text();
+                    return _normalFlow;
+                };
+            if (code.type == _float)
+                return [real = code.real] {
+                    real();
+                    return _normalFlow;
+                };
+            return [integer = code.integer] {
+                integer();
+                return _normalFlow;
+            };
+        }
+
+        ExpressionNode* first = node->getFirstChild();
+        switch (node->getToken()) {
+        case _if:
+            return ifStatement(node);
+        case _while: {
+            BoolFunction test = condition(first);
+            Statement body = loopBody(first->getNextSibling());
+            return [test, body] {
+                while (test()) {
+                    Flow flow = body();
+                    if (flow == _breakFlow)
+                        break;
+                    if (flow == _returnFlow)
+                        return flow;
+                }
+                return _normalFlow;
+            };
+        }
+        case _do: {
+            Statement body = loopBody(first);
+            BoolFunction test = condition(first->getNextSibling());
+            return [test, body] {
+                do {
+                    Flow flow = body();
+                    if (flow == _breakFlow)
+                        break;
+                    if (flow == _returnFlow)
+                        return flow;
+                } while (test());
+                return _normalFlow;
+            };
+        }
+        case _for: {
+            ExpressionNode* test = first->getNextSibling();
+            ExpressionNode* step = test->getNextSibling();
+            scopes.emplace_back();
+            Statement initialise = statement(first);
+            BoolFunction keepGoing = condition(test);
+            Statement advance = statement(step);
+            Statement body = loopBody(step->getNextSibling());
+            scopes.pop_back();
+            return [initialise, keepGoing, advance, body] {
+                for (initialise(); keepGoing(); advance()) {
+                    Flow flow = body();
+                    if (flow == _breakFlow)
+                        break;
+                    if (flow == _returnFlow)
+                        return flow;
+                }
+                return _normalFlow;
+            };
+        }
+        case _break:
+        case _continue: {
+            if (loopDepth == 0)
+                error(node->getLine(), "break or continue outside of a loop");
+            Flow flow = node->getToken() == _break ? _breakFlow : _continueFlow;
+            return [flow] { return flow; };
+        }
+        case _return: {
+            IntFunction status = [] { return 0LL; };
+            if (first) {
+                Code value = expression(first);
+                if (value.type == _string)
+                    error(node->getLine(), "The program can only return a number");
+                if (value.type == _float)
+                    status = [real = value.real] { return (long long)real(); };
+                else
+                    status = value.integer;
+            }
+            return [this, status] {
+                exitStatus = (int)status();
+                return _returnFlow;
+            };
+        }
+        case _elif:
+        case _else:
+            error(node->getLine(), "elif/else without a matching if");
+        default:
+            return declaration(node);
+        }
+    }
+
+public:
+    /**
+     * @brief Constructor - compiles a tree
+     *
+     * @param root The root of the tree (usually Parser::getTree())
+     * @throws runtime_error on type errors and undeclared variables
+     */
+    ClosureCompiler(ExpressionNode& root)
+        : scopes(1)
+    {
+        for (ExpressionNode* child = root.getFirstChild(); child; child = child->getNextSibling())
+            program.push_back(statement(child));
+    }
+
+    ClosureCompiler(const ClosureCompiler&) = delete;
+    ClosureCompiler& operator=(const ClosureCompiler&) = delete;
+
+    /**
+     * @brief Runs the compiled program
+     *
+     * @return true if the program executed a top-level return
+     * @throws runtime_error on division by zero
+     */
+    bool run()
+    {
+        for (const Statement& statement : program)
+            if (statement() == _returnFlow)
+                return true;
+        return false;
+    }
+
+    /// @brief Gets the status set by the top-level return (0 if none)
+    int getExitStatus()
+    {
+        return exitStatus;
+    }
+};
@@ -0,0 +1,1208 @@
+/**
+ * @file codegen.hpp
+ * @brief C code generation for the HoPiler transpiler
+ *
+ * The CodeGenerator class turns a parsed (and usually rewritten) tree into a
+ * standalone C99 program. Top-level declarations become globals, the top-level
+ * statements become the body of main(), and a top-level return sets the exit status.
+ *
+ * Generated programs can be instrumented to record how their conditionals behave
+ * (--profile), and a recorded profile can be fed back (--use-profile) so that
+ * biased conditionals get __builtin_expect and never-taken arms are marked cold.
+ *
+ * @author HoPiler Project
+ */
+
+#pragma once
+
+#include "expNode.hpp"
+#include "profile.hpp"
+#include "report.hpp"
+#include "shaker.hpp"
+#include "tokens.hpp"
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+/**
+ * @struct CodegenOptions
+ * @brief Switches that change the emitted C
+ */
+struct CodegenOptions {
+    bool instrument = false; // --profile: count how every conditional behaves
+    bool allocationProfile = false; // --alloc-profile: attribute every allocation to its source line
+    bool module = false; // --serve: a reentrant int ho_module_main(void) instead of main()
+    BranchProfile profile; // --use-profile: counts of a previous run, empty if none
+    CodegenReport* report = nullptr; // --codegen-report: where the emitted C is attributed to source lines
+    bool keepUnreachable = false; // --keep-unreachable: also emit the statements the TreeShaker finds unreachable
+};
+
+/**
+ * @class CodeGenerator
+ * @brief Emits C for a HoLang tree
+ *
+ * Type mapping: int -> long long, float -> double, char -> char, bool -> bool and
+ * string -> char*. Strings are heap-owned by the variable holding them; every
+ * allocation goes through the ho_alloc()/ho_free() pair of the emitted runtime.
+ * Expression results are marked as owned temporaries or borrowed values, so a
+ * temporary is freed by whoever consumes it and a variable is copied on assignment.
+ * String locals are freed when their block is left, including by break, continue
+ * and return.
+ *
+ * HoLang identifiers are emitted with a v_ prefix, so they can never collide with
+ * C keywords, the C library or the ho_ runtime.
+ *
+ * Profile guided layout:
+ * - Every if/elif, while, do and for condition is a branch site, numbered in
+ *   source order
+ * - With CodegenOptions::instrument a site counts its true and false outcomes, and
+ *   the program writes them to <source>.prof on exit (see BranchProfile)
+ * - With a profile, a site seen at least hintMinimumCount times that went one way
+ *   at least hintBias of the time gets HO_LIKELY/HO_UNLIKELY (__builtin_expect)
+ * - An arm whose site ran but which never executed starts with a cold label, so
+ *   GCC moves it out of the hot path (to .text.unlikely with -freorder-blocks-and-partition)
+ * - Runtime helpers that only run on exit or failure are cold and noinline
+ *
+ * Allocation profiling (CodegenOptions::allocationProfile):
+ * - Every call that allocates is preceded by storing its source line in
+ *   ho_alloc_line, so the runtime can attribute the allocation without an extra
+ *   argument on the helpers
+ * - ho_alloc() puts a small header with the line and the allocation clock in front
+ *   of each block; ho_free() uses it to record the lifetime, measured in
+ *   allocations made while the block was live, in a log2 histogram
+ * - At exit the program writes <source>.alloc with one line per allocating source
+ *   line, most bytes first
+ *
+ * With CodegenOptions::module the program becomes `int ho_module_main(void)` for a
+ * shared object (see ModuleServer): the top-level variables are thread-local and
+ * are reset on every call, so calls can run concurrently and never see each other.
+ *
+ * Declarations and assignments of variables that no return or condition depends
+ * on (see TreeShaker) are type checked but emit no C, unless
+ * CodegenOptions::keepUnreachable is set.
+ *
+ * With CodegenOptions::report every emitted line, global and string temporary is
+ * attributed to the statement being emitted (see CodegenReport), and getShards()
+ * splits the program into groups of top-level statements that compile on their
+ * own, for timing the C compiler.
+ *
+ * Tiered execution (see TieredCompiler) uses tierFunction() to turn one loop into
+ * a function that resumes the loop at an iteration boundary: the variables the
+ * loop uses come in and go back out through an array of slots, and a return
+ * inside the loop stores the status and makes the function return 1.
+ *
+ * Example:
+ * ```
+ * CodeGenerator generator(tree);
+ * generator.write("program.ho"); // writes program.c
+ * ```
+ *
+ * @see BranchProfile
+ */
+class CodeGenerator {
+private:
+    static constexpr uint64_t hintMinimumCount = 16;
+    static constexpr double hintBias = 0.9;
+    static constexpr int shardCount = 16; // shards getShards() aims for
+
+    /**
+     * @struct Value
+     * @brief A C expression and what it evaluates to
+     */
+    struct Value {
+        string code;
+        KeyWordType type;
+        bool owned = false; // string temporaries only: the consumer has to free it
+    };
+
+    /**
+     * @struct Scope
+     * @brief Symbols of one HoLang block
+     */
+    struct Scope {
+        unordered_map<string, KeyWordType> symbols;
+        vector<string> strings; // C names of the string locals, freed when the block is left
+        bool loopBody = false;
+    };
+
+    CodegenOptions options;
+    vector<Scope> scopes;
+    vector<string> globals; // C declarations of the top-level variables
+    vector<string> globalResets; // statements giving the top-level variables their initial state again
+    vector<int> siteLines; // source line of every branch site
+    vector<pair<int, size_t>> topLevel; // source line and body offset of every top-level statement
+    stringstream body;
+    int indentation = 1;
+    int coldLabels = 0;
+    int lastAllocationLine = 0;
+    bool tier = false; // generating a tierFunction(): return hands the status to the interpreter
+    TreeShaker* shaker = nullptr; // set while the constructor emits, unless unreachable statements are kept
+    bool silent = false; // type checking an unreachable statement: nothing is emitted
+    int unreachableCount = 0;
+
+    /// @brief Throws a code generation error for a node
+    [[noreturn]] void codegenError(ExpressionNode* node, string message)
+    {
+        throw invalid_argument("Line " + to_string(node->getLine()) + ": " + message);
+    }
+
+    /// @brief Writes one indented line of C to the body of main()
+    void emitLine(string code)
+    {
+        if (silent)
+            return;
+        body << string(indentation * 4, ' ') << code << "\n";
+        if (options.report)
+            options.report->addCode(indentation * 4 + code.size() + 1, code != "{" && code != "}" && code != "} else {");
+    }
+
+    /// @brief Gets the C type of a HoLang data type
+    static string cType(KeyWordType type)
+    {
+        switch (type) {
+        case _float:
+            return "double";
+        case _string:
+            return "char*";
+        case _char:
+            return "char";
+        case _bool:
+            return "bool";
+        default:
+            return "long long";
+        }
+    }
+
+    /// @brief Gets the spelling of an operator, which is also its C spelling for the compound assignments
+    static string operatorName(ExpressionNode* node)
+    {
+        static const char* const names[] = { "+", "-", "*", "/", "%", "**", "and", "or", "not", "xor",
+            "==", "!=", ">=", "<=", ">", "<", "=", "+=", "-=", "*=", "/=", "%=", "**=" };
+        return names[node->getToken()];
+    }
+
+    /// @brief Gets the HoLang name of a data type, for diagnostics
+    static string typeName(KeyWordType type)
+    {
+        switch (type) {
+        case _float:
+            return "float";
+        case _string:
+            return "string";
+        case _char:
+            return "char";
+        case _bool:
+            return "bool";
+        default:
+            return "int";
+        }
+    }
+
+    /**
+     * @brief Escapes text for use inside a C string or character literal
+     *
+     * Non-printable bytes become three digit octal escapes, so a following digit
+     * can never be read as part of the escape.
+     */
+    static string cEscape(const string& text, char quote)
+    {
+        string escaped;
+        for (unsigned char c : text) {
+            switch (c) {
+            case '\n':
+                escaped += "\\n";
+                break;
+            case '\t':
+                escaped += "\\t";
+                break;
+            case '\r':
+                escaped += "\\r";
+                break;
+            case '\\':
+                escaped += "\\\\";
+                break;
+            default:
+                if (c == (unsigned char)quote) {
+                    escaped += '\\';
+                    escaped += quote;
+                } else if (c < 0x20 || c == 0x7f) {
+                    char octal[5];
+                    snprintf(octal, sizeof(octal), "\\%03o", c);
+                    escaped += octal;
+                } else {
+                    escaped += c;
+                }
+            }
+        }
+        return escaped;
+    }
+
+    /**
+     * @brief Gets a string or char literal as C
+     *
+     * The lexer already knows whether a literal has anything to escape; most do
+     * not, and are copied into the quotes in one go instead of byte by byte.
+     */
+    static string cLiteral(ExpressionNode* node, char quote)
+    {
+        const string& text = node->getTokenText();
+        if (node->isEscaped())
+            return quote + cEscape(text, quote) + quote;
+        string literal;
+        literal.reserve(text.size() + 2);
+        literal += quote;
+        literal += text;
+        literal += quote;
+        return literal;
+    }
+
+    /// @brief Gets the result type of an arithmetic operator
+    static KeyWordType arithmeticType(const Value& left, const Value& right)
+    {
+        return left.type == _float || right.type == _float ? _float : _int;
+    }
+
+    /**
+     * @brief Marks a runtime call that allocates
+     *
+     * @param call The C call
+     * @param node The node the allocation belongs to
+     * @return The call, tagged with the node's line when profiling allocations
+     */
+    string allocating(string call, ExpressionNode* node)
+    {
+        if (silent)
+            return call;
+        if (options.report)
+            options.report->addTemporary();
+        if (!options.allocationProfile)
+            return call;
+        lastAllocationLine = max(lastAllocationLine, node->getLine());
+        return "(ho_alloc_line = " + to_string(node->getLine()) + ", " + call + ")";
+    }
+
+    /// @brief Gets a string value as an owned buffer, copying it if it is borrowed
+    string ownedString(const Value& value, ExpressionNode* node)
+    {
+        return value.owned ? value.code : allocating("ho_str_copy(" + value.code + ")", node);
+    }
+
+    /// @brief Frees a string temporary, for expressions whose result is unused
+    static string discard(const Value& value)
+    {
+        return value.owned ? "ho_free(" + value.code + ");" : "(void)(" + value.code + ");";
+    }
+
+    /**
+     * @brief Looks up a variable through the enclosing scopes
+     *
+     * @throws invalid_argument if the variable is not declared
+     */
+    KeyWordType lookup(ExpressionNode* node)
+    {
+        string name = node->getTokenValue();
+        for (int i = scopes.size() - 1; i >= 0; i--) {
+            auto found = scopes[i].symbols.find(name);
+            if (found != scopes[i].symbols.end())
+                return found->second;
+        }
+        codegenError(node, "Use of undeclared variable " + name);
+    }
+
+    /**
+     * @brief Declares a variable in the innermost scope
+     *
+     * @return The C name of the variable
+     * @throws invalid_argument if the scope already declares it
+     */
+    string declare(ExpressionNode* node, KeyWordType type)
+    {
+        string name = node->getTokenValue();
+        if (!scopes.back().symbols.emplace(name, type).second)
+            codegenError(node, "Variable " + name + " is already declared in this block");
+        if (type == _string && scopes.size() > 1 && !silent)
+            scopes.back().strings.push_back("v_" + name);
+        return "v_" + name;
+    }
+
+    /// @brief Checks that a value can be stored in a variable of the given type
+    void requireAssignable(ExpressionNode* node, KeyWordType target, const Value& value)
+    {
+        if ((target == _string) != (value.type == _string))
+            codegenError(node, "Cannot assign a " + typeName(value.type) + " to a " + typeName(target));
+    }
+
+    /**
+     * @brief Emits the frees of the string locals of scopes[from..]
+     *
+     * Used when a block is left, either normally or by a jump.
+     */
+    void releaseScopes(int from)
+    {
+        for (int i = scopes.size() - 1; i >= from; i--)
+            for (auto name = scopes[i].strings.rbegin(); name != scopes[i].strings.rend(); name++)
+                emitLine("ho_str_set(&" + *name + ", NULL);");
+    }
+
+    /// @brief Gets the index of the innermost loop body scope, or -1 outside loops
+    int innermostLoop()
+    {
+        for (int i = scopes.size() - 1; i > 0; i--)
+            if (scopes[i].loopBody)
+                return i;
+        return -1;
+    }
+
+    /**
+     * @brief Emits a binary operator
+     *
+     * Strings support + (concatenation) and the comparisons; every other operator
+     * needs numbers.
+     */
+    Value emitBinary(ExpressionNode* node, int op, const Value& left, const Value& right)
+    {
+        bool strings = left.type == _string || right.type == _string;
+        if (strings && !(left.type == _string && right.type == _string))
+            codegenError(node, "Cannot combine a " + typeName(left.type) + " with a " + typeName(right.type));
+
+        static const char* const cOperators[] = { "+", "-", "*", "/", "%", "", "&&", "||", "", "",
+            "==", "!=", ">=", "<=", ">", "<" };
+        switch (op) {
+        case _add:
+            if (strings)
+                return { allocating("ho_str_concat(" + left.code + ", " + (left.owned ? "1" : "0") + ", " + right.code + ", " + (right.owned ? "1" : "0") + ")", node), _string, true };
+            [[fallthrough]];
+        case _sub:
+        case _mul:
+        case _div:
+            if (strings)
+                break;
+            return { "(" + left.code + " " + cOperators[op] + " " + right.code + ")", arithmeticType(left, right) };
+        case _mod:
+            if (strings)
+                break;
+            if (arithmeticType(left, right) == _float)
+                return { "fmod(" + left.code + ", " + right.code + ")", _float };
+            return { "(" + left.code + " % " + right.code + ")", _int };
+        case _pow:
+            if (strings)
+                break;
+            if (arithmeticType(left, right) == _float)
+                return { "pow(" + left.code + ", " + right.code + ")", _float };
+            return { "ho_ipow(" + left.code + ", " + right.code + ")", _int };
+        case _and:
+        case _or:
+            if (strings)
+                break;
+            return { "(" + left.code + " " + cOperators[op] + " " + right.code + ")", _bool };
+        case _xor:
+            if (strings)
+                break;
+            return { "(!(" + left.code + ") != !(" + right.code + "))", _bool };
+        case _eq:
+        case _neq:
+        case _gte:
+        case _lte:
+        case _gt:
+        case _lt:
+            if (strings)
+                return { "(ho_str_compare(" + left.code + ", " + (left.owned ? "1" : "0") + ", " + right.code + ", " + (right.owned ? "1" : "0") + ") " + cOperators[op] + " 0)", _bool };
+            return { "(" + left.code + " " + cOperators[op] + " " + right.code + ")", _bool };
+        default:
+            codegenError(node, "Assignment used as a value");
+        }
+        codegenError(node, "Operator " + operatorName(node) + " does not apply to strings");
+    }
+
+    /**
+     * @brief Emits an expression
+     *
+     * @param node Root of the expression subtree
+     * @return The C code, its type and whether it is an owned string temporary
+     */
+    Value emitExpression(ExpressionNode* node)
+    {
+        switch (node->getTokenType()) {
+        case _literal:
+            switch (node->getToken()) {
+            case _intLit:
+                return { node->getTokenValue(), _int };
+            case _floatLit:
+                return { node->getTokenValue(), _float };
+            case _charLit:
+                return { cLiteral(node, '\''), _char };
+            default:
+                return { cLiteral(node, '"'), _string };
+            }
+        case _identifier: {
+            string name = node->getTokenValue();
+            bool declared = false;
+            for (Scope& scope : scopes)
+                declared = declared || scope.symbols.count(name);
+            if (!declared && (name == "true" || name == "false"))
+                return { name, _bool }; // HoLang has no bool literals yet, so undeclared true/false stand in
+            return { "v_" + name, lookup(node) };
+        }
+        case _operator: {
+            ExpressionNode* left = node->getFirstChild();
+            if (node->getChildCount() == 1) {
+                Value operand = emitExpression(left);
+                if (operand.type == _string)
+                    codegenError(node, "Operator " + operatorName(node) + " does not apply to strings");
+                if (node->getToken() == _not)
+                    return { "(!" + operand.code + ")", _bool };
+                return { "(-" + operand.code + ")", operand.type == _float ? _float : _int };
+            }
+            Value leftValue = emitExpression(left);
+            return emitBinary(node, node->getToken(), leftValue, emitExpression(left->getNextSibling()));
+        }
+        default:
+            codegenError(node, "Expected an expression");
+        }
+    }
+
+    /**
+     * @brief Emits an assignment as a C expression
+     *
+     * Compound assignments on strings only support +=; **= and float %= expand to
+     * the pow()/fmod() calls their operators use.
+     */
+    string emitAssignment(ExpressionNode* node)
+    {
+        ExpressionNode* target = node->getFirstChild();
+        if (target->getTokenType() != _identifier)
+            codegenError(node, "Only variables can be assigned to");
+        KeyWordType type = lookup(target);
+        string name = "v_" + target->getTokenValue();
+        Value value = emitExpression(target->getNextSibling());
+        requireAssignable(node, type, value);
+
+        int op = node->getToken();
+        if (type == _string) {
+            if (op == _ass)
+                return "ho_str_set(&" + name + ", " + ownedString(value, node) + ")";
+            if (op == _assAdd)
+                return "ho_str_set(&" + name + ", " + allocating("ho_str_concat(" + name + ", 0, " + value.code + ", " + (value.owned ? "1" : "0") + ")", node) + ")";
+            codegenError(node, "Operator " + operatorName(node) + " does not apply to strings");
+        }
+        if (op == _ass)
+            return name + " = " + value.code;
+        if (op == _assPow || (op == _assMod && (type == _float || value.type == _float)))
+            return name + " = " + emitBinary(node, op == _assPow ? _pow : _mod, { name, type }, value).code;
+        return name + " " + operatorName(node) + " " + value.code;
+    }
+
+    /**
+     * @brief Emits a declaration statement
+     *
+     * Top-level variables become globals initialised in main(); block variables
+     * become C locals, zero (or NULL for strings) when there is no initialiser.
+     */
+    void emitDeclaration(ExpressionNode* node)
+    {
+        KeyWordType type = (KeyWordType)node->getToken();
+        ExpressionNode* child = node->getFirstChild();
+        bool initialised = child->getTokenType() == _operator;
+        ExpressionNode* nameNode = initialised ? child->getFirstChild() : child;
+
+        Value value { type == _string ? "NULL" : "0", type };
+        if (initialised) {
+            value = emitExpression(nameNode->getNextSibling());
+            requireAssignable(node, type, value);
+        }
+        string initialiser = type == _string && initialised ? ownedString(value, node) : value.code;
+        string name = declare(nameNode, type);
+
+        if (scopes.size() == 1 && !silent) {
+            globals.push_back(cType(type) + " " + name + ";");
+            if (options.report)
+                options.report->addCode(globals.back().size() + 1, true);
+            globalResets.push_back(type == _string ? "ho_str_set(&" + name + ", NULL);" : name + " = 0;");
+            if (initialised)
+                emitLine((type == _string ? "ho_str_set(&" + name + ", " + initialiser + ")" : name + " = " + initialiser) + ";");
+            return;
+        }
+        emitLine(cType(type) + " " + name + " = " + initialiser + ";");
+    }
+
+    /// @brief Emits a declaration, assignment or expression as a statement
+    void emitSimpleStatement(ExpressionNode* node)
+    {
+        if (node->getTokenType() == _keyWord) {
+            emitDeclaration(node);
+        } else if (node->getTokenType() == _operator && node->getToken() >= _ass) {
+            emitLine(emitAssignment(node) + ";");
+        } else {
+            emitLine(discard(emitExpression(node)));
+        }
+    }
+
+    /**
+     * @brief Emits a condition as a branch site
+     *
+     * @param node The condition expression
+     * @param site Set to the number of the new site
+     * @return The C condition, instrumented and/or hinted as configured
+     */
+    string emitCondition(ExpressionNode* node, int& site)
+    {
+        Value value = emitExpression(node);
+        if (value.type == _string)
+            codegenError(node, "A string cannot be used as a condition");
+
+        site = siteLines.size();
+        siteLines.push_back(node->getLine());
+        string code = value.code;
+        if (options.instrument)
+            code = "HO_BRANCH(" + to_string(site) + ", " + code + ")";
+
+        if (options.profile.has(site, node->getLine())) {
+            double trueCount = options.profile.getTrueCount(site);
+            double total = trueCount + options.profile.getFalseCount(site);
+            if (total >= hintMinimumCount && trueCount >= hintBias * total)
+                return "HO_LIKELY(" + code + ")";
+            if (total >= hintMinimumCount && trueCount <= (1 - hintBias) * total)
+                return "HO_UNLIKELY(" + code + ")";
+        }
+        return code;
+    }
+
+    /**
+     * @brief Checks whether one arm of a site never ran although the site did
+     *
+     * @param site The branch site
+     * @param line Source line of the site
+     * @param whenTrue true for the arm taken when the condition holds
+     */
+    bool isColdArm(int site, int line, bool whenTrue)
+    {
+        if (!options.profile.has(site, line))
+            return false;
+        uint64_t trueCount = options.profile.getTrueCount(site);
+        uint64_t falseCount = options.profile.getFalseCount(site);
+        return trueCount + falseCount > 0 && (whenTrue ? trueCount : falseCount) == 0;
+    }
+
+    /**
+     * @brief Emits the statements of a block inside a new scope
+     *
+     * The caller writes the line with the opening brace and the closing brace.
+     *
+     * @param block The block node (or nullptr for an empty one)
+     * @param loopBody Whether break and continue leave this scope
+     * @param cold Whether the block starts with a cold label
+     */
+    void emitBlock(ExpressionNode* block, bool loopBody, bool cold = false)
+    {
+        indentation++;
+        scopes.push_back(Scope { {}, {}, loopBody });
+        if (cold)
+            emitLine("HO_COLD_PATH(ho_cold_" + to_string(coldLabels++) + ")");
+        for (ExpressionNode* child = block ? block->getFirstChild() : nullptr; child; child = child->getNextSibling())
+            emitStatement(child);
+        releaseScopes(scopes.size() - 1);
+        scopes.pop_back();
+        indentation--;
+    }
+
+    /**
+     * @brief Emits an if statement with its elif and else arms
+     *
+     * An elif chain is emitted as else if, so every arm after the first is the
+     * false arm of the previous site.
+     */
+    void emitIf(ExpressionNode* node)
+    {
+        ExpressionNode* condition = node->getFirstChild();
+        ExpressionNode* block = condition->getNextSibling();
+        string keyword = "if";
+        bool coldElse = false;
+        ExpressionNode* arm = node;
+
+        while (true) {
+            int site;
+            string code = emitCondition(condition, site);
+            emitLine((keyword == "if" ? "" : "} ") + keyword + " (" + code + ") {");
+            emitBlock(block, false, coldElse || isColdArm(site, condition->getLine(), true));
+            coldElse = coldElse || isColdArm(site, condition->getLine(), false);
+
+            arm = arm == node ? block->getNextSibling() : arm->getNextSibling();
+            if (!arm)
+                break;
+            if (arm->getToken() == _else) {
+                emitLine("} else {");
+                emitBlock(arm->getFirstChild(), false, coldElse);
+                break;
+            }
+            keyword = "else if";
+            condition = arm->getFirstChild();
+            block = condition->getNextSibling();
+        }
+        emitLine("}");
+    }
+
+    /// @brief Emits a break or continue, freeing the string locals of the loop body first
+    void emitJump(ExpressionNode* node)
+    {
+        int loop = innermostLoop();
+        if (loop == -1)
+            codegenError(node, string(node->getToken() == _break ? "break" : "continue") + " outside of a loop");
+        releaseScopes(loop);
+        emitLine(node->getToken() == _break ? "break;" : "continue;");
+    }
+
+    /// @brief Emits the C that ends the program (or a tier function) with a status
+    void emitExit(string status)
+    {
+        if (tier) {
+            emitLine("*ho_status = " + status + ";");
+            emitLine("return 1;");
+        } else {
+            emitLine("return " + status + ";");
+        }
+    }
+
+    /// @brief Emits a return, which ends the program with the value as its exit status
+    void emitReturn(ExpressionNode* node)
+    {
+        string status = "0";
+        if (node->getFirstChild()) {
+            Value value = emitExpression(node->getFirstChild());
+            if (value.type == _string)
+                codegenError(node, "The program can only return a number");
+            status = "(int)" + value.code;
+        }
+
+        bool locals = false;
+        for (int i = 1; i < (int)scopes.size(); i++)
+            locals = locals || !scopes[i].strings.empty();
+        if (!locals) {
+            emitExit(status);
+            return;
+        }
+        emitLine("{");
+        indentation++;
+        emitLine("int ho_exit = " + status + ";");
+        releaseScopes(1);
+        emitExit("ho_exit");
+        indentation--;
+        emitLine("}");
+    }
+
+    /// @brief Gets the construct kind of a statement, as the codegen report names it
+    static string statementKind(ExpressionNode* node)
+    {
+        static const char* const keywords[] = { "if", "elif", "else", "for", "while", "do", "return", "break", "continue" };
+        if (node->getTokenType() == _expression)
+            return "block";
+        if (node->getTokenType() == _keyWord)
+            return node->getToken() >= _int ? "declaration" : keywords[node->getToken()];
+        return node->getTokenType() == _operator && node->getToken() >= _ass ? "assignment" : "expression";
+    }
+
+    /// @brief Emits one statement of a block, attributing its C to it when reporting
+    void emitStatement(ExpressionNode* node)
+    {
+        if (shaker && shaker->isUnreachable(node)) {
+            silent = true;
+            emitSimpleStatement(node);
+            silent = false;
+            unreachableCount++;
+            return;
+        }
+        if (!options.report) {
+            emitStatementCode(node);
+            return;
+        }
+        options.report->enter(node->getLine(), statementKind(node));
+        emitStatementCode(node);
+        options.report->leave();
+    }
+
+    /// @brief Emits one statement, see emitStatement()
+    void emitStatementCode(ExpressionNode* node)
+    {
+        if (node->getTokenType() == _expression) {
+            emitLine("{");
+            emitBlock(node, false);
+            emitLine("}");
+            return;
+        }
+        if (node->getTokenType() != _keyWord || node->getToken() >= _int) {
+            emitSimpleStatement(node);
+            return;
+        }
+
+        ExpressionNode* first = node->getFirstChild();
+        int site;
+        switch (node->getToken()) {
+        case _if:
+            emitIf(node);
+            return;
+        case _while: {
+            string code = emitCondition(first, site);
+            emitLine("while (" + code + ") {");
+            emitBlock(first->getNextSibling(), true, isColdArm(site, first->getLine(), true));
+            emitLine("}");
+            return;
+        }
+        case _do: {
+            emitLine("do {");
+            emitBlock(first, true);
+            emitLine("} while (" + emitCondition(first->getNextSibling(), site) + ");");
+            return;
+        }
+        case _for:
+            emitFor(node, true);
+            return;
+        case _break:
+        case _continue:
+            emitJump(node);
+            return;
+        case _return:
+            emitReturn(node);
+            return;
+        default:
+            codegenError(node, "elif/else without a matching if");
+        }
+    }
+
+    /**
+     * @brief Emits a for loop in a scope of its own
+     *
+     * @param withInit false to leave out the init statement (a tier function resumes
+     *                 a loop whose init already ran)
+     */
+    void emitFor(ExpressionNode* node, bool withInit)
+    {
+        ExpressionNode* first = node->getFirstChild();
+        ExpressionNode* condition = first->getNextSibling();
+        ExpressionNode* step = condition->getNextSibling();
+        int site;
+        emitLine("{");
+        indentation++;
+        scopes.push_back(Scope {});
+        if (withInit)
+            emitSimpleStatement(first);
+        string code = emitCondition(condition, site);
+        string stepCode = step->getTokenType() == _operator && step->getToken() >= _ass ? emitAssignment(step) : "";
+        if (stepCode.empty())
+            codegenError(step, "The for step has to be an assignment");
+        emitLine("for (; " + code + "; " + stepCode + ") {");
+        emitBlock(step->getNextSibling(), true, isColdArm(site, condition->getLine(), true));
+        emitLine("}");
+        releaseScopes(scopes.size() - 1);
+        scopes.pop_back();
+        indentation--;
+        emitLine("}");
+    }
+
+    /// @brief Gets the runtime every generated program starts with
+    static string runtime()
+    {
+        return R"(#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__GNUC__)
+#define HO_LIKELY(x) __builtin_expect(!!(x), 1)
+#define HO_UNLIKELY(x) __builtin_expect(!!(x), 0)
+#define HO_COLD __attribute__((cold, noinline))
+#else
+#define HO_LIKELY(x) (x)
+#define HO_UNLIKELY(x) (x)
+#define HO_COLD
+#endif
+
+#if defined(__GNUC__) && !defined(__clang__)
+#define HO_COLD_PATH(label) label: __attribute__((cold, unused));
+#else
+#define HO_COLD_PATH(label)
+#endif
+
+static HO_COLD void ho_out_of_memory(void)
+{
+    fputs("HoLang runtime: out of memory\n", stderr);
+    exit(EXIT_FAILURE);
+}
+
+#ifdef HO_ALLOC_PROFILE
+#define HO_LIFETIME_BUCKETS 16
+
+typedef struct {
+    unsigned long long allocations, bytes, frees;
+    unsigned long long lifetimes[HO_LIFETIME_BUCKETS];
+} ho_alloc_stats;
+
+typedef union {
+    struct {
+        unsigned long long birth;
+        int line;
+    } info;
+    long double alignment;
+} ho_alloc_header;
+
+static ho_alloc_stats ho_alloc_lines[HO_ALLOC_LINES + 1];
+static int ho_alloc_line;
+static unsigned long long ho_alloc_clock;
+
+static inline void* ho_alloc(size_t size)
+{
+    ho_alloc_header* header = (ho_alloc_header*)malloc(sizeof(ho_alloc_header) + size);
+    if (HO_UNLIKELY(header == NULL))
+        ho_out_of_memory();
+    header->info.birth = ho_alloc_clock++;
+    header->info.line = ho_alloc_line;
+    ho_alloc_lines[ho_alloc_line].allocations++;
+    ho_alloc_lines[ho_alloc_line].bytes += size;
+    return header + 1;
+}
+
+static inline void ho_free(const void* memory)
+{
+    if (memory == NULL)
+        return;
+    ho_alloc_header* header = (ho_alloc_header*)memory - 1;
+    unsigned long long age = ho_alloc_clock - header->info.birth - 1;
+    int bucket = 0;
+    for (; age > 0 && bucket < HO_LIFETIME_BUCKETS - 1; age >>= 1)
+        bucket++;
+    ho_alloc_lines[header->info.line].frees++;
+    ho_alloc_lines[header->info.line].lifetimes[bucket]++;
+    free(header);
+}
+
+static int ho_compare_alloc_lines(const void* left, const void* right)
+{
+    unsigned long long leftBytes = ho_alloc_lines[*(const int*)left].bytes;
+    unsigned long long rightBytes = ho_alloc_lines[*(const int*)right].bytes;
+    return leftBytes < rightBytes ? 1 : leftBytes > rightBytes ? -1 : *(const int*)left - *(const int*)right;
+}
+
+static HO_COLD void ho_write_alloc_report(void)
+{
+    int lines[HO_ALLOC_LINES + 1], count = 0;
+    for (int line = 0; line <= HO_ALLOC_LINES; line++)
+        if (ho_alloc_lines[line].allocations > 0)
+            lines[count++] = line;
+    qsort(lines, count, sizeof(int), ho_compare_alloc_lines);
+
+    FILE* file = fopen(HO_ALLOC_REPORT_PATH, "w");
+    if (file == NULL)
+        return;
+    fputs("# HoPiler allocation profile v1\n", file);
+    fputs("# line allocations bytes live-at-exit | lifetime histogram in allocations survived: 0 1 2-3 4-7 ... 16384+\n", file);
+    for (int i = 0; i < count; i++) {
+        ho_alloc_stats* stats = &ho_alloc_lines[lines[i]];
+        fprintf(file, "line %d %llu %llu %llu |", lines[i], stats->allocations, stats->bytes, stats->allocations - stats->frees);
+        for (int bucket = 0; bucket < HO_LIFETIME_BUCKETS; bucket++)
+            fprintf(file, " %llu", stats->lifetimes[bucket]);
+        fputc('\n', file);
+    }
+    fclose(file);
+}
+#else
+static inline void* ho_alloc(size_t size)
+{
+    void* memory = malloc(size);
+    if (HO_UNLIKELY(memory == NULL))
+        ho_out_of_memory();
+    return memory;
+}
+
+static inline void ho_free(const void* memory)
+{
+    free((void*)memory);
+}
+#endif
+
+static inline char* ho_str_copy(const char* text)
+{
+    size_t length = text ? strlen(text) : 0;
+    char* copy = (char*)ho_alloc(length + 1);
+    memcpy(copy, text ? text : "", length);
+    copy[length] = '\0';
+    return copy;
+}
+
+static inline char* ho_str_concat(const char* left, int ownsLeft, const char* right, int ownsRight)
+{
+    size_t leftLength = left ? strlen(left) : 0;
+    size_t rightLength = right ? strlen(right) : 0;
+    char* result = (char*)ho_alloc(leftLength + rightLength + 1);
+    memcpy(result, left ? left : "", leftLength);
+    memcpy(result + leftLength, right ? right : "", rightLength);
+    result[leftLength + rightLength] = '\0';
+    if (ownsLeft)
+        ho_free(left);
+    if (ownsRight)
+        ho_free(right);
+    return result;
+}
+
+static inline int ho_str_compare(const char* left, int ownsLeft, const char* right, int ownsRight)
+{
+    int result = strcmp(left ? left : "", right ? right : "");
+    if (ownsLeft)
+        ho_free(left);
+    if (ownsRight)
+        ho_free(right);
+    return result;
+}
+
+static inline void ho_str_set(char** target, char* value)
+{
+    ho_free(*target);
+    *target = value;
+}
+
+static inline long long ho_ipow(long long base, long long exponent)
+{
+    unsigned long long result = 1, factor = (unsigned long long)base;
+    if (exponent < 0)
+        return base == 1 ? 1 : base == -1 ? (exponent % 2 ? -1 : 1) : 0;
+    for (; exponent > 0; exponent >>= 1) {
+        if (exponent & 1)
+            result *= factor;
+        factor *= factor;
+    }
+    return (long long)result;
+}
+)";
+    }
+
+    /// @brief Gets the branch counters and the profile writer of an instrumented program
+    string profileRuntime()
+    {
+        stringstream code;
+        int sites = siteLines.size();
+        code << "\nstatic unsigned long long ho_branch_counts[" << max(sites, 1) << "][2];\n"
+             << "static const int ho_branch_lines[" << max(sites, 1) << "] = {";
+        for (int i = 0; i < sites; i++)
+            code << (i ? ", " : " ") << siteLines[i];
+        code << (sites ? " };\n" : " 0 };\n");
+        code << R"(
+#define HO_BRANCH(site, condition) ((condition) ? (ho_branch_counts[site][0]++, 1) : (ho_branch_counts[site][1]++, 0))
+
+static HO_COLD void ho_write_profile(void)
+{
+    FILE* file = fopen(HO_PROFILE_PATH, "w");
+    if (file == NULL)
+        return;
+    fputs("# HoPiler branch profile v1\n", file);
+)";
+        code << "    for (int site = 0; site < " << sites << "; site++)\n"
+             << "        fprintf(file, \"branch %d %d %llu %llu\\n\", site, ho_branch_lines[site], ho_branch_counts[site][0], ho_branch_counts[site][1]);\n"
+             << "    fclose(file);\n}\n";
+        return code.str();
+    }
+
+    /// @brief Gets the program up to the first statement of main() (or ho_module_main())
+    string prelude(string sourceName)
+    {
+        stringstream code;
+        code << "/* Generated by HoPiler from " << sourceName << ". Do not edit. */\n";
+        if (options.instrument)
+            code << "#define HO_PROFILE_PATH \"" << cEscape(sourceName + ".prof", '"') << "\"\n";
+        if (options.allocationProfile)
+            code << "#define HO_ALLOC_PROFILE\n"
+                 << "#define HO_ALLOC_LINES " << lastAllocationLine << "\n"
+                 << "#define HO_ALLOC_REPORT_PATH \"" << cEscape(sourceName + ".alloc", '"') << "\"\n";
+        code << runtime();
+        if (options.instrument)
+            code << profileRuntime();
+
+        if (!globals.empty())
+            code << "\n";
+        for (string& global : globals)
+            code << (options.module ? "static _Thread_local " : "") << global << "\n";
+
+        if (options.module) {
+            code << "\nint ho_module_main(void)\n{\n";
+            for (string& reset : globalResets)
+                code << "    " << reset << "\n";
+            return code.str();
+        }
+        code << "\nint main(void)\n{\n";
+        if (options.instrument)
+            code << "    atexit(ho_write_profile);\n";
+        if (options.allocationProfile)
+            code << "    atexit(ho_write_alloc_report);\n";
+        return code.str();
+    }
+
+    /// @brief Constructor - an empty generator, filled in by tierFunction()
+    CodeGenerator() { }
+
+public:
+    /**
+     * @brief Constructor - generates the body of main() for a tree
+     *
+     * @param root The root of the tree (usually Parser::getTree() after rewriting)
+     * @param options Instrumentation and profile switches
+     * @throws invalid_argument on type errors and undeclared variables, also in
+     *         unreachable statements
+     */
+    CodeGenerator(ExpressionNode& root, CodegenOptions options = {})
+        : options(options)
+    {
+        optional<TreeShaker> reachability;
+        if (!options.keepUnreachable)
+            shaker = &reachability.emplace(root);
+        scopes.push_back(Scope {});
+        for (ExpressionNode* child = root.getFirstChild(); child; child = child->getNextSibling()) {
+            topLevel.emplace_back(child->getLine(), body.tellp());
+            emitStatement(child);
+        }
+        shaker = nullptr;
+    }
+
+    /**
+     * @brief Generates a C function that resumes a loop at an iteration boundary
+     *
+     * The function is `int ho_tier(ho_slot* ho_slots, int* ho_status)`. Slot i holds
+     * variables[i] on entry (.f for floats, .i for everything else) and gets its
+     * final value back. It returns 0 when the loop ends and 1 after a return, whose
+     * value is stored in *ho_status. A while or for loop resumes at its condition,
+     * a do loop at its body.
+     *
+     * @param loop A while, do or for node
+     * @param variables Names and types of the variables the loop uses from outside; no strings
+     * @return The C source of a shared object exporting ho_tier
+     * @throws invalid_argument if the loop does not compile
+     */
+    static string tierFunction(ExpressionNode* loop, const vector<pair<string, KeyWordType>>& variables)
+    {
+        CodeGenerator generator;
+        generator.tier = true;
+        generator.scopes.push_back(Scope {}); // empty global scope
+        generator.scopes.push_back(Scope {}); // the incoming variables, locals of ho_tier
+
+        stringstream code;
+        code << "/* Generated by HoPiler for the loop on line " << loop->getLine() << ". Do not edit. */\n"
+             << runtime()
+             << "\ntypedef union {\n    long long i;\n    double f;\n} ho_slot;\n\n"
+             << "int ho_tier(ho_slot* ho_slots, int* ho_status)\n{\n";
+        for (size_t i = 0; i < variables.size(); i++) {
+            auto& [name, type] = variables[i];
+            if (type == _string)
+                throw invalid_argument("String variables cannot cross into a tier function");
+            generator.scopes.back().symbols.emplace(name, type);
+            code << "    " << cType(type) << " v_" << name << " = (" << cType(type) << ")ho_slots[" << i << "]." << (type == _float ? "f" : "i") << ";\n";
+        }
+
+        if (loop->getToken() == _for)
+            generator.emitFor(loop, false);
+        else
+            generator.emitStatement(loop);
+        code << generator.body.str();
+
+        for (size_t i = 0; i < variables.size(); i++)
+            code << "    ho_slots[" << i << "]." << (variables[i].second == _float ? "f" : "i") << " = v_" << variables[i].first << ";\n";
+        code << "    return 0;\n}\n";
+        return code.str();
+    }
+
+    /**
+     * @brief Assembles the complete C program
+     *
+     * @param sourceName The source file the program is generated for; it only ends
+     *                   up in the header comment and the profile and report paths,
+     *                   so the rest of the text is the same for identical sources
+     * @return The C source text
+     */
+    string getCode(string sourceName)
+    {
+        string code = prelude(sourceName) + body.str() + "    return 0;\n}\n";
+        if (options.report)
+            options.report->setRuntimeBytes(code.size() - options.report->getProgramBytes());
+        return code;
+    }
+
+    /**
+     * @brief Gets the program without any statements, the common part of all shards
+     *
+     * @param sourceName As for getCode()
+     */
+    string getSkeleton(string sourceName)
+    {
+        return prelude(sourceName) + "    return 0;\n}\n";
+    }
+
+    /**
+     * @brief Splits the program into shards that compile on their own
+     *
+     * Top-level variables are globals, so any run of top-level statements is valid C
+     * on its own inside the skeleton. Consecutive statements are grouped into
+     * shards of about the same amount of statement code.
+     *
+     * @param sourceName As for getCode()
+     * @param count How many shards to aim for; a big statement can make fewer
+     * @return First source line and complete C source of every shard
+     */
+    vector<pair<int, string>> getShards(string sourceName, int count = shardCount)
+    {
+        string statements = body.str(), start = prelude(sourceName);
+        size_t minimumBytes = max<size_t>(statements.size() / count, 1);
+        vector<pair<int, string>> shards;
+        for (size_t i = 0; i < topLevel.size();) {
+            size_t j = i + 1;
+            while (j < topLevel.size() && topLevel[j].second - topLevel[i].second < minimumBytes)
+                j++;
+            size_t end = j < topLevel.size() ? topLevel[j].second : statements.size();
+            shards.emplace_back(topLevel[i].first, start + statements.substr(topLevel[i].second, end - topLevel[i].second) + "    return 0;\n}\n");
+            i = j;
+        }
+        return shards;
+    }
+
+    /**
+     * @brief Gets the name of the C file generated for a source file
+     *
+     * @return The source name with .ho replaced by .c (or .c appended)
+     */
+    static string outputFileName(string sourceName)
+    {
+        if (sourceName.size() > 3 && sourceName.compare(sourceName.size() - 3, 3, ".ho") == 0)
+            return sourceName.substr(0, sourceName.size() - 3) + ".c";
+        return sourceName + ".c";
+    }
+
+    /**
+     * @brief Writes the program for a source file next to it
+     *
+     * @param sourceName The source file the program is generated for
+     * @return The name of the written C file
+     * @throws invalid_argument if the output file cannot be written
+     */
+    string write(string sourceName)
+    {
+        string outputName = outputFileName(sourceName);
+        ofstream output(outputName);
+        if (!output.is_open())
+            throw invalid_argument("Could not write " + outputName);
+        output << getCode(sourceName);
+        return outputName;
+    }
+
+    /// @brief Gets the number of branch sites in the program
+    int getSiteCount()
+    {
+        return siteLines.size();
+    }
+
+    /// @brief Gets the number of declarations and assignments left out as unreachable
+    int getUnreachableCount()
+    {
+        return unreachableCount;
+    }
+};
@@ -0,0 +1,1185 @@
+/**
+ * @file embedded.hpp
+ * @brief Compile-time tokenizer, parser and evaluator for HoLang embedded in C++
+ *
+ * EmbeddedProgram lexes and parses a HoLang source given as a C++ string literal
+ * inside a constant expression: no iostream, no exceptions and no allocation, only
+ * fixed-capacity arrays sized by template parameters. A source that does not lex or
+ * parse is not an exception but a state (ok(), getError(), getErrorLine()), so a
+ * static_assert can report it. run() interprets the tree in a constant expression
+ * too, with the Interpreter's semantics for int, float, char and bool.
+ *
+ * The grammar and tree shapes are the Parser's, predicted from the same FIRST-set
+ * tables (grammar.hpp) and climbing with the same priorities (Token::priorityOf()).
+ * Parser::treeOf() turns the result into an ordinary ExpressionNode tree, so a
+ * program embedded this way reaches the Interpreter or the code generator without
+ * lexing or parsing at run time.
+ *
+ * Where the Tokenizer is lenient, this one reports an error instead: a newline or
+ * the end of input inside a literal, a backslash outside of one, and a quote in
+ * the middle of a word.
+ *
+ * @author HoPiler Project
+ */
+
+#pragma once
+
+#include "grammar.hpp"
+#include "tokens.hpp"
+#include "utf8.hpp"
+#include <cstddef>
+#include <string_view>
+
+using namespace std;
+
+/**
+ * @struct EmbeddedResult
+ * @brief What EmbeddedProgram::run() ended with
+ */
+struct EmbeddedResult {
+    int status = 0; // the value of the top-level return as an exit status, 0 without one
+    const char* error = nullptr; // the run-time error, as the Interpreter words it
+    int line = 0; // source line of the error
+
+    constexpr bool ok() const
+    {
+        return error == nullptr;
+    }
+};
+
+/**
+ * @class EmbeddedProgram
+ * @brief A HoLang program tokenized, parsed and optionally run during C++ compilation
+ *
+ * @tparam MaxNodes Capacity of the tree, including the root and one node per block
+ * @tparam MaxText Capacity for the text of identifiers and literals (decoded)
+ * @tparam MaxVariables Capacity of run() for variables live at the same time
+ *
+ * Tokens are lexed one at a time as the parser asks for them, so only the tree is
+ * stored. Nodes are linked by index (first child, next sibling) like ExpressionNode
+ * is by pointer. A program that does not fit its capacities fails to parse with an
+ * error saying so; embedHoLang() sizes both from the literal, which always fits.
+ *
+ * Strings can be lexed, parsed and converted with Parser::treeOf(), but not run:
+ * run() reports an error for any string value.
+ *
+ * Example:
+ * ```
+ * constexpr auto answer = embedHoLang("int x = 6 * 7\nreturn x\n");
+ * static_assert(answer.ok(), "syntax error");
+ * static_assert(answer.run().status == 42);
+ *
+ * ExpressionNode tree = Parser::treeOf(answer); // built at run time, from the constant tree
+ * ```
+ */
+template <size_t MaxNodes = 256, size_t MaxText = 1024, size_t MaxVariables = 64>
+class EmbeddedProgram {
+public:
+    /**
+     * @struct Node
+     * @brief One node of the tree, with the fields of its Token
+     */
+    struct Node {
+        TokenType type = _expression; // root and blocks are _expression, like Token()
+        int token = 0; // enum value within the type
+        int text = 0; // identifiers and literals: offset of the text in the text pool
+        int length = 0;
+        int line = 0; // source line, 0 for the root and blocks
+        int firstChild = -1;
+        int lastChild = -1;
+        int nextSibling = -1;
+        int childCount = 0;
+    };
+
+private:
+    /// @brief The token the parser is looking at; _expression once the input is exhausted
+    struct Lexeme {
+        TokenType type = _expression;
+        int token = 0;
+        int text = 0;
+        int length = 0;
+        int line = 0;
+    };
+
+    /// @brief A keyword or operator spelling and the token it stands for
+    struct Spelling {
+        string_view text;
+        TokenType type;
+        int token;
+    };
+
+    static constexpr Spelling spellings[] = {
+        { "int", _keyWord, _int }, { "char", _keyWord, _char }, { "float", _keyWord, _float },
+        { "string", _keyWord, _string }, { "str", _keyWord, _string }, { "bool", _keyWord, _bool },
+        { "if", _keyWord, _if }, { "elif", _keyWord, _elif }, { "else", _keyWord, _else },
+        { "for", _keyWord, _for }, { "while", _keyWord, _while }, { "do", _keyWord, _do },
+        { "return", _keyWord, _return }, { "break", _keyWord, _break }, { "continue", _keyWord, _continue },
+        { "+", _operator, _add }, { "-", _operator, _sub }, { "*", _operator, _mul },
+        { "/", _operator, _div }, { "%", _operator, _mod }, { "**", _operator, _pow },
+        { "and", _operator, _and }, { "&&", _operator, _and }, { "or", _operator, _or },
+        { "||", _operator, _or }, { "!", _operator, _not }, { "not", _operator, _not },
+        { "^", _operator, _xor }, { "xor", _operator, _xor },
+        { "==", _operator, _eq }, { "!=", _operator, _neq }, { ">=", _operator, _gte },
+        { "<=", _operator, _lte }, { ">", _operator, _gt }, { "<", _operator, _lt },
+        { "=", _operator, _ass }, { "+=", _operator, _assAdd }, { "-=", _operator, _assSub },
+        { "*=", _operator, _assMul }, { "/=", _operator, _assDiv }, { "%=", _operator, _assMod },
+        { "**=", _operator, _assPow },
+        { "(", _delimiter, _bracketOpen }, { ")", _delimiter, _bracketClose }, { "{", _delimiter, _braceOpen },
+        { "}", _delimiter, _braceClose }, { "[", _delimiter, _sqOpen }, { "]", _delimiter, _sqClose }
+    };
+
+    Node nodes[MaxNodes];
+    int nodeCount = 0;
+    char texts[MaxText] {};
+    int textLength = 0;
+    const char* error = nullptr;
+    int errorLine = 0;
+
+    // lexer state, only used while the constructor runs
+    string_view source;
+    size_t cursor = 0;
+    int line = 1;
+    bool ascii = true; // then comments and literals need no UTF-8 validation
+    Lexeme current;
+
+    /// @brief Records the first error and returns the "no node" index, so callers can return it
+    constexpr int fail(const char* message)
+    {
+        if (!error) {
+            error = message;
+            errorLine = current.line ? current.line : line;
+        }
+        return -1;
+    }
+
+    static constexpr bool isDigit(char c)
+    {
+        return c >= '0' && c <= '9';
+    }
+
+    static constexpr bool isLetter(char c)
+    {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+    }
+
+    /// @brief Appends a byte to the text pool
+    constexpr bool pushText(char c)
+    {
+        if (textLength >= (int)MaxText) {
+            fail("Program too large for the text capacity of its EmbeddedProgram");
+            return false;
+        }
+        texts[textLength++] = c;
+        return true;
+    }
+
+    /// @brief Checks a literal or comment for valid UTF-8, see Tokenizer::validateUtf8()
+    constexpr bool validateUtf8(size_t start, size_t end, const char* message)
+    {
+        if (ascii || Utf8::isValidScalar(source.data() + start, end - start))
+            return true;
+        fail(message);
+        return false;
+    }
+
+    /**
+     * @brief Reads a string or char literal starting at its opening quote
+     *
+     * Escapes are decoded into the text pool as the Tokenizer does.
+     */
+    constexpr void lexLiteral(char quote)
+    {
+        size_t start = ++cursor;
+        current.type = _literal;
+        current.token = quote == '"' ? _stringLit : _charLit;
+        current.text = textLength;
+        while (true) {
+            if (cursor >= source.size() || source[cursor] == '\n') {
+                fail(quote == '"' ? "Unterminated string literal" : "Unterminated char literal");
+                return;
+            }
+            char c = source[cursor++];
+            if (c == quote)
+                break;
+            if (c == '\\') {
+                if (cursor >= source.size()) {
+                    fail("Invalid character after \\ (escape character).");
+                    return;
+                }
+                switch (source[cursor++]) {
+                case 'n':
+                    c = '\n';
+                    break;
+                case 't':
+                    c = '\t';
+                    break;
+                case 'r':
+                    c = '\r';
+                    break;
+                case 'b':
+                    c = '\b';
+                    break;
+                case 'v':
+                    c = '\v';
+                    break;
+                case 'f':
+                    c = '\f';
+                    break;
+                case '0':
+                    c = '\0';
+                    break;
+                case '\'':
+                case '"':
+                case '\\':
+                    c = source[cursor - 1];
+                    break;
+                default:
+                    fail("Invalid character after \\ (escape character).");
+                    return;
+                }
+            }
+            if (!pushText(c))
+                return;
+        }
+        if (!validateUtf8(start, cursor - 1, quote == '"' ? "invalid UTF-8 in a string literal" : "invalid UTF-8 in a char literal"))
+            return;
+        current.length = textLength - current.text;
+        if (quote == '\'' && current.length != 1)
+            fail("The length of the character should exactly be 1.");
+    }
+
+    /**
+     * @brief Classifies a word (the text up to the next space, tab, newline or #)
+     *
+     * Same rules as Tokenizer::parseCurrentToken(): spellings first, then number
+     * literals (digits with at most one .), then identifiers.
+     */
+    constexpr void lexWord()
+    {
+        size_t start = cursor;
+        while (cursor < source.size()) {
+            char c = source[cursor];
+            if (c == ' ' || c == '\t' || c == '\n' || c == '#')
+                break;
+            if (c == '"' || c == '\'' || c == '\\') {
+                fail("Quotes and \\ can only start a literal, after a space");
+                return;
+            }
+            cursor++;
+        }
+        string_view word = source.substr(start, cursor - start);
+        for (const Spelling& spelling : spellings)
+            if (spelling.text == word) {
+                current.type = spelling.type;
+                current.token = spelling.token;
+                return;
+            }
+
+        current.text = textLength;
+        current.length = (int)word.size();
+        if (isDigit(word[0])) {
+            int decimals = 0;
+            for (char c : word) {
+                if (!(isDigit(c) || c == '.')) {
+                    fail("Invalid number(float/int) literal.");
+                    return;
+                }
+                decimals += c == '.';
+            }
+            if (decimals > 1) {
+                fail("Invalid number(float/int) literal. Only one or zero . is permitted");
+                return;
+            }
+            current.type = _literal;
+            current.token = decimals == 0 ? _intLit : _floatLit;
+        } else if (word[0] == '_' || isLetter(word[0])) {
+            for (char c : word)
+                if (!(c == '_' || isLetter(c) || isDigit(c))) {
+                    fail("Identifiers must always start with a _ or an alphabet and contain only _ or alphabet or digits");
+                    return;
+                }
+            current.type = _identifier;
+        } else {
+            fail("The given token is invalid");
+            return;
+        }
+        for (char c : word)
+            if (!pushText(c))
+                return;
+    }
+
+    /// @brief Moves current to the next significant token: no spaces, tabs or comments
+    constexpr void lexNext()
+    {
+        current = Lexeme();
+        while (cursor < source.size()) {
+            char c = source[cursor];
+            if (c == ' ' || c == '\t') {
+                cursor++;
+            } else if (c == '#') {
+                size_t end = source.find('\n', cursor);
+                if (end == string_view::npos)
+                    end = source.size();
+                if (!validateUtf8(cursor + 1, end, "invalid UTF-8 in a comment"))
+                    return;
+                cursor = end;
+            } else {
+                break;
+            }
+        }
+        current.line = line;
+        if (error || cursor >= source.size())
+            return;
+
+        char c = source[cursor];
+        if (c == '\n') {
+            current.type = _whitespace;
+            current.token = _newLine;
+            cursor++;
+            line++;
+        } else if (c == '"' || c == '\'') {
+            lexLiteral(c);
+        } else if (c == '\\') {
+            fail("A \\ outside of a literal");
+        } else {
+            lexWord();
+        }
+        if (error)
+            current = Lexeme { _expression, 0, 0, 0, current.line };
+    }
+
+    constexpr bool atEnd() const
+    {
+        return current.type == _expression;
+    }
+
+    constexpr bool check(TokenType type, int token) const
+    {
+        return current.type == type && current.token == token;
+    }
+
+    constexpr StatementKind predict() const
+    {
+        return atEnd() ? _emptyStatement : predictStatement(current.type, current.token);
+    }
+
+    /// @brief Adds a node, -1 if the tree is full
+    constexpr int newNode(TokenType type, int token, int text, int length, int nodeLine)
+    {
+        if (nodeCount >= (int)MaxNodes)
+            return fail("Program too large for the node capacity of its EmbeddedProgram");
+        nodes[nodeCount] = Node { type, token, text, length, nodeLine };
+        return nodeCount++;
+    }
+
+    /// @brief Appends child to the children of parent; does nothing after an error
+    constexpr void addChild(int parent, int child)
+    {
+        if (parent < 0 || child < 0)
+            return;
+        Node& node = nodes[parent];
+        if (node.lastChild < 0)
+            node.firstChild = child;
+        else
+            nodes[node.lastChild].nextSibling = child;
+        node.lastChild = child;
+        node.childCount++;
+    }
+
+    /// @brief Consumes the current token and returns it as a node, see Parser::advance()
+    constexpr int advance()
+    {
+        if (atEnd())
+            return fail("Unexpected end of input");
+        int node = newNode(current.type, current.token, current.text, current.length, current.line);
+        lexNext();
+        return error ? -1 : node;
+    }
+
+    constexpr int expect(TokenType type, int token, const char* message)
+    {
+        if (!check(type, token))
+            return fail(message);
+        return advance();
+    }
+
+    constexpr void skipNewLines()
+    {
+        while (!error && check(_whitespace, _newLine))
+            advance();
+    }
+
+    constexpr void expectEnd()
+    {
+        if (error || atEnd() || check(_delimiter, _braceClose))
+            return;
+        expect(_whitespace, _newLine, "Expected end of line");
+    }
+
+    constexpr int parsePrimary()
+    {
+        if (current.type == _literal || current.type == _identifier)
+            return advance();
+        if (check(_delimiter, _bracketOpen)) {
+            advance();
+            int inner = parseExpression();
+            expect(_delimiter, _bracketClose, "Expected ')'");
+            return error ? -1 : inner;
+        }
+        return fail("Expected an expression");
+    }
+
+    constexpr int parseUnary()
+    {
+        if (current.type == _operator && operatorStartsExpression[current.token]) {
+            int op = advance();
+            addChild(op, parseExpression(Token::priorityOf(_not)));
+            return error ? -1 : op;
+        }
+        return parsePrimary();
+    }
+
+    constexpr int parseBinary(int left, int minPriority)
+    {
+        while (!error && current.type == _operator) {
+            OperatorType op = (OperatorType)current.token;
+            if (isAssignmentOperator[op] || op == _not)
+                break;
+            int priority = Token::priorityOf(op);
+            if (priority < minPriority)
+                break;
+
+            int node = advance();
+            int right = parseExpression(Token::associativityOf(op) == Token::LeftAssoc ? priority + 1 : priority);
+            addChild(node, left);
+            addChild(node, right);
+            left = node;
+        }
+        return error ? -1 : left;
+    }
+
+    constexpr int parseExpression(int minPriority = 11)
+    {
+        int left = parseUnary();
+        return error ? -1 : parseBinary(left, minPriority);
+    }
+
+    /// @brief See Parser::parseDeclaration(); literal initializers are type-checked the same way
+    constexpr int parseDeclaration()
+    {
+        int dataType = advance();
+        if (current.type != _identifier)
+            return fail("Expected a variable name after the data type");
+        int name = advance();
+        if (!check(_operator, _ass)) {
+            addChild(dataType, name);
+            return error ? -1 : dataType;
+        }
+
+        int op = advance();
+        int value = parseExpression();
+        if (error)
+            return -1;
+        int keyword = nodes[dataType].token;
+        if (nodes[value].type == _literal) {
+            int literal = nodes[value].token;
+            bool valid = (keyword == _int && literal == _intLit) || (keyword == _char && literal == _charLit)
+                || (keyword == _string && literal == _stringLit) || (keyword == _float && literal == _floatLit);
+            if (!valid)
+                return fail("Invalid assignment");
+        }
+        addChild(op, name);
+        addChild(op, value);
+        addChild(dataType, op);
+        return dataType;
+    }
+
+    constexpr int parseAssignment()
+    {
+        int target = advance();
+        if (!(current.type == _operator && isAssignmentOperator[current.token]))
+            return error ? -1 : parseBinary(target, 11);
+        int op = advance();
+        addChild(op, target);
+        addChild(op, parseExpression());
+        return error ? -1 : op;
+    }
+
+    constexpr int parseSimpleStatement()
+    {
+        StatementKind kind = predict();
+        if (kind == _declarationStatement)
+            return parseDeclaration();
+        if (kind == _assignmentStatement)
+            return parseAssignment();
+        return fail("Expected a declaration or an assignment");
+    }
+
+    constexpr int parseBlock()
+    {
+        expect(_delimiter, _braceOpen, "Expected '{'");
+        int block = newNode(_expression, 0, 0, 0, 0);
+        while (!error && !check(_delimiter, _braceClose)) {
+            if (atEnd())
+                return fail("Expected '}'");
+            parseStatement(block);
+        }
+        advance();
+        return error ? -1 : block;
+    }
+
+    constexpr int parseIf()
+    {
+        int ifNode = advance();
+        addChild(ifNode, parseExpression());
+        addChild(ifNode, parseBlock());
+        while (!error) {
+            skipNewLines();
+            if (check(_keyWord, _elif)) {
+                int elifNode = advance();
+                addChild(elifNode, parseExpression());
+                addChild(elifNode, parseBlock());
+                addChild(ifNode, elifNode);
+            } else {
+                if (check(_keyWord, _else)) {
+                    int elseNode = advance();
+                    addChild(elseNode, parseBlock());
+                    addChild(ifNode, elseNode);
+                }
+                break;
+            }
+        }
+        return error ? -1 : ifNode;
+    }
+
+    constexpr int parseFor()
+    {
+        int forNode = advance();
+        expect(_delimiter, _bracketOpen, "Expected '(' before the for initializer");
+        addChild(forNode, parseSimpleStatement());
+        expect(_delimiter, _bracketClose, "Expected ')' after the for initializer");
+        expect(_delimiter, _bracketOpen, "Expected '(' before the for condition");
+        addChild(forNode, parseExpression());
+        expect(_delimiter, _bracketClose, "Expected ')' after the for condition");
+        expect(_delimiter, _bracketOpen, "Expected '(' before the for step");
+        addChild(forNode, parseSimpleStatement());
+        expect(_delimiter, _bracketClose, "Expected ')' after the for step");
+        addChild(forNode, parseBlock());
+        return error ? -1 : forNode;
+    }
+
+    /// @brief Parses one statement into parent, see Parser::parseStatement()
+    constexpr void parseStatement(int parent)
+    {
+        switch (predict()) {
+        case _emptyStatement:
+            advance();
+            return;
+        case _declarationStatement:
+            addChild(parent, parseDeclaration());
+            expectEnd();
+            return;
+        case _assignmentStatement:
+            addChild(parent, parseAssignment());
+            expectEnd();
+            return;
+        case _expressionStatement:
+            addChild(parent, parseExpression());
+            expectEnd();
+            return;
+        case _blockStatement:
+            addChild(parent, parseBlock());
+            return;
+        case _ifStatement:
+            addChild(parent, parseIf());
+            return;
+        case _whileStatement: {
+            int whileNode = advance();
+            addChild(whileNode, parseExpression());
+            addChild(whileNode, parseBlock());
+            addChild(parent, whileNode);
+            return;
+        }
+        case _doStatement: {
+            int doNode = advance();
+            addChild(doNode, parseBlock());
+            skipNewLines();
+            expect(_keyWord, _while, "Expected while after the do block");
+            addChild(doNode, parseExpression());
+            addChild(parent, doNode);
+            expectEnd();
+            return;
+        }
+        case _forStatement:
+            addChild(parent, parseFor());
+            return;
+        case _breakStatement:
+        case _continueStatement:
+            addChild(parent, advance());
+            expectEnd();
+            return;
+        case _returnStatement: {
+            int returnNode = advance();
+            if (!(atEnd() || check(_whitespace, _newLine) || check(_delimiter, _braceClose)))
+                addChild(returnNode, parseExpression());
+            addChild(parent, returnNode);
+            expectEnd();
+            return;
+        }
+        case _invalidStatement:
+            break;
+        }
+        if (check(_keyWord, _elif) || check(_keyWord, _else))
+            fail("elif/else without a matching if");
+        else
+            fail("Unexpected token at the start of a statement");
+    }
+
+    /**
+     * @class Machine
+     * @brief The state of one run(): variables, scopes and the step budget
+     *
+     * Mirrors Interpreter::executeStatement() and Interpreter::evaluate(). Values
+     * carry their HoLang type; char is kept as its (signed) code like Value does.
+     * The variables live on the stack of run(), MaxVariables of them.
+     */
+    class Machine {
+    public:
+        enum class Flow { normal, breaking, continuing, returning };
+
+        struct Value {
+            KeyWordType type = _int;
+            long long integer = 0; // int, char and bool
+            double real = 0; // float
+        };
+
+        struct Variable {
+            int name = 0; // node of the declared identifier
+            int depth = 0;
+            Value value;
+        };
+
+        const EmbeddedProgram& program;
+        Variable variables[MaxVariables];
+        int variableCount = 0;
+        int depth = 0;
+        long long steps;
+        EmbeddedResult result;
+
+        constexpr Machine(const EmbeddedProgram& program, long long maxSteps)
+            : program(program)
+            , steps(maxSteps)
+        {
+        }
+
+        constexpr const Node& at(int index) const
+        {
+            return program.nodes[index];
+        }
+
+        constexpr bool failed() const
+        {
+            return result.error != nullptr;
+        }
+
+        constexpr Value fail(int node, const char* message)
+        {
+            if (!result.error) {
+                result.error = message;
+                result.line = at(node).line;
+            }
+            return Value();
+        }
+
+        /// @brief Counts a step; false once the budget is used up (and then an error is set)
+        constexpr bool step(int node)
+        {
+            if (--steps >= 0)
+                return true;
+            fail(node, "Step limit reached");
+            return false;
+        }
+
+        static constexpr Value fromInt(long long value)
+        {
+            return Value { _int, value, 0 };
+        }
+
+        static constexpr Value fromBool(bool value)
+        {
+            return Value { _bool, value, 0 };
+        }
+
+        static constexpr Value fromFloat(double value)
+        {
+            return Value { _float, 0, value };
+        }
+
+        static constexpr double asFloat(const Value& value)
+        {
+            return value.type == _float ? value.real : (double)value.integer;
+        }
+
+        static constexpr bool isTrue(const Value& value)
+        {
+            return value.type == _float ? value.real != 0 : value.integer != 0;
+        }
+
+        /// @brief The value as an int; a float outside the range of int is an error (it is undefined in C++)
+        constexpr long long asInt(int node, const Value& value)
+        {
+            if (value.type != _float)
+                return value.integer;
+            if (!(value.real > -9223372036854775808.0 && value.real < 9223372036854775808.0)) {
+                fail(node, "Float out of the range of int");
+                return 0;
+            }
+            return (long long)value.real;
+        }
+
+        /// @brief See Interpreter::convert()
+        constexpr Value convert(int node, KeyWordType target, const Value& value)
+        {
+            if (value.type == target)
+                return value;
+            switch (target) {
+            case _float:
+                return fromFloat(asFloat(value));
+            case _char:
+                return Value { _char, (signed char)asInt(node, value), 0 };
+            case _bool:
+                return fromBool(isTrue(value));
+            default:
+                return fromInt(asInt(node, value));
+            }
+        }
+
+        /// @brief Finds a variable through the enclosing scopes, or nullptr
+        constexpr Variable* find(int nameNode)
+        {
+            string_view name = program.getText(at(nameNode));
+            for (int i = variableCount - 1; i >= 0; i--)
+                if (program.getText(at(variables[i].name)) == name)
+                    return &variables[i];
+            return nullptr;
+        }
+
+        constexpr void popScope()
+        {
+            while (variableCount > 0 && variables[variableCount - 1].depth == depth)
+                variableCount--;
+            depth--;
+        }
+
+        /// @brief Reads an int literal like stoll(), which rejects values out of range
+        constexpr Value intLiteral(int node)
+        {
+            unsigned long long value = 0;
+            for (char c : program.getText(at(node))) {
+                if (value > (9223372036854775807ULL - (c - '0')) / 10)
+                    return fail(node, "Integer literal out of range");
+                value = value * 10 + (c - '0');
+            }
+            return fromInt((long long)value);
+        }
+
+        /**
+         * @brief Reads a float literal like stod()
+         *
+         * Exact when the digits fit in 53 bits and there are at most 22 decimals
+         * (one correctly rounded division); longer literals may differ from stod()
+         * in the last bit.
+         */
+        static constexpr double floatLiteral(string_view text)
+        {
+            double mantissa = 0, scale = 1;
+            bool fraction = false;
+            for (char c : text) {
+                if (c == '.') {
+                    fraction = true;
+                    continue;
+                }
+                mantissa = mantissa * 10 + (c - '0');
+                if (fraction)
+                    scale *= 10;
+            }
+            return mantissa / scale;
+        }
+
+        static constexpr long long wrap(unsigned long long value)
+        {
+            return (long long)value;
+        }
+
+        /// @brief Same as Interpreter::integerPower() (and ho_ipow() in the generated C)
+        static constexpr long long integerPower(long long base, long long exponent)
+        {
+            if (exponent < 0)
+                return base == 1 ? 1 : base == -1 ? (exponent % 2 ? -1 : 1) : 0;
+            unsigned long long result = 1, factor = base;
+            for (; exponent > 0; exponent >>= 1) {
+                if (exponent & 1)
+                    result *= factor;
+                factor *= factor;
+            }
+            return (long long)result;
+        }
+
+        /// @brief See Interpreter::applyBinary(); strings never get here
+        constexpr Value applyBinary(int node, int op, const Value& left, const Value& right)
+        {
+            bool floats = left.type == _float || right.type == _float;
+            long long a = floats ? 0 : left.integer, b = floats ? 0 : right.integer;
+            double x = asFloat(left), y = asFloat(right);
+            switch (op) {
+            case _add:
+                return floats ? fromFloat(x + y) : fromInt(wrap((unsigned long long)a + (unsigned long long)b));
+            case _sub:
+                return floats ? fromFloat(x - y) : fromInt(wrap((unsigned long long)a - (unsigned long long)b));
+            case _mul:
+                return floats ? fromFloat(x * y) : fromInt(wrap((unsigned long long)a * (unsigned long long)b));
+            case _div:
+                if (floats)
+                    return fromFloat(x / y);
+                if (b == 0)
+                    return fail(node, "Division by zero");
+                return fromInt(b == -1 ? wrap(0ULL - (unsigned long long)a) : a / b);
+            case _mod:
+                if (floats)
+#if defined(__GNUC__) && !defined(__clang__)
+                    return fromFloat(__builtin_fmod(x, y)); // folded by GCC in constant expressions
+#else
+                    return fail(node, "Float % cannot be evaluated at compile time");
+#endif
+                if (b == 0)
+                    return fail(node, "Division by zero");
+                return fromInt(b == -1 ? 0 : a % b);
+            case _pow:
+                if (floats)
+#if defined(__GNUC__) && !defined(__clang__)
+                    return fromFloat(__builtin_pow(x, y));
+#else
+                    return fail(node, "Float ** cannot be evaluated at compile time");
+#endif
+                return fromInt(integerPower(a, b));
+            case _xor:
+                return fromBool(isTrue(left) != isTrue(right));
+            case _eq:
+                return fromBool(floats ? x == y : a == b);
+            case _neq:
+                return fromBool(floats ? x != y : a != b);
+            case _gte:
+                return fromBool(floats ? x >= y : a >= b);
+            case _lte:
+                return fromBool(floats ? x <= y : a <= b);
+            case _gt:
+                return fromBool(floats ? x > y : a > b);
+            case _lt:
+                return fromBool(floats ? x < y : a < b);
+            }
+            return fail(node, "Assignment used as a value");
+        }
+
+        /// @brief Evaluates an operand of and/or or a condition as a truth value
+        constexpr bool truth(int node)
+        {
+            return isTrue(evaluate(node));
+        }
+
+        /// @brief See Interpreter::evaluate()
+        constexpr Value evaluate(int index)
+        {
+            if (!step(index))
+                return Value();
+            const Node& node = at(index);
+            switch (node.type) {
+            case _literal:
+                switch (node.token) {
+                case _intLit:
+                    return intLiteral(index);
+                case _floatLit:
+                    return fromFloat(floatLiteral(program.getText(node)));
+                case _charLit:
+                    return Value { _char, (signed char)program.getText(node)[0], 0 };
+                default:
+                    return fail(index, "Strings cannot be evaluated at compile time");
+                }
+            case _identifier: {
+                Variable* variable = find(index);
+                string_view name = program.getText(node);
+                if (!variable && (name == "true" || name == "false"))
+                    return fromBool(name == "true");
+                if (!variable)
+                    return fail(index, "Use of undeclared variable");
+                return variable->value;
+            }
+            case _operator: {
+                int left = node.firstChild;
+                if (node.childCount == 1) {
+                    Value operand = evaluate(left);
+                    if (node.token == _not)
+                        return fromBool(!isTrue(operand));
+                    return operand.type == _float ? fromFloat(-operand.real) : fromInt(wrap(0ULL - (unsigned long long)asInt(index, operand)));
+                }
+                if (node.token == _and || node.token == _or) {
+                    bool result = truth(left);
+                    if (result == (node.token == _and))
+                        result = truth(at(left).nextSibling);
+                    return fromBool(result);
+                }
+                Value leftValue = evaluate(left);
+                Value rightValue = evaluate(at(left).nextSibling);
+                if (failed())
+                    return Value();
+                return applyBinary(index, node.token, leftValue, rightValue);
+            }
+            default:
+                return fail(index, "Expected an expression");
+            }
+        }
+
+        /// @brief See Interpreter::declare()
+        constexpr void declare(int index)
+        {
+            const Node& node = at(index);
+            KeyWordType type = (KeyWordType)node.token;
+            if (type == _string) {
+                fail(index, "Strings cannot be evaluated at compile time");
+                return;
+            }
+            bool initialised = at(node.firstChild).type == _operator;
+            int name = initialised ? at(node.firstChild).firstChild : node.firstChild;
+            Value value { type, 0, 0 };
+            if (initialised)
+                value = convert(index, type, evaluate(at(name).nextSibling));
+            string_view text = program.getText(at(name));
+            for (int i = variableCount - 1; i >= 0 && variables[i].depth == depth; i--)
+                if (program.getText(at(variables[i].name)) == text) {
+                    fail(index, "Variable is already declared in this block");
+                    return;
+                }
+            if (variableCount >= (int)MaxVariables)
+                fail(index, "Too many variables for the variable capacity of its EmbeddedProgram");
+            if (!failed())
+                variables[variableCount++] = Variable { name, depth, value };
+        }
+
+        /// @brief See Interpreter::assign()
+        constexpr void assign(int index)
+        {
+            const Node& node = at(index);
+            int target = node.firstChild;
+            if (at(target).type != _identifier) {
+                fail(index, "Only variables can be assigned to");
+                return;
+            }
+            Value value = evaluate(at(target).nextSibling);
+            Variable* variable = find(target);
+            if (!variable) {
+                fail(target, "Use of undeclared variable");
+                return;
+            }
+            constexpr OperatorType arithmetic[] = { _add, _add, _sub, _mul, _div, _mod, _pow }; // indexed by op - _ass
+            if (node.token != _ass)
+                value = applyBinary(index, arithmetic[node.token - _ass], variable->value, value);
+            if (!failed())
+                variable->value = convert(index, variable->value.type, value);
+        }
+
+        constexpr Flow executeBlock(int block)
+        {
+            depth++;
+            Flow flow = Flow::normal;
+            for (int child = at(block).firstChild; child >= 0 && flow == Flow::normal && !failed(); child = at(child).nextSibling)
+                flow = execute(child);
+            popScope();
+            return flow;
+        }
+
+        /// @brief Runs a loop body; false when the loop ends, with flow left for the caller
+        constexpr bool loopBody(int block, Flow& flow)
+        {
+            flow = executeBlock(block);
+            if (flow == Flow::breaking) {
+                flow = Flow::normal;
+                return false;
+            }
+            if (flow == Flow::continuing)
+                flow = Flow::normal;
+            return flow == Flow::normal && !failed();
+        }
+
+        /// @brief See Interpreter::executeStatement()
+        constexpr Flow execute(int index)
+        {
+            if (!step(index))
+                return Flow::normal;
+            const Node& node = at(index);
+            if (node.type == _expression)
+                return executeBlock(index);
+            if (node.type != _keyWord) {
+                if (node.type == _operator && node.token >= _ass)
+                    assign(index);
+                else
+                    evaluate(index);
+                return Flow::normal;
+            }
+
+            int first = node.firstChild;
+            Flow flow = Flow::normal;
+            switch (node.token) {
+            case _if: {
+                if (truth(first))
+                    return failed() ? Flow::normal : executeBlock(at(first).nextSibling);
+                for (int arm = at(at(first).nextSibling).nextSibling; arm >= 0 && !failed(); arm = at(arm).nextSibling) {
+                    if (at(arm).token == _else)
+                        return executeBlock(at(arm).firstChild);
+                    if (truth(at(arm).firstChild))
+                        return failed() ? Flow::normal : executeBlock(at(at(arm).firstChild).nextSibling);
+                }
+                return Flow::normal;
+            }
+            case _while:
+                while (truth(first) && !failed() && loopBody(at(first).nextSibling, flow))
+                    ;
+                return flow;
+            case _do:
+                while (loopBody(first, flow) && truth(at(first).nextSibling) && !failed())
+                    ;
+                return flow;
+            case _for: {
+                int test = at(first).nextSibling;
+                int stepNode = at(test).nextSibling;
+                depth++;
+                execute(first);
+                while (!failed() && truth(test) && !failed() && loopBody(at(stepNode).nextSibling, flow))
+                    execute(stepNode);
+                popScope();
+                return flow;
+            }
+            case _break:
+                return Flow::breaking;
+            case _continue:
+                return Flow::continuing;
+            case _return:
+                if (first >= 0) {
+                    Value value = evaluate(first);
+                    result.status = (int)asInt(index, value);
+                }
+                return Flow::returning;
+            case _elif:
+            case _else:
+                fail(index, "elif/else without a matching if");
+                return Flow::normal;
+            default:
+                declare(index);
+                return Flow::normal;
+            }
+        }
+
+        /// @brief See Interpreter::run()
+        constexpr EmbeddedResult run()
+        {
+            for (int child = at(0).firstChild; child >= 0 && !failed(); child = at(child).nextSibling) {
+                Flow flow = execute(child);
+                if (flow == Flow::returning)
+                    break;
+                if (flow != Flow::normal)
+                    fail(child, "break or continue outside of a loop");
+            }
+            return result;
+        }
+    };
+
+public:
+    /**
+     * @brief Constructor - tokenizes and parses source
+     *
+     * @param source The HoLang program; only read while the constructor runs
+     *
+     * Never throws: check ok() afterwards. In a constant expression a program that
+     * does not fit the capacities is reported like a syntax error.
+     */
+    constexpr explicit EmbeddedProgram(string_view source)
+        : source(source)
+    {
+        for (char c : source)
+            ascii = ascii && (unsigned char)c < 0x80;
+        newNode(_expression, 0, 0, 0, 0);
+        lexNext();
+        while (!error && !atEnd())
+            parseStatement(0);
+        this->source = string_view();
+        cursor = 0;
+        current = Lexeme();
+    }
+
+    /// @brief True if the source lexed and parsed
+    constexpr bool ok() const
+    {
+        return error == nullptr;
+    }
+
+    /// @brief Gets the message of the first lexing or parsing error, or nullptr
+    constexpr const char* getError() const
+    {
+        return error;
+    }
+
+    /// @brief Gets the source line of the first error, 0 without one
+    constexpr int getErrorLine() const
+    {
+        return errorLine;
+    }
+
+    /// @brief Gets the number of nodes in the tree, root included
+    constexpr int getNodeCount() const
+    {
+        return nodeCount;
+    }
+
+    /// @brief Gets a node by index; 0 is the root, -1 links mean "none"
+    constexpr const Node& getNode(int index) const
+    {
+        return nodes[index];
+    }
+
+    /// @brief Gets the text of an identifier or literal node (decoded for string and char literals)
+    constexpr string_view getText(const Node& node) const
+    {
+        return string_view(texts + node.text, node.length);
+    }
+
+    /**
+     * @brief Runs the program like Interpreter::run() does
+     *
+     * @param maxSteps Statements and expressions to evaluate before giving up
+     *                 with "Step limit reached"; the compiler's own limits on
+     *                 constant evaluation (e.g. -fconstexpr-ops-limit) may be
+     *                 reached first for large budgets
+     * @return The exit status, or the first run-time error and its line
+     *
+     * A program that did not parse returns its syntax error.
+     */
+    constexpr EmbeddedResult run(long long maxSteps = 20000) const
+    {
+        if (!ok())
+            return EmbeddedResult { 0, error, errorLine };
+        return Machine(*this, maxSteps).run();
+    }
+};
+
+/**
+ * @brief Embeds a HoLang string literal with capacities that always fit it
+ *
+ * A source of N - 1 bytes has at most N - 1 tokens and text bytes, every token
+ * and block makes at most one node besides the root, and a declaration takes at
+ * least six bytes ("int x" and a newline).
+ *
+ * Example: constexpr auto program = embedHoLang("return 3 ** 4 % 7\n");
+ */
+template <size_t N>
+consteval EmbeddedProgram<N, N, N / 6 + 1> embedHoLang(const char (&source)[N])
+{
+    return EmbeddedProgram<N, N, N / 6 + 1>(string_view(source, N - 1));
+}
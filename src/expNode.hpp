@@ -9,8 +9,13 @@
  * @author HoPiler Project
  */
 
+#pragma once
+
+#include "hugepage.hpp"
 #include "tokens.hpp"
 #include <iostream>
+#include <memory>
+#include <utility>
 #include <vector>
 using namespace std;
 
@@ -22,45 +27,226 @@ using namespace std;
  * This creates a tree structure where operators can have operands as children,
  * allowing the representation of nested expressions and complex program structures.
  * 
+ * Children are linked intrusively: every node knows its parent, its first and last
+ * child and its previous and next sibling. A parent owns its children (they are
+ * heap-allocated and deleted with it), and a child never moves once linked, so:
+ * - Inserting, removing, detaching or replacing a child given its pointer is O(1)
+ * - Pointers to nodes stay valid while other nodes are added or removed around them
+ * 
+ * Copying a node copies its whole subtree; moving it only re-parents its direct
+ * children. A copied or moved node is always detached (it has no parent or siblings).
+ * 
  * Typical usage patterns:
  * - Create a node with a token (operator, operand, etc.)
  * - Add child nodes to represent sub-expressions
- * - Traverse the tree for code generation or optimization
+ * - Traverse the tree for code generation or optimization:
+ *   for (ExpressionNode* child = node.getFirstChild(); child; child = child->getNextSibling())
  * 
  * @see Token
  */
 class ExpressionNode {
 private:
-    vector<ExpressionNode> children;
     Token token;
+    ExpressionNode* parent = nullptr;
+    ExpressionNode* firstChild = nullptr;
+    ExpressionNode* lastChild = nullptr;
+    ExpressionNode* prevSibling = nullptr;
+    ExpressionNode* nextSibling = nullptr;
+    int childCount = 0;
+
+    /**
+     * @brief Links a detached heap node into the child list
+     * 
+     * @param child The node to link; this node takes ownership
+     * @param position The child to insert after, or nullptr to insert at the front
+     */
+    void link(ExpressionNode* child, ExpressionNode* position)
+    {
+        child->parent = this;
+        child->prevSibling = position;
+        child->nextSibling = position ? position->nextSibling : this->firstChild;
+        if (child->nextSibling)
+            child->nextSibling->prevSibling = child;
+        else
+            this->lastChild = child;
+        if (position)
+            position->nextSibling = child;
+        else
+            this->firstChild = child;
+        this->childCount++;
+    }
+
+    /**
+     * @brief Unlinks a child from the child list without deleting it
+     * 
+     * @param child A child of this node; the caller takes ownership
+     */
+    void unlink(ExpressionNode* child)
+    {
+        if (child->prevSibling)
+            child->prevSibling->nextSibling = child->nextSibling;
+        else
+            this->firstChild = child->nextSibling;
+        if (child->nextSibling)
+            child->nextSibling->prevSibling = child->prevSibling;
+        else
+            this->lastChild = child->prevSibling;
+        child->parent = nullptr;
+        child->prevSibling = nullptr;
+        child->nextSibling = nullptr;
+        this->childCount--;
+    }
+
+    /**
+     * @brief Takes over the child list of another node
+     * 
+     * Only the direct children are re-parented; nothing is copied. The other node
+     * is left without children. Any children this node had must be released first.
+     */
+    void takeChildren(ExpressionNode& other)
+    {
+        this->firstChild = other.firstChild;
+        this->lastChild = other.lastChild;
+        this->childCount = other.childCount;
+        for (ExpressionNode* child = this->firstChild; child; child = child->nextSibling)
+            child->parent = this;
+        other.firstChild = nullptr;
+        other.lastChild = nullptr;
+        other.childCount = 0;
+    }
+
+    /// @brief Deletes a sibling chain starting at first
+    static void deleteChain(ExpressionNode* first)
+    {
+        while (first) {
+            ExpressionNode* next = first->nextSibling;
+            delete first;
+            first = next;
+        }
+    }
+
+    /**
+     * @brief Finds the child at a zero-based index by walking the sibling links
+     * 
+     * @note Does not bounds-check; behavior is undefined if index is out of range
+     */
+    ExpressionNode* childAt(int index)
+    {
+        ExpressionNode* child = this->firstChild;
+        while (index-- > 0)
+            child = child->nextSibling;
+        return child;
+    }
 
 public:
+    /// @brief Allocates nodes from the thread's active HugePageArena, if any (--huge-pages)
+    static void* operator new(size_t size)
+    {
+        HugePageArena* arena = HugePageArena::current();
+        return arena ? arena->allocate(size, alignof(ExpressionNode)) : ::operator new(size);
+    }
+
+    /// @brief Frees a node, unless it lives in an arena and goes with it
+    static void operator delete(void* node)
+    {
+        if (!HugePageArena::owns(node))
+            ::operator delete(node);
+    }
+
     /**
      * @brief Constructor - creates an ExpressionNode with a given token
      * 
      * @param token The token to store in this node
      * 
-     * Initializes the node with a token and an empty children vector.
+     * Initializes the node with a token and no children.
      * Child nodes can be added later using addChild().
      */
     ExpressionNode(Token token)
+        : token(token)
+    {
+    }
+
+    /// @brief Copy constructor - deep-copies the subtree into a detached node
+    ExpressionNode(const ExpressionNode& other)
+        : token(other.token)
+    {
+        for (ExpressionNode* child = other.firstChild; child; child = child->nextSibling)
+            link(new ExpressionNode(*child), this->lastChild);
+    }
+
+    /// @brief Move constructor - takes over the children of other without copying them
+    ExpressionNode(ExpressionNode&& other)
+        : token(std::move(other.token))
+    {
+        takeChildren(other);
+    }
+
+    /// @brief Copy assignment - replaces the token and children with a deep copy of other's
+    ExpressionNode& operator=(const ExpressionNode& other)
     {
-        this->token = token;
+        if (this != &other) {
+            ExpressionNode copy(other);
+            *this = std::move(copy);
+        }
+        return *this;
+    }
+
+    /**
+     * @brief Move assignment - replaces the token and children with other's
+     * 
+     * The old children are released only after other's children were taken over,
+     * so other may be one of this node's own descendants (e.g. replacing "x * 1"
+     * with "x"); it is then released with the old children and must not be used
+     * afterwards. Links to this node's parent and siblings are kept.
+     */
+    ExpressionNode& operator=(ExpressionNode&& other)
+    {
+        if (this != &other) {
+            ExpressionNode* oldChildren = this->firstChild;
+            this->token = std::move(other.token);
+            takeChildren(other);
+            deleteChain(oldChildren);
+        }
+        return *this;
+    }
+
+    /// @brief Destructor - deletes the whole subtree
+    ~ExpressionNode()
+    {
+        deleteChain(this->firstChild);
     }
 
     /**
      * @brief Adds a child node to this node
      * 
      * @param node The ExpressionNode to add as a child
+     * @return Pointer to the linked child, valid until it is removed
      * 
-     * Appends the given node to the children vector. This is used when building
-     * the AST to establish parent-child relationships.
+     * Appends the given node after the last child in O(1). This is used when
+     * building the AST to establish parent-child relationships. Pass temporaries or
+     * std::move() the node to avoid copying its subtree.
      * 
-     * Example: operator_node.addChild(operand_node);
+     * Example: operator_node.addChild(std::move(operand_node));
      */
-    void addChild(ExpressionNode node)
+    ExpressionNode* addChild(ExpressionNode node)
     {
-        this->children.push_back(node);
+        ExpressionNode* child = new ExpressionNode(std::move(node));
+        link(child, this->lastChild);
+        return child;
+    }
+
+    /**
+     * @brief Inserts a child node right after another child in O(1)
+     * 
+     * @param position The child to insert after, or nullptr to insert at the front
+     * @param node The ExpressionNode to insert
+     * @return Pointer to the linked child
+     */
+    ExpressionNode* insertChildAfter(ExpressionNode* position, ExpressionNode node)
+    {
+        ExpressionNode* child = new ExpressionNode(std::move(node));
+        link(child, position);
+        return child;
     }
 
     /**
@@ -68,27 +254,123 @@ public:
      * 
      * @param index The zero-based index of the child to remove
      * 
-     * Removes the child node at the given index from the children vector.
-     * This may be used when restructuring the tree during optimization or transformation.
+     * Walks to the child (O(index)) and deletes it. Passes that already hold the
+     * child's pointer should use removeChild(ExpressionNode*) instead.
      * 
      * @note Does not bounds-check; behavior is undefined if index is out of range
      */
     void removeChild(int index)
     {
-        this->children.erase(this->children.begin() + index);
+        removeChild(childAt(index));
+    }
+
+    /**
+     * @brief Removes and deletes a child node in O(1)
+     * 
+     * @param child A child of this node; invalid after the call
+     */
+    void removeChild(ExpressionNode* child)
+    {
+        unlink(child);
+        delete child;
+    }
+
+    /**
+     * @brief Unlinks a child node in O(1) without deleting it
+     * 
+     * @param child A child of this node
+     * @return Ownership of the detached child
+     */
+    unique_ptr<ExpressionNode> detachChild(ExpressionNode* child)
+    {
+        unlink(child);
+        return unique_ptr<ExpressionNode>(child);
+    }
+
+    /**
+     * @brief Replaces the child node at the specified index
+     * 
+     * @param index The zero-based index of the child to replace
+     * @param node The node to put in its place
+     * 
+     * @note Does not bounds-check; behavior is undefined if index is out of range
+     */
+    void replaceChild(int index, ExpressionNode node)
+    {
+        replaceChild(childAt(index), std::move(node));
+    }
+
+    /**
+     * @brief Replaces a child node in O(1)
+     * 
+     * @param child A child of this node; deleted by the call
+     * @param node The node to put in its place
+     * @return Pointer to the new child
+     * 
+     * Used by tree rewriting passes to swap a simplified subtree in. Moving a
+     * detached subtree in (e.g. one returned by detachChild()) does not copy it.
+     */
+    ExpressionNode* replaceChild(ExpressionNode* child, ExpressionNode node)
+    {
+        ExpressionNode* replacement = insertChildAfter(child, std::move(node));
+        removeChild(child);
+        return replacement;
     }
 
     /**
      * @brief Gets all child nodes of this node
      * 
-     * @return A copy of the children vector
+     * @return A copy of the children
      * 
      * Returns all child nodes. Modifications to the returned vector do not
      * affect the node's actual children.
+     * 
+     * @note Copies every subtree; traversals should follow getFirstChild() and
+     *       getNextSibling() instead
      */
-    vector<ExpressionNode> getChildren()
+    vector<ExpressionNode> getChildren() const
+    {
+        vector<ExpressionNode> children;
+        children.reserve(this->childCount);
+        for (ExpressionNode* child = this->firstChild; child; child = child->nextSibling)
+            children.push_back(*child);
+        return children;
+    }
+
+    /// @brief Gets the number of children
+    int getChildCount() const
+    {
+        return this->childCount;
+    }
+
+    /// @brief Gets the first child, or nullptr if there is none
+    ExpressionNode* getFirstChild() const
     {
-        return this->children;
+        return this->firstChild;
+    }
+
+    /// @brief Gets the last child, or nullptr if there is none
+    ExpressionNode* getLastChild() const
+    {
+        return this->lastChild;
+    }
+
+    /// @brief Gets the next sibling, or nullptr for the last child and detached nodes
+    ExpressionNode* getNextSibling() const
+    {
+        return this->nextSibling;
+    }
+
+    /// @brief Gets the previous sibling, or nullptr for the first child and detached nodes
+    ExpressionNode* getPrevSibling() const
+    {
+        return this->prevSibling;
+    }
+
+    /// @brief Gets the parent, or nullptr for a root or detached node
+    ExpressionNode* getParent() const
+    {
+        return this->parent;
     }
 
     /**
@@ -166,6 +448,12 @@ public:
         return this->token.get().token;
     }
 
+    /// @brief Gets the source line of the stored token, or 0 if unknown
+    int getLine() const
+    {
+        return this->token.getLine();
+    }
+
     /**
      * @brief Gets the string value of the stored token
      * 
@@ -178,4 +466,16 @@ public:
     {
         return this->token.get().value;
     }
-};
\ No newline at end of file
+
+    /// @brief Gets the text of the stored token without copying it, see Token::getText()
+    const string& getTokenText() const
+    {
+        return this->token.getText();
+    }
+
+    /// @brief Checks whether a string or char literal needs escaping in C, see Token::isEscaped()
+    bool isEscaped() const
+    {
+        return this->token.isEscaped();
+    }
+};
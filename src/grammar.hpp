@@ -0,0 +1,132 @@
+/**
+ * @file grammar.hpp
+ * @brief constexpr FIRST-set tables of the HoLang statement grammar
+ * 
+ * Shared by the Parser and the compile-time parser of embedded.hpp, so both
+ * predict statements from the same tables. Nothing here allocates, throws or
+ * prints; it only needs the token enumerations.
+ * 
+ * @author HoPiler Project
+ */
+
+#pragma once
+
+#include "tokens.hpp"
+
+/**
+ * @enum StatementKind
+ * @brief The kind of statement predicted from the first token of a statement
+ */
+enum StatementKind { _emptyStatement,
+    _declarationStatement,
+    _assignmentStatement,
+    _expressionStatement,
+    _blockStatement,
+    _ifStatement,
+    _whileStatement,
+    _doStatement,
+    _forStatement,
+    _breakStatement,
+    _continueStatement,
+    _returnStatement,
+    _invalidStatement };
+
+/**
+ * @brief FIRST set of every statement kind, indexed by KeyWordType
+ * 
+ * elif and else can never start a statement; they are only valid right after the
+ * block of an if, which parseIf() handles itself.
+ */
+constexpr StatementKind keywordFirst[] = {
+    _ifStatement, // _if
+    _invalidStatement, // _elif
+    _invalidStatement, // _else
+    _forStatement, // _for
+    _whileStatement, // _while
+    _doStatement, // _do
+    _returnStatement, // _return
+    _breakStatement, // _break
+    _continueStatement, // _continue
+    _declarationStatement, // _int
+    _declarationStatement, // _float
+    _declarationStatement, // _string
+    _declarationStatement, // _char
+    _declarationStatement // _bool
+};
+
+/**
+ * @brief FIRST set of every statement kind, indexed by TokenType
+ * 
+ * Keywords, operators, delimiters and whitespace need a second lookup on the
+ * specific token (keywordFirst, operatorStartsExpression, delimiterFirst and the
+ * newline check); the entries here are used for everything else.
+ */
+constexpr StatementKind tokenTypeFirst[] = {
+    _invalidStatement, // _keyWord, see keywordFirst
+    _assignmentStatement, // _identifier, may turn out to be an expression statement
+    _expressionStatement, // _literal
+    _invalidStatement, // _operator, see operatorStartsExpression
+    _invalidStatement, // _delimiter, see delimiterFirst
+    _emptyStatement, // _comment, never reaches the parser
+    _emptyStatement, // _whitespace, only newlines reach the parser
+    _invalidStatement // _expression
+};
+
+/// @brief FIRST set of every statement kind, indexed by DelimiterType
+constexpr StatementKind delimiterFirst[] = {
+    _expressionStatement, // _bracketOpen
+    _invalidStatement, // _bracketClose
+    _blockStatement, // _braceOpen
+    _invalidStatement, // _braceClose
+    _invalidStatement, // _sqOpen
+    _invalidStatement // _sqClose
+};
+
+/// @brief Operators that can start an expression (prefix operators), indexed by OperatorType
+constexpr bool operatorStartsExpression[] = {
+    false, true, false, false, false, false, // _add, _sub (negation), _mul, _div, _mod, _pow
+    false, false, true, false, // _and, _or, _not, _xor
+    false, false, false, false, false, false, // comparisons
+    false, false, false, false, false, false, false // assignments
+};
+
+/// @brief Assignment operators, indexed by OperatorType
+constexpr bool isAssignmentOperator[] = {
+    false, false, false, false, false, false,
+    false, false, false, false,
+    false, false, false, false, false, false,
+    true, true, true, true, true, true, true
+};
+
+static_assert(sizeof(keywordFirst) / sizeof(keywordFirst[0]) == _bool + 1, "keywordFirst must cover every KeyWordType");
+static_assert(sizeof(tokenTypeFirst) / sizeof(tokenTypeFirst[0]) == _expression + 1, "tokenTypeFirst must cover every TokenType");
+static_assert(sizeof(delimiterFirst) / sizeof(delimiterFirst[0]) == _sqClose + 1, "delimiterFirst must cover every DelimiterType");
+static_assert(sizeof(operatorStartsExpression) / sizeof(operatorStartsExpression[0]) == _assPow + 1, "operatorStartsExpression must cover every OperatorType");
+static_assert(sizeof(isAssignmentOperator) / sizeof(isAssignmentOperator[0]) == _assPow + 1, "isAssignmentOperator must cover every OperatorType");
+
+/**
+ * @brief Predicts the statement kind from the first token of a statement
+ * 
+ * @param tokenType The general category of the first token
+ * @param token The specific enum value of the first token
+ * @return The StatementKind whose FIRST set contains the token
+ */
+constexpr StatementKind predictStatement(TokenType tokenType, int token)
+{
+    switch (tokenType) {
+    case _keyWord:
+        return keywordFirst[token];
+    case _operator:
+        return operatorStartsExpression[token] ? _expressionStatement : _invalidStatement;
+    case _delimiter:
+        return delimiterFirst[token];
+    case _whitespace:
+        return token == _newLine ? _emptyStatement : _invalidStatement;
+    default:
+        return tokenTypeFirst[tokenType];
+    }
+}
+
+static_assert(predictStatement(_keyWord, _while) == _whileStatement);
+static_assert(predictStatement(_operator, _not) == _expressionStatement);
+static_assert(predictStatement(_operator, _ass) == _invalidStatement);
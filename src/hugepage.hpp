@@ -0,0 +1,240 @@
+/**
+ * @file hugepage.hpp
+ * @brief Huge-page-backed arena for token and tree storage (--huge-pages)
+ *
+ * Parsing a large program walks the token arrays and builds a node for almost
+ * every token, and on 4 KiB pages a large share of those accesses miss the TLB.
+ * A HugePageArena reserves one large virtual range up front and commits it in
+ * 32 MiB steps as allocations reach it: explicit hugetlb pages while the system's
+ * pool has them, otherwise ordinary anonymous memory with MADV_HUGEPAGE so that
+ * the kernel backs it with transparent huge pages. Nothing is faulted in before
+ * it is touched.
+ *
+ * While an arena is active (see Scope) the Parser's token arrays and every new
+ * ExpressionNode are allocated from it. Memory is never returned piecemeal: a
+ * node deleted by the Rewriter stays in the arena until the arena goes.
+ *
+ * @author HoPiler Project
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <new>
+#include <string>
+#include <sys/mman.h>
+#include <vector>
+
+using namespace std;
+
+/**
+ * @class HugePageArena
+ * @brief Bump allocator over a lazily committed, huge-page-backed virtual range
+ *
+ * Arenas must outlive everything allocated from them, and are created and
+ * destroyed on one thread; activation (Scope) is per thread.
+ *
+ * Example:
+ * ```
+ * HugePageArena arena;
+ * ExpressionNode tree;
+ * {
+ *     HugePageArena::Scope scope(&arena);
+ *     tree = Parser(tokens, false).getTree(); // tokens and nodes are in the arena
+ * }
+ * ```
+ */
+class HugePageArena {
+private:
+    static constexpr size_t hugePage = 2 * 1024 * 1024;
+    static constexpr size_t commitStep = 16 * hugePage;
+
+    static inline thread_local HugePageArena* active = nullptr;
+    static inline vector<HugePageArena*> live; // for owns(), which delete needs
+
+    char* mapping = nullptr; // the whole reservation, including the alignment slack
+    size_t mappingSize = 0;
+    char* base = nullptr; // aligned to a huge page
+    size_t reserved = 0;
+    size_t committed = 0;
+    size_t used = 0;
+    size_t hugetlbBytes = 0;
+    bool tryHugetlb;
+
+    /// @brief Makes at least [base, base + needed) usable, from the hugetlb pool if it can
+    void commit(size_t needed)
+    {
+        if (needed > reserved)
+            throw bad_alloc();
+        size_t end = min((needed + commitStep - 1) / commitStep * commitStep, reserved);
+        char* start = base + committed;
+        size_t size = end - committed;
+        if (tryHugetlb) {
+            void* pages = mmap(start, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED | MAP_HUGETLB, -1, 0);
+            if (pages != MAP_FAILED) {
+                committed = end;
+                hugetlbBytes += size;
+                return;
+            }
+            tryHugetlb = false; // the pool is empty or absent; stop asking
+        }
+        // mapped again rather than mprotect-ed, since a failed MAP_FIXED may have unmapped the range
+        if (mmap(start, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0) == MAP_FAILED)
+            throw bad_alloc();
+        madvise(start, size, MADV_HUGEPAGE);
+        committed = end;
+    }
+
+public:
+    /**
+     * @class Scope
+     * @brief Makes an arena the one the current thread allocates tokens and nodes from
+     */
+    class Scope {
+    private:
+        HugePageArena* previous;
+
+    public:
+        explicit Scope(HugePageArena* arena)
+            : previous(active)
+        {
+            active = arena;
+        }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+        ~Scope()
+        {
+            active = previous;
+        }
+    };
+
+    /**
+     * @brief Constructor - reserves address space; nothing is committed yet
+     *
+     * @param reserve Bytes of address space to reserve (the arena cannot grow past it)
+     * @param hugetlb Whether to try explicit hugetlb pages before transparent ones
+     * @throws bad_alloc if the range cannot be reserved
+     */
+    explicit HugePageArena(size_t reserve = size_t(64) << 30, bool hugetlb = true)
+        : tryHugetlb(hugetlb)
+    {
+        reserved = (reserve + hugePage - 1) / hugePage * hugePage;
+        mappingSize = reserved + hugePage;
+        void* range = mmap(nullptr, mappingSize, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (range == MAP_FAILED)
+            throw bad_alloc();
+        mapping = (char*)range;
+        base = (char*)(((size_t)mapping + hugePage - 1) / hugePage * hugePage);
+        live.push_back(this);
+    }
+
+    HugePageArena(const HugePageArena&) = delete;
+    HugePageArena& operator=(const HugePageArena&) = delete;
+
+    ~HugePageArena()
+    {
+        munmap(mapping, mappingSize);
+        for (size_t i = 0; i < live.size(); i++)
+            if (live[i] == this) {
+                live.erase(live.begin() + i);
+                break;
+            }
+    }
+
+    /// @brief Gets the arena the current thread allocates from, or nullptr
+    static HugePageArena* current()
+    {
+        return active;
+    }
+
+    /// @brief Checks whether some live arena holds a pointer (then it must not be freed)
+    static bool owns(const void* pointer)
+    {
+        for (HugePageArena* arena : live)
+            if ((const char*)pointer >= arena->base && (const char*)pointer < arena->base + arena->reserved)
+                return true;
+        return false;
+    }
+
+    /**
+     * @brief Allocates memory that lives as long as the arena
+     *
+     * @throws bad_alloc if the reservation is used up or cannot be committed
+     */
+    void* allocate(size_t size, size_t alignment = alignof(max_align_t))
+    {
+        size_t start = (used + alignment - 1) & ~(alignment - 1);
+        if (start + size > committed)
+            commit(start + size);
+        used = start + size;
+        return base + start;
+    }
+
+    size_t getUsed() const { return used; }
+    size_t getCommitted() const { return committed; }
+    size_t getHugetlbBytes() const { return hugetlbBytes; }
+
+    /// @brief Gets the process's anonymous memory in transparent huge pages, or 0 if unknown
+    static size_t transparentHugeBytes()
+    {
+        ifstream rollup("/proc/self/smaps_rollup");
+        string line;
+        while (getline(rollup, line)) {
+            unsigned long long kilobytes;
+            if (sscanf(line.c_str(), "AnonHugePages: %llu kB", &kilobytes) == 1)
+                return kilobytes * 1024;
+        }
+        return 0;
+    }
+};
+
+/**
+ * @class HugePageAllocator
+ * @brief Standard allocator that takes memory from the arena active when it was created
+ *
+ * Without an active arena it falls back to operator new, so containers using it
+ * behave as usual unless --huge-pages is given.
+ */
+template <class T>
+class HugePageAllocator {
+public:
+    using value_type = T;
+
+    HugePageArena* arena;
+
+    HugePageAllocator()
+        : arena(HugePageArena::current())
+    {
+    }
+
+    template <class U>
+    HugePageAllocator(const HugePageAllocator<U>& other)
+        : arena(other.arena)
+    {
+    }
+
+    T* allocate(size_t count)
+    {
+        if (arena)
+            return (T*)arena->allocate(count * sizeof(T), alignof(T));
+        return (T*)::operator new(count * sizeof(T));
+    }
+
+    void deallocate(T* pointer, size_t)
+    {
+        if (!arena)
+            ::operator delete(pointer);
+    }
+
+    template <class U>
+    bool operator==(const HugePageAllocator<U>& other) const
+    {
+        return arena == other.arena;
+    }
+};
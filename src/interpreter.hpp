@@ -0,0 +1,671 @@
+/**
+ * @file interpreter.hpp
+ * @brief Tree-walking interpreter for HoLang
+ *
+ * The Interpreter class executes a parsed tree directly, without going through C.
+ * It keeps its variables between calls, so a driver can feed it one statement at
+ * a time (see Repl) or run a whole program at once (--run).
+ *
+ * The semantics follow the generated C: int is a 64-bit integer, float a double,
+ * integer division truncates, char and bool take part in arithmetic as integers and
+ * assigning to an int truncates a float.
+ *
+ * Strings are placed by lifetime (see analyseLifetimes()): temporaries that only
+ * feed an operator go to a statement region cleared after every statement, strings
+ * that initialise a block-local variable which never escapes go to a scope region
+ * reset when the block exits, and everything else is a reference-counted heap cell.
+ *
+ * @author HoPiler Project
+ */
+
+#pragma once
+
+#include "expNode.hpp"
+#include "region.hpp"
+#include "sampler.hpp"
+#include "tokens.hpp"
+#include "value.hpp"
+#include <cmath>
+#include <functional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+using namespace std;
+
+/**
+ * @enum Flow
+ * @brief How a statement finished
+ */
+enum Flow { _normalFlow,
+    _breakFlow,
+    _continueFlow,
+    _returnFlow };
+
+/**
+ * @class Interpreter
+ * @brief Executes HoLang trees against a persistent set of variables
+ *
+ * Variables live in a stack of scopes, one hash map per block; the global scope
+ * is never popped, so declarations made by one call are visible to the next.
+ * break, continue and return travel up as a Flow result instead of exceptions.
+ *
+ * Example:
+ * ```
+ * Interpreter interpreter;
+ * interpreter.run(tree);
+ * return interpreter.getExitStatus();
+ * ```
+ */
+class Interpreter {
+private:
+    // the regions are declared first so they outlive the values in scopes that point into them
+    Region statementRegion; // operands and other temporaries of the statement being executed
+    Region scopeRegion; // non-escaping strings of block-local variables, one mark per open block
+    vector<Region::Mark> scopeMarks;
+    unordered_set<ExpressionNode*> regionDeclarations; // see analyseLifetimes()
+    vector<unordered_map<string, Value>> scopes;
+    function<bool(const string&, Value&)> globalFallback; // see setGlobalFallback()
+    SampleProfiler* sampler = nullptr; // see setSampler()
+    function<bool(ExpressionNode*, Flow&)> loopHook; // see setLoopHook()
+    int exitStatus = 0;
+
+    /// @brief Throws a run-time error for a node
+    [[noreturn]] void runtimeError(ExpressionNode* node, string message)
+    {
+        throw runtime_error("Line " + to_string(node->getLine()) + ": " + message);
+    }
+
+    /// @brief Gets the HoLang name of a data type, for diagnostics
+    static string typeName(KeyWordType type)
+    {
+        static const char* const names[] = { "int", "float", "string", "char", "bool" };
+        return names[type - _int];
+    }
+
+    /**
+     * @brief Finds a variable through the enclosing scopes
+     *
+     * @return The variable, or nullptr if it is not declared; a global that only the
+     *         fallback knows is copied into the global scope first
+     */
+    Value* find(const string& name)
+    {
+        for (int i = scopes.size() - 1; i >= 0; i--) {
+            auto found = scopes[i].find(name);
+            if (found != scopes[i].end())
+                return &found->second;
+        }
+        Value value;
+        if (globalFallback && globalFallback(name, value))
+            return &scopes[0].emplace(name, std::move(value)).first->second;
+        return nullptr;
+    }
+
+    /// @brief Finds a variable through the enclosing scopes, which has to exist
+    Value& lookup(ExpressionNode* node)
+    {
+        Value* variable = find(node->getTokenValue());
+        if (!variable)
+            runtimeError(node, "Use of undeclared variable " + node->getTokenValue());
+        return *variable;
+    }
+
+    /**
+     * @brief Converts a value for storing in a variable of the given type
+     *
+     * @throws runtime_error when a string meets a number
+     */
+    Value convert(ExpressionNode* node, KeyWordType target, Value value)
+    {
+        KeyWordType type = value.getType();
+        if ((target == _string) != (type == _string))
+            runtimeError(node, "Cannot assign a " + typeName(type) + " to a " + typeName(target));
+        if (type == target)
+            return value;
+
+        switch (target) {
+        case _float:
+            return Value::fromFloat(value.asFloat());
+        case _char:
+            return Value::fromChar((char)value.asInt());
+        case _bool:
+            return Value::fromBool(value.isTrue());
+        default:
+            return Value::fromInt(value.asInt());
+        }
+    }
+
+    /**
+     * @brief Applies an arithmetic or comparison operator to two evaluated operands
+     *
+     * Two inline ints (the common case) are recognised with one bit test and take
+     * the fast path at the top; everything else goes through the general dispatch.
+     */
+    Value applyBinary(ExpressionNode* node, int op, const Value& left, const Value& right, Region* region)
+    {
+        if (Value::bothInts(left, right)) {
+            long long a = left.smallInt(), b = right.smallInt();
+            switch (op) {
+            case _add:
+                return Value::fromInt(a + b); // cannot overflow, inline ints have 48 bits
+            case _sub:
+                return Value::fromInt(a - b);
+            case _lt:
+                return Value::fromBool(a < b);
+            case _gt:
+                return Value::fromBool(a > b);
+            case _eq:
+                return Value::fromBool(a == b);
+            }
+        }
+
+        bool strings = left.isString() || right.isString();
+        if (strings && !(left.isString() && right.isString()))
+            runtimeError(node, "Cannot combine a " + typeName(left.getType()) + " with a " + typeName(right.getType()));
+
+        if (strings) {
+            if (op == _add)
+                return Value::concat(left, right, region);
+            int order = left.getText().compare(right.getText());
+            switch (op) {
+            case _eq:
+                return Value::fromBool(order == 0);
+            case _neq:
+                return Value::fromBool(order != 0);
+            case _gte:
+                return Value::fromBool(order >= 0);
+            case _lte:
+                return Value::fromBool(order <= 0);
+            case _gt:
+                return Value::fromBool(order > 0);
+            case _lt:
+                return Value::fromBool(order < 0);
+            }
+            runtimeError(node, "Operator does not apply to strings");
+        }
+
+        bool floats = left.isFloat() || right.isFloat();
+        long long a = floats ? 0 : left.asInt(), b = floats ? 0 : right.asInt();
+        double x = left.asFloat(), y = right.asFloat();
+        switch (op) {
+        case _add:
+            return floats ? Value::fromFloat(x + y) : Value::fromInt((long long)((unsigned long long)a + b));
+        case _sub:
+            return floats ? Value::fromFloat(x - y) : Value::fromInt((long long)((unsigned long long)a - b));
+        case _mul:
+            return floats ? Value::fromFloat(x * y) : Value::fromInt((long long)((unsigned long long)a * b));
+        case _div:
+            if (floats)
+                return Value::fromFloat(x / y);
+            if (b == 0)
+                runtimeError(node, "Division by zero");
+            return Value::fromInt(a / b);
+        case _mod:
+            if (floats)
+                return Value::fromFloat(fmod(x, y));
+            if (b == 0)
+                runtimeError(node, "Division by zero");
+            return Value::fromInt(a % b);
+        case _pow:
+            return floats ? Value::fromFloat(pow(x, y)) : Value::fromInt(integerPower(a, b));
+        case _xor:
+            return Value::fromBool(left.isTrue() != right.isTrue());
+        case _eq:
+            return Value::fromBool(floats ? x == y : a == b);
+        case _neq:
+            return Value::fromBool(floats ? x != y : a != b);
+        case _gte:
+            return Value::fromBool(floats ? x >= y : a >= b);
+        case _lte:
+            return Value::fromBool(floats ? x <= y : a <= b);
+        case _gt:
+            return Value::fromBool(floats ? x > y : a > b);
+        case _lt:
+            return Value::fromBool(floats ? x < y : a < b);
+        }
+        runtimeError(node, "Assignment used as a value");
+    }
+
+    /**
+     * @brief Collects the names whose string could outlive their block
+     *
+     * A name escapes when it is assigned to (the region could not free the old
+     * value) or copied whole into another variable (the copy shares the cell).
+     * Shadowing is ignored, which only ever errs towards the heap.
+     */
+    static void collectEscapes(ExpressionNode* node, unordered_set<string>& names)
+    {
+        ExpressionNode* first = node->getFirstChild();
+        if (node->getTokenType() == _keyWord && node->getToken() >= _int) {
+            if (first->getTokenType() == _operator && first->getFirstChild()->getNextSibling()->getTokenType() == _identifier)
+                names.insert(first->getFirstChild()->getNextSibling()->getTokenValue());
+            return; // the declared name itself is not an assignment
+        }
+        if (node->getTokenType() == _operator && node->getToken() >= _ass) {
+            names.insert(first->getTokenValue());
+            if (first->getNextSibling()->getTokenType() == _identifier)
+                names.insert(first->getNextSibling()->getTokenValue());
+        }
+        for (ExpressionNode* child = first; child; child = child->getNextSibling())
+            collectEscapes(child, names);
+    }
+
+    /// @brief Marks the string declarations of a block (and of the blocks inside it) that can use the scope region
+    void markRegionDeclarations(ExpressionNode* node, bool isScope)
+    {
+        if (isScope) {
+            unordered_set<string> escapes;
+            collectEscapes(node, escapes);
+            for (ExpressionNode* child = node->getFirstChild(); child; child = child->getNextSibling()) {
+                ExpressionNode* first = child->getFirstChild();
+                if (child->getTokenType() == _keyWord && child->getToken() == _string && first->getTokenType() == _operator
+                    && !escapes.count(first->getFirstChild()->getTokenValue()))
+                    regionDeclarations.insert(child);
+            }
+        }
+        for (ExpressionNode* child = node->getFirstChild(); child; child = child->getNextSibling())
+            markRegionDeclarations(child, child->getTokenType() == _expression || (child->getTokenType() == _keyWord && child->getToken() == _for));
+    }
+
+    /// @brief Opens a scope together with its part of the scope region
+    void pushScope()
+    {
+        scopes.emplace_back();
+        scopeMarks.push_back(scopeRegion.mark());
+    }
+
+    /// @brief Closes the innermost scope and frees its region strings in one step
+    void popScope()
+    {
+        scopes.pop_back();
+        scopeRegion.reset(scopeMarks.back());
+        scopeMarks.pop_back();
+    }
+
+    /// @brief Executes the statements of a block in a new scope
+    Flow executeBlock(ExpressionNode* block)
+    {
+        pushScope();
+        Flow flow = _normalFlow;
+        for (ExpressionNode* child = block ? block->getFirstChild() : nullptr; child && flow == _normalFlow; child = child->getNextSibling())
+            flow = execute(child);
+        popScope();
+        return flow;
+    }
+
+    /// @brief Executes a declaration in the innermost scope
+    void declare(ExpressionNode* node)
+    {
+        KeyWordType type = (KeyWordType)node->getToken();
+        ExpressionNode* child = node->getFirstChild();
+        bool initialised = child->getTokenType() == _operator;
+        ExpressionNode* nameNode = initialised ? child->getFirstChild() : child;
+
+        Value value = Value::zero(type);
+        if (initialised) {
+            Region* region = type == _string && regionDeclarations.count(node) ? &scopeRegion : nullptr;
+            value = convert(node, type, evaluate(nameNode->getNextSibling(), region));
+        }
+        if (scopes.size() == 1)
+            find(nameNode->getTokenValue()); // brings in a fallback global of the same name, which makes this a redeclaration
+        if (!scopes.back().emplace(nameNode->getTokenValue(), std::move(value)).second)
+            runtimeError(node, "Variable " + nameNode->getTokenValue() + " is already declared in this block");
+    }
+
+    /// @brief Executes an assignment (plain or compound)
+    void assign(ExpressionNode* node)
+    {
+        ExpressionNode* target = node->getFirstChild();
+        if (target->getTokenType() != _identifier)
+            runtimeError(node, "Only variables can be assigned to");
+        int op = node->getToken();
+        Value value = evaluate(target->getNextSibling(), op == _ass ? nullptr : &statementRegion);
+        Value& variable = lookup(target);
+
+        static const OperatorType arithmetic[] = { _add, _add, _sub, _mul, _div, _mod, _pow }; // indexed by op - _ass
+        if (op != _ass) {
+            if (variable.isString() && op != _assAdd)
+                runtimeError(node, "Operator does not apply to strings");
+            value = applyBinary(node, arithmetic[op - _ass], variable, value, nullptr);
+        }
+        variable = convert(node, variable.getType(), std::move(value));
+    }
+
+    /// @brief Executes an if statement with its elif and else arms
+    Flow executeIf(ExpressionNode* node)
+    {
+        ExpressionNode* test = node->getFirstChild();
+        if (condition(test))
+            return executeBlock(test->getNextSibling());
+        for (ExpressionNode* arm = test->getNextSibling()->getNextSibling(); arm; arm = arm->getNextSibling()) {
+            if (arm->getToken() == _else)
+                return executeBlock(arm->getFirstChild());
+            if (condition(arm->getFirstChild()))
+                return executeBlock(arm->getFirstChild()->getNextSibling());
+        }
+        return _normalFlow;
+    }
+
+    /// @brief Evaluates an operand of and/or as a truth value
+    bool truth(ExpressionNode* node)
+    {
+        Value value = evaluate(node, &statementRegion);
+        if (value.isString())
+            runtimeError(node, "A string cannot be used as a condition");
+        return value.isTrue();
+    }
+
+    /// @brief Evaluates the condition of a statement, freeing its temporaries
+    bool condition(ExpressionNode* node)
+    {
+        bool result = truth(node);
+        statementRegion.clear();
+        return result;
+    }
+
+    /// @brief Executes a loop body, mapping break and continue to whether the loop goes on
+    bool loopBody(ExpressionNode* block, Flow& flow)
+    {
+        flow = executeBlock(block);
+        if (flow == _breakFlow) {
+            flow = _normalFlow;
+            return false;
+        }
+        if (flow == _continueFlow)
+            flow = _normalFlow;
+        return flow == _normalFlow;
+    }
+
+    /// @brief Executes one statement, see execute()
+    Flow executeStatement(ExpressionNode* node)
+    {
+        if (node->getTokenType() == _expression)
+            return executeBlock(node);
+        if (node->getTokenType() != _keyWord) {
+            if (node->getTokenType() == _operator && node->getToken() >= _ass)
+                assign(node);
+            else
+                evaluate(node, &statementRegion);
+            statementRegion.clear();
+            return _normalFlow;
+        }
+
+        ExpressionNode* first = node->getFirstChild();
+        Flow flow = _normalFlow;
+        switch (node->getToken()) {
+        case _if:
+            return executeIf(node);
+        case _while:
+            for (long iterations = 1; condition(first) && loopBody(first->getNextSibling(), flow); iterations++)
+                if (loopHook && iterations % loopHookInterval == 0 && loopHook(node, flow))
+                    break;
+            return flow;
+        case _do:
+            for (long iterations = 1; loopBody(first, flow) && condition(first->getNextSibling()); iterations++)
+                if (loopHook && iterations % loopHookInterval == 0 && loopHook(node, flow))
+                    break;
+            return flow;
+        case _for: {
+            ExpressionNode* test = first->getNextSibling();
+            ExpressionNode* step = test->getNextSibling();
+            pushScope();
+            execute(first);
+            for (long iterations = 1; condition(test) && loopBody(step->getNextSibling(), flow); iterations++) {
+                execute(step);
+                if (loopHook && iterations % loopHookInterval == 0 && loopHook(node, flow))
+                    break;
+            }
+            popScope();
+            return flow;
+        }
+        case _break:
+            return _breakFlow;
+        case _continue:
+            return _continueFlow;
+        case _return:
+            if (first) {
+                Value value = evaluate(first, &statementRegion);
+                if (value.isString())
+                    runtimeError(node, "The program can only return a number");
+                exitStatus = (int)value.asInt();
+            }
+            return _returnFlow;
+        case _elif:
+        case _else:
+            runtimeError(node, "elif/else without a matching if");
+        default:
+            declare(node);
+            statementRegion.clear();
+            return _normalFlow;
+        }
+    }
+
+public:
+    static constexpr long loopHookInterval = 256; // iterations of one loop between calls of the loop hook
+
+    /// @brief Raises an integer to an integer power, like ho_ipow() in the generated C
+    static long long integerPower(long long base, long long exponent)
+    {
+        if (exponent < 0)
+            return base == 1 ? 1 : base == -1 ? (exponent % 2 ? -1 : 1) : 0;
+        unsigned long long result = 1, factor = base;
+        for (; exponent > 0; exponent >>= 1) {
+            if (exponent & 1)
+                result *= factor;
+            factor *= factor;
+        }
+        return (long long)result;
+    }
+
+    /// @brief Constructor - an interpreter with an empty global scope
+    Interpreter()
+        : scopes(1)
+    {
+    }
+
+    /**
+     * @brief Evaluates an expression
+     *
+     * @param node Root of the expression subtree
+     * @param region Where a string result is made; nullptr for the heap. Operands
+     *               always go to the statement region.
+     * @return The value of the expression
+     * @throws runtime_error on type errors, undeclared variables and division by zero
+     */
+    Value evaluate(ExpressionNode* node, Region* region = nullptr)
+    {
+        switch (node->getTokenType()) {
+        case _literal:
+            switch (node->getToken()) {
+            case _intLit:
+                return Value::fromInt(stoll(node->getTokenValue()));
+            case _floatLit:
+                return Value::fromFloat(stod(node->getTokenValue()));
+            case _charLit:
+                return Value::fromChar(node->getTokenValue()[0]);
+            default:
+                return Value::fromString(node->getTokenValue(), region);
+            }
+        case _identifier: {
+            string name = node->getTokenValue();
+            Value* variable = find(name);
+            if (!variable && (name == "true" || name == "false"))
+                return Value::fromBool(name == "true"); // same stand-in as the code generator
+            if (!variable)
+                runtimeError(node, "Use of undeclared variable " + name);
+            return *variable;
+        }
+        case _operator: {
+            ExpressionNode* left = node->getFirstChild();
+            int op = node->getToken();
+            if (node->getChildCount() == 1) {
+                Value operand = evaluate(left, &statementRegion);
+                if (operand.isString())
+                    runtimeError(node, "Operator does not apply to strings");
+                if (op == _not)
+                    return Value::fromBool(!operand.isTrue());
+                return operand.isFloat() ? Value::fromFloat(-operand.asFloat()) : Value::fromInt((long long)(0ULL - operand.asInt()));
+            }
+            if (op == _and || op == _or) {
+                bool result = truth(left);
+                if (result == (op == _and))
+                    result = truth(left->getNextSibling());
+                return Value::fromBool(result);
+            } // short-circuit like C
+            Value leftValue = evaluate(left, &statementRegion);
+            return applyBinary(node, op, leftValue, evaluate(left->getNextSibling(), &statementRegion), region);
+        }
+        default:
+            runtimeError(node, "Expected an expression");
+        }
+    }
+
+    /**
+     * @brief Executes one statement
+     *
+     * @param node The statement node
+     * @return How the statement finished; a top-level return also sets the exit status
+     * @throws runtime_error on errors; the interpreter stays usable, see recover()
+     */
+    Flow execute(ExpressionNode* node)
+    {
+        if (!sampler || node->getTokenType() == _expression)
+            return executeStatement(node);
+        sampler->enter(node);
+        Flow flow = executeStatement(node);
+        sampler->leave();
+        return flow;
+    }
+
+    /**
+     * @brief Decides which string declarations of a tree can live in the scope region
+     *
+     * A string declared in a block (not the global scope) whose name is never
+     * assigned to and never copied whole into another variable cannot outlive the
+     * block, so its initial value is made in the scope region and freed with the
+     * block. Must be called before executing statements of a new tree; without it
+     * every variable simply uses the heap.
+     *
+     * @param root The root of the tree; replaces the result for any earlier tree
+     */
+    void analyseLifetimes(ExpressionNode& root)
+    {
+        regionDeclarations.clear();
+        markRegionDeclarations(&root, false);
+    }
+
+    /**
+     * @brief Runs the statements of a tree in the global scope
+     *
+     * @param root The root of the tree (usually Parser::getTree())
+     * @return true if the program executed a top-level return
+     */
+    bool run(ExpressionNode& root)
+    {
+        analyseLifetimes(root);
+        for (ExpressionNode* child = root.getFirstChild(); child; child = child->getNextSibling()) {
+            Flow flow = execute(child);
+            if (flow == _returnFlow)
+                return true;
+            if (flow != _normalFlow)
+                runtimeError(child, "break or continue outside of a loop");
+        }
+        return false;
+    }
+
+    /**
+     * @brief Sets where globals that were never declared in this interpreter come from
+     *
+     * @param fallback Called with a name the scopes do not know; fills in the value
+     *                 and returns true if it has the global. The value is copied into
+     *                 the global scope on first use, so the fallback is asked once per name.
+     *
+     * Used to start from a HeapSnapshot without loading all of it up front.
+     */
+    void setGlobalFallback(function<bool(const string&, Value&)> fallback)
+    {
+        globalFallback = fallback;
+    }
+
+    /// @brief Gets the variables of the global scope
+    const unordered_map<string, Value>& getGlobals()
+    {
+        return scopes[0];
+    }
+
+    /**
+     * @brief Has a SampleProfiler follow which statements are executing
+     *
+     * @param profiler The profiler, or nullptr to stop reporting to it
+     */
+    void setSampler(SampleProfiler* profiler)
+    {
+        sampler = profiler;
+    }
+
+    /**
+     * @brief Sets what runs at the safe points of long loops
+     *
+     * @param hook Called with the loop node every loopHookInterval iterations, at an
+     *             iteration boundary: a while or for loop is about to test its
+     *             condition (the for step has run), a do loop is about to run its
+     *             body. When the hook ran the rest of the loop itself it sets the
+     *             flow (_normalFlow or _returnFlow) and returns true.
+     *
+     * Used by TieredCompiler to continue hot loops as native code.
+     */
+    void setLoopHook(function<bool(ExpressionNode*, Flow&)> hook)
+    {
+        loopHook = hook;
+    }
+
+    /**
+     * @brief Finds a variable visible at the current point of execution
+     *
+     * @return The variable, or nullptr if it is not declared
+     */
+    Value* variable(const string& name)
+    {
+        return find(name);
+    }
+
+    /**
+     * @brief Evaluates an expression statement and frees the temporaries of its operands
+     *
+     * @return The value, which does not live in a region
+     * @throws runtime_error like evaluate()
+     */
+    Value evaluateStatement(ExpressionNode* node)
+    {
+        Value value = evaluate(node);
+        statementRegion.clear();
+        return value;
+    }
+
+    /// @brief Drops the block scopes left behind by a statement that threw, keeping the globals
+    void recover()
+    {
+        scopes.resize(1);
+        if (sampler)
+            sampler->reset();
+        scopeMarks.clear();
+        scopeRegion.clear();
+        statementRegion.clear();
+    }
+
+    /// @brief Sets the exit status, for a loop hook that executed a return
+    void setExitStatus(int status)
+    {
+        exitStatus = status;
+    }
+
+    /// @brief Gets the status set by the last top-level return (0 if none)
+    int getExitStatus()
+    {
+        return exitStatus;
+    }
+};
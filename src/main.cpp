@@ -6,18 +6,80 @@
  * 1. Validates command-line arguments
  * 2. Creates and runs the Tokenizer (lexical analysis)
  * 3. Creates and runs the Parser (syntax analysis)
+ * 4. Simplifies the tree with the Rewriter (peephole rules)
+ * 5. Generates C with the CodeGenerator and writes it next to the source file,
+ *    leaving out the declarations and assignments no result depends on
  * 
  * The transpiler expects the source filename as a command-line argument.
+ * When more than one filename is given, the files are handled in batch mode
+ * (see BatchCompiler), where identical inputs are only transpiled once.
  * 
- * Usage: HoPiler <source_file>
+ * Usage: HoPiler [options] <source_file> [more_source_files...]
  * Example: HoPiler program.ho
  * 
+ * Options:
+ * - --cfg  Prints the control-flow graph and dominator tree of the program
+ * - --profile  Instruments the generated program to write its branch profile
+ *   (<source>.prof) when it exits
+ * - --use-profile <file>  Lays the generated C out for a profile written by an
+ *   instrumented build (branch hints and cold paths)
+ * - --run  Interprets the program instead of generating C; its top-level return
+ *   value becomes the exit status
+ * - --snapshot <file>  With --run, skips the program's leading declarations by
+ *   restoring the globals they produced from <file>, or creates <file> if it is
+ *   missing or was taken from an older version of the source
+ * - --repl  Starts an interactive session (no source file needed)
+ * - --alloc-profile  Makes the generated program write per-line allocation
+ *   counts, bytes and lifetimes (<source>.alloc) when it exits
+ * - --serve  Treats every source file as a module and answers requests from
+ *   stdin (one module name per line) with the module's return value; changed
+ *   sources are recompiled and swapped in while serving
+ * - --tiered  With --run, compiles loops that keep running to native code in the
+ *   background (with $CC or cc) and continues them there once they are ready
+ * - --sample-profile  With --run, samples which statements are executing every
+ *   millisecond of CPU time and writes them as folded stacks (<source>.folded)
+ * - --codegen-report  Writes <source>.codegen: the bytes of C, C statements and
+ *   string temporaries every source line and construct produced, with the lines
+ *   over budget flagged
+ * - --codegen-budget <bytes=N,statements=N,temporaries=N>  Sets the per-line
+ *   budget of --codegen-report
+ * - --time-shards  With --codegen-report, also times `$CC -fsyntax-only` on
+ *   groups of top-level statements
+ * - --engine <tree|closures>  With --run, picks the execution engine: the tree
+ *   walking Interpreter (default) or the ClosureCompiler
+ * - --bench  Builds the generated C with $CC -O2 and runs it repeatedly, pinned to
+ *   one CPU, reporting the median and MAD of time, instructions and cycles and
+ *   writing them to <source>.bench.json
+ * - --bench-runs <N>, --bench-warmup <N>, --bench-cpu <N>  Measured runs (10),
+ *   unmeasured runs before them (2) and the CPU to pin to (the last usable one)
+ * - --jobs <N>  Threads of batch mode (default: one per CPU); the distinct inputs
+ *   are compiled largest first
+ * - --huge-pages  Keeps the parser's tokens and the tree in a HugePageArena
+ * - --keep-unreachable  Also emits the declarations and assignments of variables
+ *   no return or condition depends on (see TreeShaker)
+ * - --parse-stats  Prints the time, data TLB misses and page faults of tokenizing
+ *   and parsing (and the arena's memory with --huge-pages) instead of the token dump
+ * 
  * @author HoPiler Project
  */
 
 #include <iostream>
+#include "batch.hpp"
+#include "bench.hpp"
+#include "cfg.hpp"
+#include "closures.hpp"
+#include "codegen.hpp"
+#include "hugepage.hpp"
+#include "interpreter.hpp"
+#include "repl.hpp"
+#include "report.hpp"
+#include "sampler.hpp"
+#include "server.hpp"
+#include "snapshot.hpp"
+#include "tiering.hpp"
 #include "tokenizer.hpp"
 #include "parser.hpp"
+#include "rewriter.hpp"
 
 using namespace std;
 
@@ -28,19 +90,291 @@ using namespace std;
  * @param argv Argument vector (array of command-line argument strings)
  * 
  * @return EXIT_SUCCESS (0) if transpilation completes
- *         EXIT_FAILURE (1) if argument validation fails
+ *         EXIT_FAILURE (1) if argument validation fails or a batch input fails
  */
 int main(int argc, char* argv[])
 {
-    if (argc != 2) {
+    vector<string> fileNames;
+    bool printCfg = false;
+    bool interpret = false;
+    bool sampleProfile = false;
+    bool tiered = false;
+    bool serve = false;
+    string engine = "tree";
+    bool codegenReport = false;
+    bool timeShards = false;
+    bool bench = false;
+    int benchRuns = 10, benchWarmup = 2, benchCpu = -1;
+    int jobs = max(1u, thread::hardware_concurrency());
+    bool hugePages = false;
+    bool parseStats = false;
+    CodegenBudget budget;
+    string snapshotName;
+    CodegenOptions options;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--cfg") {
+            printCfg = true;
+        } else if (arg == "--run") {
+            interpret = true;
+        } else if (arg == "--snapshot") {
+            if (++i == argc) {
+                cerr << "--snapshot needs a snapshot file" << endl;
+                return EXIT_FAILURE;
+            }
+            snapshotName = argv[i];
+        } else if (arg == "--repl") {
+            return Repl().run(cin, cout);
+        } else if (arg == "--profile") {
+            options.instrument = true;
+        } else if (arg == "--serve") {
+            serve = true;
+        } else if (arg == "--tiered") {
+            tiered = true;
+        } else if (arg == "--engine") {
+            if (++i == argc || (string(argv[i]) != "tree" && string(argv[i]) != "closures")) {
+                cerr << "--engine needs tree or closures" << endl;
+                return EXIT_FAILURE;
+            }
+            engine = argv[i];
+        } else if (arg == "--codegen-report") {
+            codegenReport = true;
+        } else if (arg == "--time-shards") {
+            timeShards = true;
+        } else if (arg == "--codegen-budget") {
+            if (++i == argc) {
+                cerr << "--codegen-budget needs a budget like bytes=2048,statements=40" << endl;
+                return EXIT_FAILURE;
+            }
+            try {
+                budget = CodegenBudget::parse(argv[i]);
+            } catch (const std::exception& e) {
+                cerr << e.what() << endl;
+                return EXIT_FAILURE;
+            }
+        } else if (arg == "--bench") {
+            bench = true;
+        } else if (arg == "--bench-runs" || arg == "--bench-warmup" || arg == "--bench-cpu") {
+            int* setting = arg == "--bench-runs" ? &benchRuns : arg == "--bench-warmup" ? &benchWarmup : &benchCpu;
+            try {
+                if (++i == argc)
+                    throw invalid_argument("missing");
+                *setting = stoi(argv[i]);
+                if (*setting < (arg == "--bench-runs"))
+                    throw invalid_argument("negative");
+            } catch (const std::exception&) {
+                cerr << arg << " needs a " << (arg == "--bench-runs" ? "positive" : "non-negative") << " number" << endl;
+                return EXIT_FAILURE;
+            }
+        } else if (arg == "--jobs") {
+            try {
+                if (++i == argc || (jobs = stoi(argv[i])) < 1)
+                    throw invalid_argument("not positive");
+            } catch (const std::exception&) {
+                cerr << "--jobs needs a positive number of threads" << endl;
+                return EXIT_FAILURE;
+            }
+        } else if (arg == "--huge-pages") {
+            hugePages = true;
+        } else if (arg == "--parse-stats") {
+            parseStats = true;
+        } else if (arg == "--sample-profile") {
+            sampleProfile = true;
+        } else if (arg == "--keep-unreachable") {
+            options.keepUnreachable = true;
+        } else if (arg == "--alloc-profile") {
+            options.allocationProfile = true;
+        } else if (arg == "--use-profile") {
+            if (++i == argc) {
+                cerr << "--use-profile needs a profile file" << endl;
+                return EXIT_FAILURE;
+            }
+            try {
+                options.profile = BranchProfile(argv[i]);
+            } catch (const std::exception& e) {
+                cerr << e.what() << endl;
+                return EXIT_FAILURE;
+            }
+        } else if (arg.rfind("--", 0) == 0) {
+            cerr << "Unknown option " << arg << endl;
+            return EXIT_FAILURE;
+        } else {
+            fileNames.push_back(arg);
+        }
+    } // options start with --, everything else is a source file
+
+    if (fileNames.empty()) {
         cerr << "HoPiler failed. No source coude given! When running the code, also include the filename like:" << endl
              << "HoPiler fileName.ho";
         return EXIT_FAILURE;
     }
 
-    string fileName = string(argv[1]);
-    Tokenizer tokenizer(fileName);
-    Parser parser(tokenizer.getTokens());
+    if (serve) {
+        try {
+            return ModuleServer::serve(fileNames, cin, cout);
+        } catch (const std::exception& e) {
+            cerr << e.what() << endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (fileNames.size() > 1 && (interpret || !snapshotName.empty() || tiered || sampleProfile || engine != "tree" || printCfg || hugePages || parseStats)) {
+        cerr << "--run, --snapshot, --tiered, --sample-profile, --engine, --cfg, --huge-pages and --parse-stats need a single source file" << endl;
+        return EXIT_FAILURE;
+    }
+
+    if ((codegenReport || timeShards) && (fileNames.size() > 1 || interpret)) {
+        cerr << "--codegen-report needs a single source file and cannot be combined with --run" << endl;
+        return EXIT_FAILURE;
+    }
+
+    if (bench && (fileNames.size() > 1 || interpret || codegenReport || timeShards)) {
+        cerr << "--bench needs a single source file and cannot be combined with --run or --codegen-report" << endl;
+        return EXIT_FAILURE;
+    }
+    if (bench && benchCpu >= 0 && !Benchmark::isAllowedCpu(benchCpu)) {
+        cerr << "--bench-cpu " << benchCpu << " is not a CPU this process may run on" << endl;
+        return EXIT_FAILURE;
+    }
+    if (bench) {
+        try {
+            Tokenizer tokenizer(fileNames[0], false);
+            Parser parser(tokenizer.getTokens(), false);
+            ExpressionNode tree = parser.getTree();
+            Rewriter().rewrite(tree);
+            Benchmark benchmark(fileNames[0], CodeGenerator(tree, options).getCode(fileNames[0]), benchCpu);
+            benchmark.run(benchRuns, benchWarmup);
+            benchmark.print(cout);
+            string resultName = fileNames[0] + ".bench.json";
+            benchmark.writeJson(resultName);
+            cout << "Wrote " << resultName << endl;
+        } catch (const std::exception& e) {
+            cerr << e.what() << endl;
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+
+    if (fileNames.size() > 1) {
+        BatchCompiler batch(fileNames, options, jobs);
+        bool success = batch.run();
+        batch.printSummary();
+        return success ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    string fileName = fileNames[0];
+    if ((sampleProfile || tiered) && (!interpret || !snapshotName.empty())) {
+        cerr << (tiered ? "--tiered" : "--sample-profile") << " needs --run and cannot be combined with --snapshot" << endl;
+        return EXIT_FAILURE;
+    }
+    if (engine != "tree" && (!interpret || !snapshotName.empty() || sampleProfile || tiered)) {
+        cerr << "--engine closures needs --run and cannot be combined with --snapshot, --sample-profile or --tiered" << endl;
+        return EXIT_FAILURE;
+    }
+    if (interpret && !snapshotName.empty()) {
+        try {
+            return WarmStart::run(fileName, snapshotName);
+        } catch (const SyntaxError&) {
+            return EXIT_FAILURE; // already printed by the Tokenizer or Parser
+        } catch (const std::exception& e) {
+            cerr << e.what() << endl;
+            return EXIT_FAILURE;
+        }
+    }
+    if (interpret) {
+        ExpressionNode tree { Token() };
+        try {
+            Tokenizer tokenizer(fileName, false);
+            Parser parser(tokenizer.getTokens(), false);
+            tree = parser.getTree();
+        } catch (const SyntaxError&) {
+            return EXIT_FAILURE; // already printed by the Tokenizer or Parser
+        }
+        if (engine == "closures") {
+            try {
+                ClosureCompiler program(tree);
+                program.run();
+                return program.getExitStatus();
+            } catch (const std::exception& e) {
+                cerr << e.what() << endl;
+                return EXIT_FAILURE;
+            }
+        }
+        Interpreter interpreter;
+        SampleProfiler profiler;
+        try {
+            unique_ptr<TieredCompiler> tiers;
+            if (tiered)
+                tiers = make_unique<TieredCompiler>(interpreter);
+            if (sampleProfile) {
+                interpreter.setSampler(&profiler);
+                profiler.start();
+            }
+            interpreter.run(tree);
+            if (sampleProfile) {
+                profiler.stop();
+                string profileName = fileName + ".folded";
+                cerr << "Wrote " << profiler.writeFolded(profileName, fileName) << " samples to " << profileName;
+                if (profiler.getDropped())
+                    cerr << " (" << profiler.getDropped() << " dropped)";
+                cerr << endl;
+            }
+        } catch (const std::exception& e) {
+            cerr << e.what() << endl;
+            return EXIT_FAILURE;
+        }
+        return interpreter.getExitStatus();
+    }
+
+    unique_ptr<HugePageArena> arena; // before the tree, whose nodes may live in it
+    if (hugePages)
+        arena = make_unique<HugePageArena>();
+    ExpressionNode tree { Token() };
+    {
+        HugePageArena::Scope scope(arena.get());
+        PerfCounter tlbMisses(0, PERF_TYPE_HW_CACHE, PerfCounter::dtlbReadMisses, false);
+        PerfCounter pageFaults(0, PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS, false);
+        auto start = chrono::steady_clock::now();
+        Tokenizer tokenizer(fileName, !parseStats);
+        Parser parser(tokenizer.getTokens(), !parseStats);
+        tree = parser.getTree();
+        if (parseStats) {
+            double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            auto count = [](double value) { return value < 0 ? string("n/a") : to_string((long long)value); };
+            cout << "Tokenized and parsed in " << seconds << " s: " << count(tlbMisses.read()) << " dTLB load misses, "
+                 << count(pageFaults.read()) << " page faults" << endl;
+            if (arena)
+                cout << "Arena: " << (arena->getUsed() >> 20) << " MiB used, " << (arena->getCommitted() >> 20) << " MiB committed ("
+                     << (arena->getHugetlbBytes() >> 20) << " MiB hugetlb), " << (HugePageArena::transparentHugeBytes() >> 20)
+                     << " MiB of the process in transparent huge pages" << endl;
+        }
+    }
+    cout << "Applied " << Rewriter().rewrite(tree) << " simplifications" << endl;
+
+    if (printCfg) {
+        ControlFlowGraph cfg(tree);
+        cfg.print();
+    }
+
+    CodegenReport report;
+    if (codegenReport)
+        options.report = &report;
+    CodeGenerator generator(tree, options);
+    cout << "Left out " << generator.getUnreachableCount() << " unreachable statements" << endl;
+    cout << "Wrote " << generator.write(fileName) << endl;
+
+    if (codegenReport) {
+        try {
+            if (timeShards)
+                report.timeShards(generator.getSkeleton(fileName), generator.getShards(fileName));
+            string reportName = fileName + ".codegen";
+            int overBudget = report.write(reportName, fileName, budget);
+            cout << "Wrote " << reportName << " (" << overBudget << " lines over budget)" << endl;
+        } catch (const std::exception& e) {
+            cerr << e.what() << endl;
+            return EXIT_FAILURE;
+        }
+    }
 
     return EXIT_SUCCESS;
 }
\ No newline at end of file
@@ -0,0 +1,158 @@
+/**
+ * @file native.hpp
+ * @brief Building generated C into shared objects and loading them
+ *
+ * Shared by tiered execution (TieredCompiler) and the module server (ModuleServer),
+ * which generate C at run time, compile it with the system C compiler and dlopen
+ * the result, by the codegen report (CodegenReport), which times the compiler's
+ * front end on the generated C, and by the benchmark runner (Benchmark), which
+ * builds the generated C into a program.
+ *
+ * @author HoPiler Project
+ */
+
+#pragma once
+
+#include <cerrno>
+#include <cstdlib>
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <fstream>
+#include <spawn.h>
+#include <stdexcept>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+
+/**
+ * @class NativeBuild
+ * @brief A private build directory that turns C source into loaded shared objects
+ *
+ * The compiler is $CC, or cc if it is not set, run without a shell and with its
+ * output discarded. Source and object files are removed as soon as the object is
+ * loaded (the mapping stays valid), so the directory is empty between builds.
+ * Safe to use from several threads as long as names are unique.
+ *
+ * Example:
+ * ```
+ * NativeBuild build;
+ * void* library = build.load(code, "loop12");
+ * auto entry = (int (*)(void))dlsym(library, "ho_tier");
+ * ```
+ */
+class NativeBuild {
+private:
+    string directory;
+
+    /// @brief Runs the C compiler with some arguments, waiting for it to finish
+    static bool runCompiler(vector<string> arguments)
+    {
+        const char* compiler = getenv("CC") ? getenv("CC") : "cc";
+        arguments.insert(arguments.begin(), compiler);
+        vector<char*> argv;
+        for (string& argument : arguments)
+            argv.push_back(argument.data());
+        argv.push_back(nullptr);
+
+        posix_spawn_file_actions_t actions;
+        posix_spawn_file_actions_init(&actions);
+        posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+        posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, "/dev/null", O_WRONLY, 0);
+        pid_t child;
+        int spawned = posix_spawnp(&child, compiler, &actions, nullptr, argv.data(), environ);
+        posix_spawn_file_actions_destroy(&actions);
+        if (spawned != 0)
+            return false;
+        int status;
+        while (waitpid(child, &status, 0) < 0)
+            if (errno != EINTR)
+                return false;
+        return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    }
+
+public:
+    /**
+     * @brief Constructor - creates the build directory under $TMPDIR (or /tmp)
+     *
+     * @throws runtime_error if the directory cannot be created
+     */
+    NativeBuild()
+    {
+        string pattern = string(getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp") + "/hopiler-XXXXXX";
+        if (!mkdtemp(pattern.data()))
+            throw runtime_error("Could not create a directory for native code");
+        directory = pattern;
+    }
+
+    NativeBuild(const NativeBuild&) = delete;
+    NativeBuild& operator=(const NativeBuild&) = delete;
+
+    ~NativeBuild()
+    {
+        rmdir(directory.c_str());
+    }
+
+    /**
+     * @brief Compiles C source into a shared object and loads it
+     *
+     * @param code The C source
+     * @param name File name stem, unique among builds in flight
+     * @return The dlopen handle, or nullptr if the source did not compile or load
+     */
+    void* load(const string& code, const string& name)
+    {
+        string source = directory + "/" + name + ".c", library = directory + "/" + name + ".so";
+        {
+            ofstream file(source);
+            file << code;
+        }
+        void* handle = runCompiler({ "-O2", "-fwrapv", "-shared", "-fPIC", "-w", "-o", library, source, "-lm" })
+            ? dlopen(library.c_str(), RTLD_NOW | RTLD_LOCAL)
+            : nullptr;
+        unlink(source.c_str());
+        unlink(library.c_str());
+        return handle;
+    }
+
+    /**
+     * @brief Compiles C source into an executable in the build directory
+     *
+     * @param code The C source
+     * @param name File name stem, unique among builds in flight
+     * @return The path of the executable, or an empty string if the source did not
+     *         compile; the caller unlinks the file when done with it
+     */
+    string executable(const string& code, const string& name)
+    {
+        string source = directory + "/" + name + ".c", program = directory + "/" + name;
+        {
+            ofstream file(source);
+            file << code;
+        }
+        bool built = runCompiler({ "-O2", "-fwrapv", "-w", "-o", program, source, "-lm" });
+        unlink(source.c_str());
+        return built ? program : "";
+    }
+
+    /**
+     * @brief Runs the C compiler's front end on C source without generating code
+     *
+     * @param code The C source
+     * @param name File name stem, unique among builds in flight
+     * @return true if the source is valid C
+     */
+    bool check(const string& code, const string& name)
+    {
+        string source = directory + "/" + name + ".c";
+        {
+            ofstream file(source);
+            file << code;
+        }
+        bool valid = runCompiler({ "-fsyntax-only", "-w", source });
+        unlink(source.c_str());
+        return valid;
+    }
+};
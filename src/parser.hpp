@@ -7,23 +7,28 @@
  * representation of the program structure.
  * 
  * Current capabilities:
- * - Validates variable declaration and assignment syntax
- * - Type-checks assignments (ensures literal types match declared data types)
- * - Builds AST with proper parent-child relationships
- * - Recognizes statements (delimited by newlines)
- * 
- * Current limitations:
- * - Only supports assignment statements
- * - TODO: Needs extension to handle other expression types, operations, and control structures
+ * - Predictive (LL(1)) statement parsing, dispatched on the leading token through
+ *   the constexpr FIRST-set tables of grammar.hpp
+ * - Declarations, assignments and expression statements
+ * - Block statements: if/elif/else, while, do-while and for
+ * - break, continue and return
+ * - Expressions with operator precedence and associativity from Token
+ * - Type-checks declarations initialized with a literal
  * 
  * This is the second phase of the transpilation pipeline, following tokenization.
  * 
  * @author HoPiler Project
  */
 
+#pragma once
+
+#include "embedded.hpp"
 #include "expNode.hpp"
+#include "grammar.hpp"
+#include "hugepage.hpp"
 #include "tokens.hpp"
 #include <iostream>
+#include <string>
 #include <vector>
 
 using namespace std;
@@ -37,28 +42,45 @@ using namespace std;
  * Syntax Tree (AST) that represents the hierarchical structure of the program.
  * 
  * Parsing Algorithm:
- * - Uses two stacks: operandStack (for identifiers, literals, data types)
- *                    expressionStack (for operators)
- * - When a newline (statement delimiter) is encountered:
- *   - Validates that we have a complete statement
- *   - Pops elements from stacks in correct order
- *   - Validates type compatibility
- *   - Creates an AST node with the operator as parent and operands as children
- *   - Adds the expression to the AST
+ * - Comments, spaces and tabs are dropped in one pass; newlines are kept because
+ *   they terminate statements (like ; in C/C++)
+ * - The first token of every statement is looked up in the constexpr FIRST-set
+ *   tables (predictStatement()), which picks the statement rule to run
+ * - Every rule is recursive descent and consumes each token exactly once, so there
+ *   is no backtracking and nested blocks parse in linear time
+ * - Expressions use precedence climbing driven by Token::getPriority() and
+ *   Token::getAssociativity()
  * 
- * Current statement format supported:
+ * Grammar:
  * ```
- * dataType variableName = literal
+ * statement   := NEWLINE
+ *              | dataType identifier [ "=" expression ] end
+ *              | identifier assignOp expression end
+ *              | expression end
+ *              | block
+ *              | "if" expression block { "elif" expression block } [ "else" block ]
+ *              | "while" expression block
+ *              | "do" block "while" expression end
+ *              | "for" "(" simple ")" "(" expression ")" "(" simple ")" block
+ *              | "break" end | "continue" end | "return" [ expression ] end
+ * block       := "{" { statement } "}"
+ * end         := NEWLINE | end of input | before "}"
  * ```
  * 
+ * AST shapes:
+ * - Root and blocks: expression nodes whose children are the statements
+ * - Declaration: data type keyword with one child, the identifier or the "=" node
+ * - Assignment and binary operators: operator with children [left, right]
+ * - Prefix operators: operator with a single child
+ * - if: [condition, block, elif..., else], elif: [condition, block], else: [block]
+ * - while: [condition, block], do: [block, condition], for: [init, condition, step, block]
+ * - return: optional [value]; break and continue are leaves
+ * 
  * Example: "int x = 5"
- * - "int" is pushed to operandStack (data type keyword)
- * - "x" is pushed to operandStack (identifier)
- * - "=" is pushed to expressionStack (operator)
- * - "5" is pushed to operandStack (literal)
- * - Newline triggers statement processing
+ * - "int" predicts a declaration
+ * - "x", "=" and "5" are consumed by parseDeclaration()
  * - Validation: _int with _intLit - OK
- * - AST: [=] with children [x, 5], added to tree
+ * - AST: [int] with child [=], which has children [x, 5]
  * 
  * @see ExpressionNode
  * @see Tokenizer
@@ -67,6 +89,12 @@ class Parser {
 private:
     vector<Token> tokens;
     ExpressionNode head;
+    bool verbose;
+
+    vector<Token, HugePageAllocator<Token>> stream; // significant tokens: no comments, spaces or tabs
+    vector<_Token, HugePageAllocator<_Token>> info; // stream[i].get(), computed once per token
+    int position = 0;
+    int line = 1;
 
     /**
      * @brief Validates that a keyword-literal pair is type-compatible
@@ -81,7 +109,7 @@ private:
      * - _string -> _stringLit
      * - _char -> _charLit
      * 
-     * This method is used when processing assignment statements to ensure that
+     * This method is used when processing declarations to ensure that
      * variables are initialized with literals of the correct type.
      * 
      * Example: isValidKeywordLiteralPair(_int, _intLit) -> true
@@ -104,102 +132,447 @@ private:
         return false;
     }
 
+    /**
+     * @brief Reports a syntax error at the current line
+     * 
+     * @param message Description of the error
+     * @throws SyntaxError always
+     */
+    [[noreturn]] void syntaxError(string message)
+    {
+        string error = "Line " + to_string(line) + ": " + message;
+        cerr << error << endl;
+        throw SyntaxError(error);
+    }
+
+    /// @brief True once every token has been consumed
+    bool atEnd()
+    {
+        return position >= (int)stream.size();
+    }
+
+    /// @brief True if the current token has the given type and enum value
+    bool check(TokenType type, int token)
+    {
+        return !atEnd() && info[position].tokenType == type && info[position].token == token;
+    }
+
+    /// @brief True if the current token has the given type
+    bool checkType(TokenType type)
+    {
+        return !atEnd() && info[position].tokenType == type;
+    }
+
+    /**
+     * @brief Predicts the kind of the statement starting at the current token
+     * 
+     * At the end of input an empty statement is predicted.
+     */
+    StatementKind predict()
+    {
+        if (atEnd())
+            return _emptyStatement;
+        return predictStatement(info[position].tokenType, info[position].token);
+    }
+
+    /// @brief Consumes the current token and returns it as a tree node
+    ExpressionNode advance()
+    {
+        if (atEnd())
+            syntaxError("Unexpected end of input");
+        if (info[position].tokenType == _whitespace)
+            line++;
+        return ExpressionNode(stream[position++]);
+    }
+
+    /**
+     * @brief Consumes the current token, which must have the given type and enum value
+     * 
+     * @param type Expected token type
+     * @param token Expected enum value within the type
+     * @param what Human-readable name of the expected token for the error message
+     * @return The consumed token as a tree node
+     */
+    ExpressionNode expect(TokenType type, int token, string what)
+    {
+        if (!check(type, token))
+            syntaxError("Expected " + what);
+        return advance();
+    }
+
+    /// @brief Consumes any number of newlines
+    void skipNewLines()
+    {
+        while (check(_whitespace, _newLine))
+            advance();
+    }
+
+    /**
+     * @brief Consumes the end of a simple statement
+     * 
+     * A statement ends at a newline, at the end of input, or right before the "}"
+     * closing its block (which is left for parseBlock()).
+     */
+    void expectEnd()
+    {
+        if (atEnd() || check(_delimiter, _braceClose))
+            return;
+        expect(_whitespace, _newLine, "end of line");
+    }
+
+    /**
+     * @brief Parses a primary expression: literal, identifier or parenthesized expression
+     */
+    ExpressionNode parsePrimary()
+    {
+        if (checkType(_literal) || checkType(_identifier))
+            return advance();
+        if (check(_delimiter, _bracketOpen)) {
+            advance();
+            ExpressionNode inner = parseExpression();
+            expect(_delimiter, _bracketClose, "')'");
+            return inner;
+        }
+        syntaxError("Expected an expression");
+    }
+
+    /**
+     * @brief Parses a prefix operator (not, !, unary -) or a primary expression
+     * 
+     * The operand of a prefix operator binds with the priority of not (70), so
+     * "-a * b" is (-a) * b while "-a ** b" is -(a ** b).
+     */
+    ExpressionNode parseUnary()
+    {
+        if (checkType(_operator) && operatorStartsExpression[info[position].token]) {
+            ExpressionNode op = advance();
+            op.addChild(parseExpression(Token(OperatorType { _not }).getPriority()));
+            return op;
+        }
+        return parsePrimary();
+    }
+
+    /**
+     * @brief Precedence climbing over binary operators
+     * 
+     * @param left The already parsed left operand
+     * @param minPriority Operators with a lower priority end this expression
+     * @return The expression tree
+     * 
+     * Assignment operators are never part of an expression; they are handled at
+     * statement level, so climbing stops at them.
+     */
+    ExpressionNode parseBinary(ExpressionNode left, int minPriority)
+    {
+        while (checkType(_operator)) {
+            int op = info[position].token;
+            if (isAssignmentOperator[op] || op == _not)
+                break;
+
+            Token opToken = stream[position];
+            int priority = opToken.getPriority();
+            if (priority < minPriority)
+                break;
+
+            ExpressionNode node = advance();
+            int nextPriority = opToken.getAssociativity() == Token::LeftAssoc ? priority + 1 : priority;
+            ExpressionNode right = parseExpression(nextPriority);
+            node.addChild(std::move(left));
+            node.addChild(std::move(right));
+            left = std::move(node);
+        }
+        return left;
+    }
+
+    /**
+     * @brief Parses an expression whose operators have at least the given priority
+     * 
+     * @param minPriority Lowest operator priority to accept (defaults to everything
+     *                    above assignment)
+     */
+    ExpressionNode parseExpression(int minPriority = 11)
+    {
+        return parseBinary(parseUnary(), minPriority);
+    }
+
+    /**
+     * @brief Parses "dataType identifier [= expression]" without the statement end
+     * 
+     * Declarations initialized with a single literal are type-checked with
+     * isValidKeywordLiteralPair().
+     */
+    ExpressionNode parseDeclaration()
+    {
+        ExpressionNode dataType = advance();
+        if (!checkType(_identifier))
+            syntaxError("Expected a variable name after the data type");
+        ExpressionNode varName = advance();
+
+        if (!check(_operator, _ass)) {
+            dataType.addChild(std::move(varName));
+            return dataType;
+        }
+
+        ExpressionNode op = advance();
+        ExpressionNode value = parseExpression();
+        if (value.getTokenType() == _literal && !isValidKeywordLiteralPair(dataType.getToken(), value.getToken())) {
+            cerr << "Invalid assignment on type " << dataType.getToken() << " with " << value.getToken() << endl;
+            dataType.print();
+            value.print();
+            varName.print();
+            cerr << endl;
+            throw SyntaxError("Invalid assignment");
+        }
+
+        op.addChild(std::move(varName));
+        op.addChild(std::move(value));
+        dataType.addChild(std::move(op));
+        return dataType;
+    }
+
+    /**
+     * @brief Parses a statement starting with an identifier, without the statement end
+     * 
+     * The token after the identifier decides between an assignment and an
+     * expression statement; in the latter case the identifier becomes the left
+     * operand, so nothing is re-read.
+     */
+    ExpressionNode parseAssignment()
+    {
+        ExpressionNode target = advance();
+        if (!(checkType(_operator) && isAssignmentOperator[info[position].token]))
+            return parseBinary(target, 11);
 
+        ExpressionNode op = advance();
+        op.addChild(std::move(target));
+        op.addChild(parseExpression());
+        return op;
+    }
+
+    /**
+     * @brief Parses a declaration or assignment, as used by the clauses of a for loop
+     */
+    ExpressionNode parseSimpleStatement()
+    {
+        StatementKind kind = predict();
+        if (kind == _declarationStatement)
+            return parseDeclaration();
+        if (kind == _assignmentStatement)
+            return parseAssignment();
+        syntaxError("Expected a declaration or an assignment");
+    }
+
+    /**
+     * @brief Parses "{ statements }" into an expression node holding the statements
+     */
+    ExpressionNode parseBlock()
+    {
+        expect(_delimiter, _braceOpen, "'{'");
+        ExpressionNode block { Token() };
+        while (!check(_delimiter, _braceClose)) {
+            if (atEnd())
+                syntaxError("Expected '}'");
+            parseStatement(block);
+        }
+        advance();
+        return block;
+    }
+
+    /**
+     * @brief Parses an if statement with its elif and else branches
+     * 
+     * Newlines between "}" and a following elif/else are allowed. Consuming them
+     * early is harmless since a lone newline is an empty statement anyway.
+     */
+    ExpressionNode parseIf()
+    {
+        ExpressionNode ifNode = advance();
+        ifNode.addChild(parseExpression());
+        ifNode.addChild(parseBlock());
+
+        while (true) {
+            skipNewLines();
+            if (check(_keyWord, _elif)) {
+                ExpressionNode elifNode = advance();
+                elifNode.addChild(parseExpression());
+                elifNode.addChild(parseBlock());
+                ifNode.addChild(std::move(elifNode));
+            } else if (check(_keyWord, _else)) {
+                ExpressionNode elseNode = advance();
+                elseNode.addChild(parseBlock());
+                ifNode.addChild(std::move(elseNode));
+                return ifNode;
+            } else {
+                return ifNode;
+            }
+        }
+    }
+
+    /**
+     * @brief Parses "for ( init ) ( condition ) ( step ) block"
+     */
+    ExpressionNode parseFor()
+    {
+        ExpressionNode forNode = advance();
+        expect(_delimiter, _bracketOpen, "'(' before the for initializer");
+        forNode.addChild(parseSimpleStatement());
+        expect(_delimiter, _bracketClose, "')' after the for initializer");
+        expect(_delimiter, _bracketOpen, "'(' before the for condition");
+        forNode.addChild(parseExpression());
+        expect(_delimiter, _bracketClose, "')' after the for condition");
+        expect(_delimiter, _bracketOpen, "'(' before the for step");
+        forNode.addChild(parseSimpleStatement());
+        expect(_delimiter, _bracketClose, "')' after the for step");
+        forNode.addChild(parseBlock());
+        return forNode;
+    }
+
+    /**
+     * @brief Parses one statement and appends it to parent
+     * 
+     * @param parent The root or block node receiving the statement
+     * 
+     * The statement rule is chosen by predict() from the current token alone.
+     * Empty statements (lone newlines) add nothing to the tree.
+     */
+    void parseStatement(ExpressionNode& parent)
+    {
+        switch (predict()) {
+        case _emptyStatement:
+            advance();
+            return;
+        case _declarationStatement:
+            parent.addChild(parseDeclaration());
+            expectEnd();
+            return;
+        case _assignmentStatement:
+            parent.addChild(parseAssignment());
+            expectEnd();
+            return;
+        case _expressionStatement:
+            parent.addChild(parseExpression());
+            expectEnd();
+            return;
+        case _blockStatement:
+            parent.addChild(parseBlock());
+            return;
+        case _ifStatement:
+            parent.addChild(parseIf());
+            return;
+        case _whileStatement: {
+            ExpressionNode whileNode = advance();
+            whileNode.addChild(parseExpression());
+            whileNode.addChild(parseBlock());
+            parent.addChild(std::move(whileNode));
+            return;
+        }
+        case _doStatement: {
+            ExpressionNode doNode = advance();
+            doNode.addChild(parseBlock());
+            skipNewLines();
+            expect(_keyWord, _while, "while after the do block");
+            doNode.addChild(parseExpression());
+            parent.addChild(std::move(doNode));
+            expectEnd();
+            return;
+        }
+        case _forStatement:
+            parent.addChild(parseFor());
+            return;
+        case _breakStatement:
+        case _continueStatement:
+            parent.addChild(advance());
+            expectEnd();
+            return;
+        case _returnStatement: {
+            ExpressionNode returnNode = advance();
+            if (!(atEnd() || check(_whitespace, _newLine) || check(_delimiter, _braceClose)))
+                returnNode.addChild(parseExpression());
+            parent.addChild(std::move(returnNode));
+            expectEnd();
+            return;
+        }
+        case _invalidStatement:
+            break;
+        }
+        if (check(_keyWord, _elif) || check(_keyWord, _else))
+            syntaxError("elif/else without a matching if");
+        syntaxError("Unexpected token at the start of a statement");
+    }
 
     /**
      * @brief Main parsing loop - converts token stream to AST
      * 
-     * This method implements the core parsing algorithm using a two-stack approach:
-     * 
-     * Stack organization:
-     * - operandStack: Stores data type keywords, identifiers, and literals
-     * - expressionStack: Stores operators (particularly assignment operators)
-     * 
-     * Token processing rules:
-     * - Skip comments and whitespace (spaces/tabs)
-     * - Print each non-whitespace token for debugging
-     * - Push identifiers, literals, and data type keywords to operandStack
-     * - Push assignment operators to expressionStack
-     * - Process complete statements when newline is encountered
-     * 
-     * Statement processing (triggered on newline):
-     * - Checks if stacks contain a complete statement:
-     *   - operandStack must have >= 3 elements
-     *   - expressionStack must have >= 1 element
-     *   - Last expression must be an assignment operator
-     * - Pops elements in order:
-     *   1. literal (rightmost operand)
-     *   2. variableName (identifier)
-     *   3. dataType (keyword)
-     *   4. operator (assignment)
-     * - Validates type compatibility via isValidKeywordLiteralPair()
-     * - Creates AST node: operator with children [variableName, literal]
-     * - Adds expression to root node's children
-     * - Clears both stacks for next statement
+     * 1. Drops comments, spaces and tabs, and caches Token::get() for the rest
+     *    (printing each remaining token in verbose mode); every kept token is
+     *    tagged with its source line, which later phases report against
+     * 2. Parses statements until the input is exhausted, appending them to head
      * 
      * Error handling:
-     * - Throws invalid_argument if type validation fails
-     * - Prints diagnostic information on type mismatch
-     * 
-     * TODO: Currently only handles assignment expressions.
-     *       Needs extension for other operators, expressions, and control structures.
+     * - Throws invalid_argument on syntax errors, with the line number
+     * - Throws invalid_argument if a declaration's literal does not match its type
      */
     void parseTree()
     {
-        vector<ExpressionNode> operandStack;
-        vector<ExpressionNode> expressionStack;
-
+        int tokenLine = line;
+        stream.reserve(tokens.size()); // one block each, instead of regrowing inside an arena
+        info.reserve(tokens.size());
         for (Token token : tokens) {
             _Token t = token.get();
 
             if (t.tokenType == _comment || (t.tokenType == _whitespace && (t.token == _space || t.token == _tab)))
                 continue;
 
-            ExpressionNode node(token);
-            node.print();
-
-            // TODO: create a postfix to infix style conversion of expression instead of the current hardcoded assignment only.
-            if (t.tokenType == _whitespace) {
-                // handling a new line, newline acts as a delimiter like ; in c/c++
-                if (operandStack.size() >= 3 && expressionStack.size() >= 1 && expressionStack.at(expressionStack.size()-1).getTokenType() == _operator && expressionStack.at(expressionStack.size()-1).getToken() == _ass) {
-                    ExpressionNode op = expressionStack.at(expressionStack.size() - 1);
-                    expressionStack.pop_back();
-
-                    ExpressionNode literal = operandStack.at(operandStack.size() - 1);
-                    operandStack.pop_back();
-
-                    ExpressionNode varName = operandStack.at(operandStack.size() - 1);
-                    operandStack.pop_back();
-
-                    ExpressionNode dataType = operandStack.at(operandStack.size() - 1);
-                    operandStack.pop_back();
-
-                    if (!isValidKeywordLiteralPair(dataType.getToken(), literal.getToken())) {
-                        cerr << "Invalid assignment on type " << dataType.getToken() << " with " << literal.getToken() << endl;
-                        dataType.print();
-                        literal.print();
-                        varName.print();
-                        cerr << endl;
-                        throw invalid_argument("Invalid assignment");
-                    }
-
-                    op.addChild(varName);
-                    op.addChild(literal);
-
-                    head.addChild(op);
-                    expressionStack.clear();
-                    operandStack.clear();
-                }
-            } else if (t.tokenType == _literal || t.tokenType == _identifier || (t.tokenType == _keyWord && (t.token >= _int && t.token <= _bool))) {
-                // handling datatype declarations, identifiers and literals.
-                operandStack.push_back(node);
-            } else if (t.tokenType == _operator) {
-                if(t.token == _ass || t.token == _assAdd || t.token == _assDiv || t.token == _assMod || t.token == _assMul || t.token == _assPow || t.token == _assSub){
-                    expressionStack.push_back(node);
-                    // for assignment operators 
-                }
+            token.setLine(tokenLine);
+            if (t.tokenType == _whitespace)
+                tokenLine++;
+
+            if (verbose)
+                ExpressionNode(token).print();
+            stream.push_back(token);
+            info.push_back(t);
+        }
+
+        while (!atEnd())
+            parseStatement(head);
+    }
+
+    /// @brief Builds the ExpressionNode of an embedded node and its subtree, see treeOf()
+    template <size_t MaxNodes, size_t MaxText, size_t MaxVariables>
+    static ExpressionNode embeddedNode(const EmbeddedProgram<MaxNodes, MaxText, MaxVariables>& program, int index)
+    {
+        const auto& node = program.getNode(index);
+        string text(program.getText(node));
+        Token token;
+        switch (node.type) {
+        case _keyWord:
+            token = Token(KeyWordType(node.token));
+            break;
+        case _literal: {
+            token = Token(LiteralType(node.token), text);
+            if (node.token == _stringLit || node.token == _charLit) {
+                bool escaped = false;
+                for (char c : text)
+                    escaped = escaped || Token::needsCEscape(c, node.token == _stringLit ? '"' : '\'');
+                token.setEscaped(escaped);
             }
+            break;
+        }
+        case _operator:
+            token = Token(OperatorType(node.token));
+            break;
+        case _identifier:
+            token = Token::identifier(text);
+            break;
+        default:
+            break; // root and blocks
         }
+        token.setLine(node.line);
+
+        ExpressionNode tree(token);
+        for (int child = node.firstChild; child >= 0; child = program.getNode(child).nextSibling)
+            tree.addChild(embeddedNode(program, child));
+        return tree;
     }
 
     /**
@@ -216,10 +589,10 @@ private:
      * 
      * @see ExpressionNode::print()
      */
-    void _printTree(ExpressionNode node)
+    void _printTree(ExpressionNode& node)
     {
-        for (ExpressionNode n : node.getChildren()) {
-            _printTree(n);
+        for (ExpressionNode* child = node.getFirstChild(); child; child = child->getNextSibling()) {
+            _printTree(*child);
         }
         node.print();
     }
@@ -229,6 +602,9 @@ public:
      * @brief Constructor - initializes parser and builds AST from tokens
      * 
      * @param tokens Vector of Token objects from the Tokenizer
+     * @param verbose If false, nothing is printed while parsing
+     * @param firstLine Source line of the first token, for tokens that do not start
+     *                  at the top of their file
      * 
      * Upon construction:
      * 1. Stores the token vector
@@ -245,15 +621,43 @@ public:
      * 
      * Example: Parser parser(tokenizer.getTokens());
      */
-    Parser(vector<Token> tokens)
+    Parser(vector<Token> tokens, bool verbose = true, int firstLine = 1)
         : tokens(tokens)
         , head(Token())
+        , verbose(verbose)
+        , line(firstLine)
     {
-        cout << "Received " << tokens.size() << " tokens." << endl;
-        cout << "\n\n=====\nParsing tree\n=====\n";
+        if (verbose) {
+            cout << "Received " << tokens.size() << " tokens." << endl;
+            cout << "\n\n=====\nParsing tree\n=====\n";
+        }
         parseTree();
-        cout << "Tree parsed" << endl;
-        printTree();
+        if (verbose) {
+            cout << "Tree parsed" << endl;
+            printTree();
+        }
+    }
+
+    /**
+     * @brief Builds the tree of a program parsed at compile time
+     * 
+     * @param program An EmbeddedProgram that parsed (ok())
+     * @return The same tree Parser would have built from the program's source
+     * 
+     * Only nodes are allocated; nothing is lexed or parsed at run time. String and char
+     * literals get their escape flag here, as the Tokenizer would have set it.
+     * 
+     * Example:
+     * ```
+     * constexpr auto program = embedHoLang("int x = 6 * 7\nreturn x\n");
+     * ExpressionNode tree = Parser::treeOf(program);
+     * Interpreter().run(tree);
+     * ```
+     */
+    template <size_t MaxNodes, size_t MaxText, size_t MaxVariables>
+    static ExpressionNode treeOf(const EmbeddedProgram<MaxNodes, MaxText, MaxVariables>& program)
+    {
+        return embeddedNode(program, 0);
     }
 
     /**
@@ -283,6 +687,7 @@ public:
      * Identifier: x
      * Literal: 5
      * Operator type: [assignment enum value]
+     * Keyword type: [int enum value]
      * 
      * 
      * ```
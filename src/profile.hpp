@@ -0,0 +1,126 @@
+/**
+ * @file profile.hpp
+ * @brief Branch profiles recorded by programs built with --profile
+ *
+ * A program transpiled with --profile counts, for every conditional it evaluates,
+ * how often the condition was true and how often it was false, and writes the
+ * counts to <source>.prof when it exits. BranchProfile reads such a file back so
+ * the next transpilation can lay the generated C out for the measured behaviour.
+ *
+ * File format (one line per branch site, sites numbered in source order):
+ * ```
+ * # HoPiler branch profile v1
+ * branch <site> <line> <true count> <false count>
+ * ```
+ *
+ * @author HoPiler Project
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/**
+ * @class BranchProfile
+ * @brief Per-site true/false counts of a previous run
+ *
+ * Sites are matched by number and source line; a site whose line no longer
+ * matches (the source changed since the profile was taken) is treated as
+ * having no data, so a stale profile degrades to no hints instead of wrong ones.
+ *
+ * Example:
+ * ```
+ * BranchProfile profile("program.ho.prof");
+ * if (profile.has(3, 12) && profile.getFalseCount(3) == 0) { ... }
+ * ```
+ */
+class BranchProfile {
+private:
+    /**
+     * @struct Site
+     * @brief Counts recorded for one branch site
+     */
+    struct Site {
+        int line = 0;
+        uint64_t trueCount = 0;
+        uint64_t falseCount = 0;
+        bool present = false;
+    };
+
+    vector<Site> sites;
+
+public:
+    /// @brief Constructor - an empty profile, which gives no hints
+    BranchProfile() { }
+
+    /**
+     * @brief Constructor - reads a profile written by an instrumented program
+     *
+     * @param fileName Path of the .prof file
+     * @throws invalid_argument if the file cannot be opened or is malformed
+     */
+    BranchProfile(string fileName)
+    {
+        ifstream fileStream(fileName);
+        if (!fileStream.is_open()) {
+            cerr << "Could not open profile " << fileName << endl;
+            throw invalid_argument("Could not open profile " + fileName);
+        }
+
+        string text;
+        int lineNumber = 0;
+        while (getline(fileStream, text)) {
+            lineNumber++;
+            if (text.empty() || text[0] == '#')
+                continue;
+
+            istringstream fields(text);
+            string kind;
+            int site;
+            Site counts;
+            if (!(fields >> kind >> site >> counts.line >> counts.trueCount >> counts.falseCount) || kind != "branch" || site < 0)
+                throw invalid_argument(fileName + ":" + to_string(lineNumber) + ": malformed profile entry");
+
+            counts.present = true;
+            if (site >= (int)sites.size())
+                sites.resize(site + 1);
+            sites[site] = counts;
+        }
+    }
+
+    /**
+     * @brief Checks whether the profile has data for a site at the given line
+     *
+     * @param site Branch site number, in source order
+     * @param line Source line the site is at now
+     */
+    bool has(int site, int line) const
+    {
+        return site >= 0 && site < (int)sites.size() && sites[site].present && sites[site].line == line;
+    }
+
+    /// @brief Gets how often the site's condition was true
+    uint64_t getTrueCount(int site) const
+    {
+        return sites.at(site).trueCount;
+    }
+
+    /// @brief Gets how often the site's condition was false
+    uint64_t getFalseCount(int site) const
+    {
+        return sites.at(site).falseCount;
+    }
+
+    /// @brief Checks whether the profile contains any site at all
+    bool empty() const
+    {
+        return sites.empty();
+    }
+};
@@ -0,0 +1,112 @@
+/**
+ * @file region.hpp
+ * @brief Bump-allocated memory regions for the interpreter
+ *
+ * A Region hands out memory by bumping a pointer through 64 KiB chunks and gives
+ * all of it back at once: reset() to a mark, or clear(), is O(1) no matter how many
+ * allocations were made. Chunks are kept for reuse, so a region that is reset every
+ * statement or every loop iteration stops calling the system allocator after warm-up.
+ *
+ * @author HoPiler Project
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <new>
+#include <vector>
+
+using namespace std;
+
+/**
+ * @class Region
+ * @brief Stack-like arena whose allocations are freed in bulk
+ *
+ * Nothing is destructed on reset, so only trivially destructible objects may live
+ * in a region. Marks nest: resetting to a mark frees everything allocated after it
+ * and nothing before it.
+ *
+ * Example:
+ * ```
+ * Region region;
+ * Region::Mark start = region.mark();
+ * char* text = (char*)region.allocate(length);
+ * region.reset(start); // text is gone
+ * ```
+ */
+class Region {
+private:
+    static constexpr size_t chunkSize = 64 * 1024;
+    static constexpr size_t alignment = 16;
+
+    struct Chunk {
+        char* memory;
+        size_t size;
+    };
+
+    vector<Chunk> chunks;
+    size_t current = 0; // chunk being filled
+    size_t used = 0; // bytes used in that chunk
+
+public:
+    /// @brief A position in the region to reset() back to
+    struct Mark {
+        size_t chunk;
+        size_t used;
+    };
+
+    /// @brief Constructor - an empty region; the first chunk is allocated on demand
+    Region() { }
+
+    Region(const Region&) = delete;
+    Region& operator=(const Region&) = delete;
+
+    ~Region()
+    {
+        for (Chunk& chunk : chunks)
+            ::operator delete(chunk.memory);
+    }
+
+    /**
+     * @brief Allocates memory that lives until the region is reset past it
+     *
+     * @param size Number of bytes; requests bigger than a chunk get a chunk of their own
+     * @return Memory aligned to 16 bytes
+     */
+    void* allocate(size_t size)
+    {
+        size = (size + alignment - 1) & ~(alignment - 1);
+        while (current < chunks.size() && used + size > chunks[current].size) {
+            current++;
+            used = 0;
+        }
+        if (current == chunks.size()) {
+            size_t chunk = max(size, chunkSize);
+            chunks.push_back({ (char*)::operator new(chunk), chunk });
+        }
+        void* memory = chunks[current].memory + used;
+        used += size;
+        return memory;
+    }
+
+    /// @brief Gets the current position
+    Mark mark() const
+    {
+        return { current, used };
+    }
+
+    /// @brief Frees everything allocated since the mark was taken
+    void reset(Mark mark)
+    {
+        current = mark.chunk;
+        used = mark.used;
+    }
+
+    /// @brief Frees everything in the region
+    void clear()
+    {
+        current = 0;
+        used = 0;
+    }
+};
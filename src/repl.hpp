@@ -0,0 +1,128 @@
+/**
+ * @file repl.hpp
+ * @brief Interactive HoLang session (--repl)
+ *
+ * The Repl class reads HoLang one line at a time, and tokenizes, parses and runs
+ * only what was just typed against an Interpreter that lives for the whole session.
+ *
+ * @author HoPiler Project
+ */
+
+#pragma once
+
+#include "interpreter.hpp"
+#include "parser.hpp"
+#include "tokenizer.hpp"
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/**
+ * @class Repl
+ * @brief Read-eval-print loop over a persistent Interpreter
+ *
+ * Algorithm, for every line read:
+ * 1. The line alone is tokenized and its tokens are appended to the pending chunk
+ * 2. While the chunk has more { than }, the next line continues it (prompt "... ")
+ * 3. Otherwise the chunk is parsed and its statements are run; the value of an
+ *    expression statement is printed
+ *
+ * Nothing typed earlier is lexed or parsed again, and variables are looked up in
+ * hash maps, so the time per line does not grow with the length of the session.
+ * An error discards the chunk but keeps every variable declared so far. A top-level
+ * return ends the session with its value as the exit status.
+ *
+ * Example session:
+ * ```
+ * >>> int x = 6
+ * >>> x * 7
+ * 42
+ * >>> while ( x > 0 ) {
+ * ...     x -= 4
+ * ... }
+ * >>> x
+ * -2
+ * ```
+ *
+ * @see Interpreter
+ */
+class Repl {
+private:
+    Interpreter interpreter;
+    vector<Token> pending; // tokens of the chunk being typed
+    int openBraces = 0;
+
+    /// @brief Checks whether a statement is an expression whose value should be shown
+    static bool isExpression(ExpressionNode* node)
+    {
+        TokenType type = node->getTokenType();
+        return type == _literal || type == _identifier || (type == _operator && node->getToken() < _ass);
+    }
+
+    /**
+     * @brief Parses and runs the pending chunk
+     *
+     * @return true if the chunk executed a top-level return
+     */
+    bool runChunk(ostream& output)
+    {
+        Parser parser(pending, false);
+        ExpressionNode tree = parser.getTree();
+        interpreter.analyseLifetimes(tree);
+        for (ExpressionNode* statement = tree.getFirstChild(); statement; statement = statement->getNextSibling()) {
+            if (isExpression(statement)) {
+                output << interpreter.evaluateStatement(statement).toString() << endl;
+                continue;
+            }
+            Flow flow = interpreter.execute(statement);
+            if (flow == _returnFlow)
+                return true;
+            if (flow != _normalFlow)
+                throw runtime_error("break or continue outside of a loop");
+        }
+        return false;
+    }
+
+public:
+    /**
+     * @brief Runs the session until end of input or a top-level return
+     *
+     * @param input Where lines are read from
+     * @param output Where prompts, values and errors are written
+     * @return The exit status (the value of the top-level return, or 0)
+     */
+    int run(istream& input, ostream& output)
+    {
+        string line;
+        while (output << (openBraces > 0 ? "... " : ">>> ") << flush, getline(input, line)) {
+            try {
+                Tokenizer tokenizer = Tokenizer::fromSource("<repl>", line + "\n", false);
+                for (Token& token : tokenizer.getTokens()) {
+                    _Token t = token.get();
+                    if (t.tokenType == _delimiter && t.token == _braceOpen)
+                        openBraces++;
+                    if (t.tokenType == _delimiter && t.token == _braceClose)
+                        openBraces--;
+                    pending.push_back(token);
+                }
+                if (openBraces > 0)
+                    continue;
+
+                bool returned = runChunk(output);
+                pending.clear();
+                openBraces = 0;
+                if (returned)
+                    return interpreter.getExitStatus();
+            } catch (const std::exception& e) {
+                output << "Error: " << e.what() << endl;
+                pending.clear();
+                openBraces = 0;
+                interpreter.recover();
+            }
+        }
+        output << endl;
+        return interpreter.getExitStatus();
+    }
+};
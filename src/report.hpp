@@ -0,0 +1,281 @@
+/**
+ * @file report.hpp
+ * @brief Size and compile-cost report of the generated C (--codegen-report)
+ *
+ * The CodeGenerator tells a CodegenReport which HoLang statement every line of C
+ * it emits belongs to. The report adds up, per source line and construct kind,
+ * the bytes of C, the C statements and the heap string temporaries, and flags the
+ * source lines that go over a budget. Optionally it also times `cc -fsyntax-only`
+ * on shards of the program (groups of top-level statements), which shows where
+ * the C compiler spends its time.
+ *
+ * Report format (<source>.codegen):
+ * ```
+ * # HoPiler codegen report for loop.ho
+ * # 4817 bytes of C: 4420 runtime, 397 program; 7 statements, 0 temporaries
+ * # budget per line: 1024 bytes, 24 statements, 4 temporaries
+ * line  kind          bytes  statements  temporaries
+ *    2  for             212           3            0
+ *   12  assignment     1810          31            9  over: bytes statements temporaries
+ * ```
+ * followed by the totals per construct kind and, when timed, the shard times.
+ *
+ * @author HoPiler Project
+ */
+
+#pragma once
+
+#include "native.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/**
+ * @struct CodegenBudget
+ * @brief What one source line may cost before the report flags it
+ */
+struct CodegenBudget {
+    long long bytes = 1024;
+    long long statements = 24;
+    long long temporaries = 4;
+
+    /**
+     * @brief Reads a budget like "bytes=2048,statements=40"; missing keys keep their defaults
+     *
+     * @throws invalid_argument on unknown keys or bad numbers
+     */
+    static CodegenBudget parse(const string& text)
+    {
+        CodegenBudget budget;
+        size_t start = 0;
+        while (start < text.size()) {
+            size_t end = text.find(',', start);
+            if (end == string::npos)
+                end = text.size();
+            string item = text.substr(start, end - start);
+            size_t equals = item.find('=');
+            string key = item.substr(0, equals);
+            long long* field = key == "bytes" ? &budget.bytes : key == "statements" ? &budget.statements : key == "temporaries" ? &budget.temporaries : nullptr;
+            if (!field || equals == string::npos)
+                throw invalid_argument("Unknown codegen budget " + item + " (use bytes=, statements= and temporaries=)");
+            try {
+                *field = stoll(item.substr(equals + 1));
+            } catch (const std::exception&) {
+                throw invalid_argument("Bad number in codegen budget " + item);
+            }
+            start = end + 1;
+        }
+        return budget;
+    }
+};
+
+/**
+ * @class CodegenReport
+ * @brief Emitted C attributed to the HoLang lines and constructs it came from
+ *
+ * Nested statements are attributed to the innermost one: the `for (...) {` line
+ * belongs to the for, the assignment in its body to the assignment. The budget
+ * applies to everything a source line produced.
+ *
+ * Example:
+ * ```
+ * CodegenReport report;
+ * options.report = &report;
+ * CodeGenerator generator(tree, options);
+ * generator.write("program.ho"); // also tells the report the size of the runtime
+ * report.write("program.ho.codegen", "program.ho", CodegenBudget());
+ * ```
+ */
+class CodegenReport {
+private:
+    /**
+     * @struct Cost
+     * @brief What some HoLang code turned into
+     */
+    struct Cost {
+        long long bytes = 0;
+        long long statements = 0;
+        long long temporaries = 0;
+
+        void add(const Cost& other)
+        {
+            bytes += other.bytes;
+            statements += other.statements;
+            temporaries += other.temporaries;
+        }
+    };
+
+    /**
+     * @struct Shard
+     * @brief Front end time of a group of top-level statements
+     */
+    struct Shard {
+        int firstLine;
+        int lastLine;
+        double seconds; // the whole shard, runtime included
+    };
+
+    map<pair<int, string>, Cost> costs; // by source line and construct kind
+    vector<pair<int, string>> open; // the statements being emitted, innermost last
+    Cost unattributed; // C emitted outside any statement
+    long long runtimeBytes = 0;
+    vector<Shard> shards;
+    double preludeSeconds = 0;
+
+    Cost& current()
+    {
+        return open.empty() ? unattributed : costs[open.back()];
+    }
+
+    /// @brief Times the C compiler's front end on one program
+    static double timeFrontEnd(NativeBuild& build, const string& code, const string& name)
+    {
+        auto start = chrono::steady_clock::now();
+        if (!build.check(code, name))
+            throw runtime_error("The C compiler rejected shard " + name);
+        return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    }
+
+public:
+    /// @brief Records that the code generator started on a statement
+    void enter(int line, string kind)
+    {
+        open.emplace_back(line, kind);
+        costs[open.back()]; // listed even if it emits nothing
+    }
+
+    /// @brief Records that the code generator finished the innermost statement
+    void leave()
+    {
+        open.pop_back();
+    }
+
+    /**
+     * @brief Attributes C text to the innermost open statement
+     *
+     * @param bytes Length of the text, including its indentation and newline
+     * @param statement Whether the text is a C statement (not just a brace)
+     */
+    void addCode(size_t bytes, bool statement)
+    {
+        current().bytes += bytes;
+        current().statements += statement;
+    }
+
+    /// @brief Attributes a heap string temporary to the innermost open statement
+    void addTemporary()
+    {
+        current().temporaries++;
+    }
+
+    /// @brief Sets the size of the part of the program no statement produced (runtime, main() frame)
+    void setRuntimeBytes(long long bytes)
+    {
+        runtimeBytes = bytes;
+    }
+
+    /// @brief Gets the bytes attributed to statements so far
+    long long getProgramBytes()
+    {
+        Cost total = unattributed;
+        for (auto& [key, cost] : costs)
+            total.add(cost);
+        return total.bytes;
+    }
+
+    /**
+     * @brief Times `$CC -fsyntax-only` on every shard of a program
+     *
+     * @param prelude The program without statements, see CodeGenerator::getSkeleton()
+     * @param shardCode First source line and complete C source of every shard
+     * @throws runtime_error if the compiler rejects a shard
+     */
+    void timeShards(const string& prelude, const vector<pair<int, string>>& shardCode)
+    {
+        NativeBuild build;
+        preludeSeconds = timeFrontEnd(build, prelude, "prelude");
+        shards.clear();
+        for (size_t i = 0; i < shardCode.size(); i++) {
+            int lastLine = i + 1 < shardCode.size() ? shardCode[i + 1].first - 1 : -1;
+            double seconds = timeFrontEnd(build, shardCode[i].second, "shard" + to_string(i));
+            shards.push_back({ shardCode[i].first, lastLine, seconds });
+        }
+    }
+
+    /**
+     * @brief Writes the report
+     *
+     * @param fileName Where to write
+     * @param sourceName The source file, for the header
+     * @param budget Per-line limits; lines over any of them are flagged
+     * @return The number of source lines over budget
+     * @throws runtime_error if the file cannot be written
+     */
+    int write(string fileName, string sourceName, const CodegenBudget& budget)
+    {
+        map<int, Cost> lines;
+        map<string, pair<Cost, int>> kinds; // cost and number of statements
+        Cost total = unattributed;
+        for (auto& [key, cost] : costs) {
+            lines[key.first].add(cost);
+            kinds[key.second].first.add(cost);
+            kinds[key.second].second++;
+            total.add(cost);
+        }
+
+        ofstream file(fileName);
+        if (!file.is_open())
+            throw runtime_error("Could not write codegen report " + fileName);
+        char row[160];
+        file << "# HoPiler codegen report for " << sourceName << "\n"
+             << "# " << runtimeBytes + total.bytes << " bytes of C: " << runtimeBytes << " runtime, " << total.bytes << " program; "
+             << total.statements << " statements, " << total.temporaries << " temporaries\n"
+             << "# budget per line: " << budget.bytes << " bytes, " << budget.statements << " statements, " << budget.temporaries << " temporaries\n";
+
+        int overBudget = 0;
+        file << "line  kind          bytes  statements  temporaries\n";
+        for (auto& [key, cost] : costs) {
+            Cost& line = lines[key.first];
+            string over;
+            if (line.bytes > budget.bytes)
+                over += " bytes";
+            if (line.statements > budget.statements)
+                over += " statements";
+            if (line.temporaries > budget.temporaries)
+                over += " temporaries";
+            bool lastOfLine = next(costs.find(key)) == costs.end() || next(costs.find(key))->first.first != key.first;
+            overBudget += !over.empty() && lastOfLine;
+            snprintf(row, sizeof(row), "%4d  %-12s %6lld  %10lld  %11lld", key.first, key.second.c_str(), cost.bytes, cost.statements, cost.temporaries);
+            file << row << (!over.empty() && lastOfLine ? "  over:" + over : "") << "\n";
+        }
+
+        vector<pair<string, pair<Cost, int>>> byBytes(kinds.begin(), kinds.end());
+        sort(byBytes.begin(), byBytes.end(), [](auto& a, auto& b) { return a.second.first.bytes > b.second.first.bytes; });
+        file << "\n# by construct, most bytes first\n"
+             << "kind          count   bytes  statements  temporaries  bytes/count\n";
+        for (auto& [kind, entry] : byBytes) {
+            auto& [cost, count] = entry;
+            snprintf(row, sizeof(row), "%-12s %6d %7lld  %10lld  %11lld  %11lld", kind.c_str(), count, cost.bytes, cost.statements, cost.temporaries, cost.bytes / count);
+            file << row << "\n";
+        }
+
+        if (!shards.empty()) {
+            snprintf(row, sizeof(row), "%.4f", preludeSeconds);
+            file << "\n# cc -fsyntax-only per shard in seconds; the runtime and globals alone take " << row << "\n"
+                 << "lines                  total  statements\n";
+            for (Shard& shard : shards) {
+                string range = to_string(shard.firstLine) + "-" + (shard.lastLine < 0 ? "end" : to_string(shard.lastLine));
+                snprintf(row, sizeof(row), "%-18s %9.4f   %9.4f", range.c_str(), shard.seconds, max(0.0, shard.seconds - preludeSeconds));
+                file << row << "\n";
+            }
+        }
+        return overBudget;
+    }
+};
@@ -0,0 +1,316 @@
+/**
+ * @file rewriter.hpp
+ * @brief Declarative peephole rewriting of expression trees
+ * 
+ * Simplifications such as x * 1 -> x, x + 0 -> x or - - x -> x are written as
+ * entries of one constexpr rule table. The table is compiled at build time into a
+ * dispatch index keyed by operator, so a single post-order pass over the tree tries
+ * every rule that can apply at each node, instead of one tree walk per rule.
+ * 
+ * @author HoPiler Project
+ */
+
+#pragma once
+
+#include "expNode.hpp"
+#include "tokens.hpp"
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+/**
+ * @enum PatternTest
+ * @brief What an operand of a rewrite pattern has to look like
+ */
+enum PatternTest { _anyOperand,
+    _intOperand,
+    _zeroLiteral,
+    _oneLiteral,
+    _negateNumber };
+
+/**
+ * @enum NumberKind
+ * @brief What an operand is known to evaluate to, as far as the rules care
+ */
+enum NumberKind { _notNumber, // string, char, bool or unknown
+    _intNumber,
+    _floatNumber };
+
+/**
+ * @enum RewriteResult
+ * @brief Which part of the matched node replaces it
+ */
+enum RewriteResult { _keepLeft,
+    _keepRight,
+    _keepGrandchild };
+
+/**
+ * @struct RewriteRule
+ * @brief One pattern -> replacement rule
+ * 
+ * A rule matches a node holding operator `op` with `arity` children whose first and
+ * (for binary operators) second child pass the `left` and `right` tests.
+ */
+struct RewriteRule {
+    const char* name;
+    OperatorType op;
+    int arity;
+    PatternTest left;
+    PatternTest right;
+    RewriteResult result;
+};
+
+/**
+ * @brief The rewrite rules, in priority order within each operator
+ * 
+ * Adding a simplification only means adding a line here.
+ * 
+ * @note A rule must not change the type of the expression or hide a type error,
+ *       so the identities only apply to int literals on int operands (x * 1.0 is
+ *       a float, s + 0 an error). not not x is not simplified: it turns any value
+ *       into 0 or 1.
+ */
+constexpr RewriteRule rewriteRules[] = {
+    { "x * 1 -> x", _mul, 2, _intOperand, _oneLiteral, _keepLeft },
+    { "1 * x -> x", _mul, 2, _oneLiteral, _intOperand, _keepRight },
+    { "x / 1 -> x", _div, 2, _intOperand, _oneLiteral, _keepLeft },
+    { "x ** 1 -> x", _pow, 2, _intOperand, _oneLiteral, _keepLeft },
+    { "x + 0 -> x", _add, 2, _intOperand, _zeroLiteral, _keepLeft },
+    { "0 + x -> x", _add, 2, _zeroLiteral, _intOperand, _keepRight },
+    { "x - 0 -> x", _sub, 2, _intOperand, _zeroLiteral, _keepLeft },
+    { "- - x -> x", _sub, 1, _negateNumber, _anyOperand, _keepGrandchild },
+};
+
+constexpr int rewriteRuleCount = sizeof(rewriteRules) / sizeof(rewriteRules[0]);
+
+/**
+ * @struct CompiledRules
+ * @brief Rule table indexed by operator
+ * 
+ * The rules for operator op are order[first[op]] .. order[first[op + 1] - 1].
+ */
+struct CompiledRules {
+    int first[_assPow + 2];
+    int order[rewriteRuleCount];
+};
+
+/**
+ * @brief Compiles the rule table into a per-operator dispatch index
+ * 
+ * A counting sort by operator that keeps the relative order of rules, evaluated
+ * at compile time.
+ */
+constexpr CompiledRules compileRules()
+{
+    CompiledRules compiled {};
+    for (int i = 0; i < rewriteRuleCount; i++)
+        compiled.first[rewriteRules[i].op + 1]++;
+    for (int op = 0; op <= _assPow; op++)
+        compiled.first[op + 1] += compiled.first[op];
+
+    int next[_assPow + 1] {};
+    for (int i = 0; i < rewriteRuleCount; i++) {
+        int op = rewriteRules[i].op;
+        compiled.order[compiled.first[op] + next[op]++] = i;
+    }
+    return compiled;
+}
+
+constexpr CompiledRules compiledRules = compileRules();
+
+static_assert(compiledRules.first[_assPow + 1] == rewriteRuleCount, "every rule must be indexed");
+static_assert(compiledRules.first[_ass + 1] - compiledRules.first[_ass] == 0, "assignments are never rewritten");
+
+/**
+ * @class Rewriter
+ * @brief Applies rewriteRules to an expression tree in one pass
+ * 
+ * Algorithm:
+ * - Post-order traversal, so operands are already simplified when their parent
+ *   is looked at; the traversal also works out which operands are int or float
+ *   numbers, from the literals and the declared types of the variables in scope
+ * - At an operator node, only the rules indexed under its operator are tried;
+ *   a rule first checks the arity and then the cheap operand tests
+ * - When a rule fires the surviving operand is moved into the node's slot; it
+ *   was already simplified as an operand, so no rule applies to it again
+ * 
+ * Example:
+ * ```
+ * ExpressionNode tree = parser.getTree();
+ * int applied = Rewriter().rewrite(tree);
+ * ```
+ * 
+ * @see rewriteRules
+ */
+class Rewriter {
+private:
+    int applied = 0;
+    vector<unordered_map<string, NumberKind>> scopes; // what the variables of every enclosing block hold
+
+    /**
+     * @brief Checks whether a literal node is an int equal to value
+     */
+    bool isInt(ExpressionNode* node, double value)
+    {
+        if (node->getTokenType() != _literal || node->getToken() != _intLit)
+            return false;
+        return stod(node->getTokenValue()) == value;
+    }
+
+    /// @brief Checks whether a node is a prefix operator of the given type
+    bool isPrefix(ExpressionNode* node, OperatorType op)
+    {
+        return node->getTokenType() == _operator && node->getToken() == op && node->getChildCount() == 1;
+    }
+
+    /// @brief Evaluates one PatternTest against an operand and what it holds
+    bool test(PatternTest pattern, ExpressionNode* operand, NumberKind kind)
+    {
+        switch (pattern) {
+        case _anyOperand:
+            return true;
+        case _intOperand:
+            return kind == _intNumber;
+        case _zeroLiteral:
+            return isInt(operand, 0);
+        case _oneLiteral:
+            return isInt(operand, 1);
+        case _negateNumber:
+            return isPrefix(operand, _sub) && kind != _notNumber; // - of an int is an int, of a float a float
+        }
+        return false;
+    }
+
+    /// @brief Gets what a variable holds, through the enclosing scopes
+    NumberKind lookup(ExpressionNode* node)
+    {
+        for (int i = scopes.size() - 1; i >= 0; i--) {
+            auto found = scopes[i].find(node->getTokenValue());
+            if (found != scopes[i].end())
+                return found->second;
+        }
+        return _notNumber; // undeclared, or true/false
+    }
+
+    /**
+     * @brief Works out what an operator node holds from what its operands hold
+     *
+     * Mirrors the arithmetic of the CodeGenerator and the Interpreter: int with int
+     * stays int, a float operand makes a float; everything else is not a number
+     * the rules need to know about.
+     */
+    static NumberKind operatorKind(ExpressionNode& node, NumberKind left, NumberKind right)
+    {
+        int op = node.getToken();
+        if (node.getChildCount() == 1)
+            return op == _sub ? left : _notNumber;
+        if (op > _pow || left == _notNumber || right == _notNumber)
+            return _notNumber;
+        return left == _floatNumber || right == _floatNumber ? _floatNumber : _intNumber;
+    }
+
+    /**
+     * @brief Tries the rules of the node's operator and applies the first match
+     * 
+     * @param node The node to rewrite in place
+     * @param kinds What the first two children hold
+     * @return The child that replaced the node (0 or 1, 0 for a grandchild), or -1
+     *         if no rule fired
+     * 
+     * The surviving operand is moved into the node, so nothing is copied and the
+     * node keeps its place among its siblings.
+     */
+    int applyRules(ExpressionNode& node, const NumberKind kinds[2])
+    {
+        int op = node.getToken();
+        ExpressionNode* left = node.getFirstChild();
+        ExpressionNode* right = left ? left->getNextSibling() : nullptr;
+        for (int i = compiledRules.first[op]; i < compiledRules.first[op + 1]; i++) {
+            const RewriteRule& rule = rewriteRules[compiledRules.order[i]];
+            if (node.getChildCount() != rule.arity || !test(rule.left, left, kinds[0]))
+                continue;
+            if (rule.arity == 2 && !test(rule.right, right, kinds[1]))
+                continue;
+
+            applied++;
+            switch (rule.result) {
+            case _keepLeft:
+                node = std::move(*left);
+                return 0;
+            case _keepRight:
+                node = std::move(*right);
+                return 1;
+            case _keepGrandchild:
+                node = std::move(*left->getFirstChild());
+                return 0;
+            }
+        }
+        return -1;
+    }
+
+    /**
+     * @brief Rewrites a subtree bottom-up
+     * 
+     * @param node Root of the subtree, rewritten in place
+     * @return What the (rewritten) node holds
+     * 
+     * Children are rewritten in place as well, so a child pointer taken before the
+     * call still points at the (possibly replaced) child afterwards. Blocks and for
+     * loops open a scope, as in the CodeGenerator; a declared variable is in scope
+     * after its initialiser.
+     */
+    NumberKind rewriteNode(ExpressionNode& node)
+    {
+        bool scoped = node.getTokenType() == _expression || (node.getTokenType() == _keyWord && node.getToken() == _for);
+        if (scoped)
+            scopes.emplace_back();
+        NumberKind kinds[2] = { _notNumber, _notNumber };
+        int index = 0;
+        for (ExpressionNode* child = node.getFirstChild(); child; child = child->getNextSibling(), index++) {
+            NumberKind kind = rewriteNode(*child);
+            if (index < 2)
+                kinds[index] = kind;
+        }
+        if (scoped)
+            scopes.pop_back();
+
+        switch (node.getTokenType()) {
+        case _literal:
+            return node.getToken() == _intLit ? _intNumber : node.getToken() == _floatLit ? _floatNumber : _notNumber;
+        case _identifier:
+            return lookup(&node);
+        case _keyWord:
+            if (node.getToken() >= _int) {
+                ExpressionNode* child = node.getFirstChild();
+                ExpressionNode* nameNode = child->getTokenType() == _operator ? child->getFirstChild() : child;
+                int type = node.getToken();
+                scopes.back()[nameNode->getTokenValue()] = type == _int ? _intNumber : type == _float ? _floatNumber : _notNumber;
+            }
+            return _notNumber;
+        case _operator: {
+            if (node.getToken() >= _ass)
+                return _notNumber;
+            int survivor = applyRules(node, kinds);
+            return survivor == -1 ? operatorKind(node, kinds[0], kinds[1]) : kinds[survivor];
+        }
+        default:
+            return _notNumber;
+        }
+    }
+
+public:
+    /**
+     * @brief Simplifies a tree in place
+     * 
+     * @param root The root of the tree (usually Parser::getTree())
+     * @return The number of rewrites applied by this call
+     */
+    int rewrite(ExpressionNode& root)
+    {
+        int before = applied;
+        rewriteNode(root);
+        return applied - before;
+    }
+};
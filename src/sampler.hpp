@@ -0,0 +1,229 @@
+/**
+ * @file sampler.hpp
+ * @brief Sampling profiler for interpreted HoLang (--run --sample-profile)
+ *
+ * A native profiler sees only the interpreter's own frames. The SampleProfiler
+ * instead records which HoLang statements are executing: the interpreter keeps a
+ * stack of the statements it is inside, and a SIGPROF timer copies that stack into
+ * a lock-free ring buffer. The samples are written as folded stacks, one line per
+ * distinct stack, which flamegraph.pl or speedscope turn into a flame graph:
+ *
+ * ```
+ * loop.ho;for:2;assign total:3 2874
+ * loop.ho;for:2 113
+ * ```
+ *
+ * HoLang has no functions, so the "call stack" is the nesting of statements:
+ * loops, ifs and the innermost simple statement, each labelled with its line.
+ *
+ * @author HoPiler Project
+ */
+
+#pragma once
+
+#include "expNode.hpp"
+#include "tokens.hpp"
+#include <atomic>
+#include <csignal>
+#include <fstream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <sys/time.h>
+#include <vector>
+
+using namespace std;
+
+/**
+ * @class SampleProfiler
+ * @brief Statement stack, timer and sample buffer of the interpreter's profiler
+ *
+ * The ring buffer has one producer, the signal handler, and one consumer, the
+ * interpreter thread itself, which drains it at statement boundaries once it is
+ * half full. Both sides only touch their own index, so neither ever blocks; a
+ * sample that finds the ring full is counted as dropped. The handler copies node
+ * pointers and nothing else, which keeps it async-signal-safe.
+ *
+ * Example:
+ * ```
+ * SampleProfiler profiler;
+ * interpreter.setSampler(&profiler);
+ * profiler.start();
+ * interpreter.run(tree);
+ * profiler.stop();
+ * profiler.writeFolded("program.ho.folded", "program.ho");
+ * ```
+ */
+class SampleProfiler {
+private:
+    static constexpr int maxDepth = 32; // deeper statements are counted but not recorded
+    static constexpr size_t capacity = 4096; // samples in the ring, a power of two
+
+    struct Sample {
+        int depth;
+        ExpressionNode* frames[maxDepth];
+    };
+
+    static inline SampleProfiler* active = nullptr; // the one the signal handler records into
+
+    ExpressionNode* frames[maxDepth];
+    atomic<int> depth { 0 };
+
+    Sample ring[capacity];
+    atomic<size_t> written { 0 }; // advanced by the signal handler only
+    atomic<size_t> read { 0 }; // advanced by drain() only
+    atomic<size_t> dropped { 0 };
+
+    map<vector<ExpressionNode*>, long long> stacks; // aggregated by drain()
+    long long sampleCount = 0;
+
+    static void handleSignal(int)
+    {
+        SampleProfiler* profiler = active;
+        if (!profiler)
+            return;
+        size_t slot = profiler->written.load(memory_order_relaxed);
+        if (slot - profiler->read.load(memory_order_acquire) >= capacity) {
+            profiler->dropped.fetch_add(1, memory_order_relaxed);
+            return;
+        }
+        Sample& sample = profiler->ring[slot & (capacity - 1)];
+        sample.depth = min(profiler->depth.load(memory_order_relaxed), maxDepth);
+        for (int i = 0; i < sample.depth; i++)
+            sample.frames[i] = profiler->frames[i];
+        profiler->written.store(slot + 1, memory_order_release);
+    }
+
+    /// @brief Gets the flame graph label of a statement
+    static string label(ExpressionNode* node)
+    {
+        static const char* const keywords[] = { "if", "elif", "else", "for", "while", "do", "return", "break", "continue",
+            "int", "float", "string", "char", "bool" };
+        string line = ":" + to_string(node->getLine());
+        if (node->getTokenType() == _keyWord) {
+            if (node->getToken() < _int)
+                return keywords[node->getToken()] + line;
+            ExpressionNode* name = node->getFirstChild();
+            if (name->getTokenType() == _operator)
+                name = name->getFirstChild();
+            return string(keywords[node->getToken()]) + " " + name->getTokenValue() + line;
+        }
+        if (node->getTokenType() == _operator && node->getToken() >= _ass)
+            return "assign " + node->getFirstChild()->getTokenValue() + line;
+        return "expression" + line;
+    }
+
+public:
+    /// @brief Constructor - an idle profiler with an empty statement stack
+    SampleProfiler() { }
+
+    SampleProfiler(const SampleProfiler&) = delete;
+    SampleProfiler& operator=(const SampleProfiler&) = delete;
+
+    ~SampleProfiler()
+    {
+        stop();
+    }
+
+    /// @brief Records that the interpreter started executing a statement
+    void enter(ExpressionNode* node)
+    {
+        int current = depth.load(memory_order_relaxed);
+        if (current < maxDepth)
+            frames[current] = node;
+        atomic_signal_fence(memory_order_release); // the frame is in place before the handler can see it
+        depth.store(current + 1, memory_order_relaxed);
+    }
+
+    /// @brief Records that the innermost statement finished; drains the ring when it fills up
+    void leave()
+    {
+        depth.store(depth.load(memory_order_relaxed) - 1, memory_order_relaxed);
+        if (written.load(memory_order_relaxed) - read.load(memory_order_relaxed) >= capacity / 2)
+            drain();
+    }
+
+    /// @brief Forgets the statements left open by an error
+    void reset()
+    {
+        depth.store(0, memory_order_relaxed);
+    }
+
+    /// @brief Moves the samples out of the ring into the aggregated stacks
+    void drain()
+    {
+        size_t end = written.load(memory_order_acquire);
+        size_t slot = read.load(memory_order_relaxed);
+        for (; slot != end; slot++) {
+            Sample& sample = ring[slot & (capacity - 1)];
+            stacks[vector<ExpressionNode*>(sample.frames, sample.frames + sample.depth)]++;
+            sampleCount++;
+        }
+        read.store(slot, memory_order_release);
+    }
+
+    /**
+     * @brief Starts sampling
+     *
+     * @param intervalMicroseconds CPU time between samples
+     * @throws runtime_error if another profiler is running or the timer cannot be set
+     */
+    void start(long intervalMicroseconds = 1000)
+    {
+        if (active)
+            throw runtime_error("Only one sampling profiler can run at a time");
+        active = this;
+
+        struct sigaction action {};
+        action.sa_handler = handleSignal;
+        action.sa_flags = SA_RESTART;
+        sigemptyset(&action.sa_mask);
+        struct itimerval timer {};
+        timer.it_interval.tv_usec = intervalMicroseconds;
+        timer.it_value.tv_usec = intervalMicroseconds;
+        if (sigaction(SIGPROF, &action, nullptr) != 0 || setitimer(ITIMER_PROF, &timer, nullptr) != 0) {
+            active = nullptr;
+            throw runtime_error("Could not start the profiling timer");
+        }
+    }
+
+    /// @brief Stops sampling and collects the samples still in the ring
+    void stop()
+    {
+        if (active != this)
+            return;
+        struct itimerval timer {};
+        setitimer(ITIMER_PROF, &timer, nullptr);
+        signal(SIGPROF, SIG_IGN);
+        active = nullptr;
+        drain();
+    }
+
+    /// @brief Gets the number of samples lost to a full ring
+    long long getDropped() const
+    {
+        return dropped.load(memory_order_relaxed);
+    }
+
+    /**
+     * @brief Writes the samples as folded stacks
+     *
+     * @param fileName Where to write
+     * @param rootName Bottom frame of every stack (usually the source file name)
+     * @return The number of samples written
+     * @throws runtime_error if the file cannot be written
+     */
+    long long writeFolded(string fileName, string rootName)
+    {
+        ofstream file(fileName);
+        if (!file.is_open())
+            throw runtime_error("Could not write sample profile " + fileName);
+        for (auto& [frames, count] : stacks) {
+            file << rootName;
+            for (ExpressionNode* frame : frames)
+                file << ";" << label(frame);
+            file << " " << count << "\n";
+        }
+        return sampleCount;
+    }
+};
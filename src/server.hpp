@@ -0,0 +1,345 @@
+/**
+ * @file server.hpp
+ * @brief Long-running module server with hot code reload (--serve)
+ *
+ * Every HoLang source given to --serve is a module. It is compiled to C (as a
+ * reentrant ho_module_main(), see CodegenOptions::module), built into a shared
+ * object and loaded. Requests name a module; a pool of worker threads runs the
+ * module's current version and answers with its return value.
+ *
+ * A watcher thread checks the sources every pollMilliseconds. A module whose file
+ * changed is rebuilt on the watcher thread and swapped in with one atomic store;
+ * workers never wait for a build, and only the changed module is rebuilt, so a
+ * reload takes one module's compile time. A module that no longer compiles keeps
+ * serving its previous version.
+ *
+ * Protocol (one request per line on stdin, one answer per line on stdout, in
+ * completion order):
+ * ```
+ * > pricing
+ * < pricing 42 v1
+ * > nosuch
+ * < nosuch unknown module
+ * ```
+ *
+ * @author HoPiler Project
+ */
+
+#pragma once
+
+#include "codegen.hpp"
+#include "native.hpp"
+#include "parser.hpp"
+#include "rewriter.hpp"
+#include "tokenizer.hpp"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <dlfcn.h>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <sys/stat.h>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+/**
+ * @class ModuleServer
+ * @brief Loaded module versions, the reload watcher and epoch-based reclamation
+ *
+ * Old versions are reclaimed by epochs. A worker announces the global epoch in its
+ * own reader slot before it loads a module's current version and clears the slot
+ * when the call returns. Publishing a new version swaps the pointer first and
+ * then advances the epoch to E; the old version can only still be in use by a
+ * reader that announced an epoch below E. Once no reader slot holds such an epoch,
+ * the old version is dlclosed. Calls that started on the old code finish on it,
+ * and neither side ever takes a lock.
+ *
+ * Example:
+ * ```
+ * ModuleServer server({ "pricing.ho" }, 4);
+ * int status, version;
+ * server.call(0, "pricing", status, version); // as worker 0
+ * ```
+ */
+class ModuleServer {
+private:
+    static constexpr int pollMilliseconds = 100;
+
+    typedef int (*ModuleEntry)(void);
+
+    struct Version {
+        int number;
+        void* library;
+        ModuleEntry entry;
+    };
+
+    struct Module {
+        string name;
+        string fileName;
+        struct stat stamp; // of the source the current version was built from
+        atomic<Version*> current { nullptr };
+        int versions = 0;
+    };
+
+    struct alignas(64) Reader { // one cache line per worker
+        atomic<uint64_t> epoch { 0 }; // 0 while not inside a call
+    };
+
+    struct Retired {
+        Version* version;
+        uint64_t epoch; // the first epoch in which no new call can reach it
+    };
+
+    vector<unique_ptr<Module>> modules;
+    unordered_map<string, Module*> byName;
+    unique_ptr<Reader[]> readers;
+    int readerCount;
+    atomic<uint64_t> epoch { 1 };
+    vector<Retired> retired; // watcher thread only
+    NativeBuild build;
+    atomic<bool> stopping { false };
+    thread watcher;
+
+    /// @brief Gets the module name of a source file (its base name without .ho)
+    static string moduleName(string fileName)
+    {
+        size_t slash = fileName.find_last_of('/');
+        if (slash != string::npos)
+            fileName = fileName.substr(slash + 1);
+        if (fileName.size() > 3 && fileName.compare(fileName.size() - 3, 3, ".ho") == 0)
+            fileName.resize(fileName.size() - 3);
+        return fileName;
+    }
+
+    /// @brief Checks whether a source file differs from the one a module was built from
+    static bool changed(const struct stat& before, const struct stat& now)
+    {
+        return before.st_size != now.st_size || before.st_mtim.tv_sec != now.st_mtim.tv_sec || before.st_mtim.tv_nsec != now.st_mtim.tv_nsec;
+    }
+
+    /**
+     * @brief Builds the next version of a module from its source
+     *
+     * @throws invalid_argument or runtime_error if the source does not compile
+     */
+    Version* compile(Module& module)
+    {
+        ifstream file(module.fileName);
+        if (!file.is_open())
+            throw invalid_argument("Could not open source file " + module.fileName);
+        stringstream content;
+        content << file.rdbuf();
+
+        Tokenizer tokenizer = Tokenizer::fromSource(module.fileName, content.str(), false);
+        Parser parser(tokenizer.getTokens(), false);
+        ExpressionNode tree = parser.getTree();
+        Rewriter().rewrite(tree);
+        CodegenOptions options;
+        options.module = true;
+        string code = CodeGenerator(tree, options).getCode(module.fileName);
+
+        int number = module.versions + 1;
+        void* library = build.load(code, module.name + "_v" + to_string(number));
+        ModuleEntry entry = library ? (ModuleEntry)dlsym(library, "ho_module_main") : nullptr;
+        if (!entry) {
+            if (library)
+                dlclose(library);
+            throw runtime_error("The C compiler rejected the generated code");
+        }
+        module.versions = number;
+        return new Version { number, library, entry };
+    }
+
+    /// @brief Makes a version the one new calls get, retiring the previous one
+    void publish(Module& module, Version* version)
+    {
+        Version* old = module.current.exchange(version, memory_order_seq_cst);
+        if (old)
+            retired.push_back({ old, epoch.fetch_add(1, memory_order_seq_cst) + 1 });
+    }
+
+    /// @brief Unloads the retired versions that no call can be using any more
+    void reclaim()
+    {
+        for (size_t i = 0; i < retired.size();) {
+            bool inUse = false;
+            for (int reader = 0; reader < readerCount && !inUse; reader++) {
+                uint64_t announced = readers[reader].epoch.load(memory_order_seq_cst);
+                inUse = announced != 0 && announced < retired[i].epoch;
+            }
+            if (inUse) {
+                i++;
+                continue;
+            }
+            dlclose(retired[i].version->library);
+            delete retired[i].version;
+            retired[i] = retired.back();
+            retired.pop_back();
+        }
+    }
+
+    /// @brief Rebuilds and swaps in every module whose source changed
+    void poll()
+    {
+        for (auto& module : modules) {
+            struct stat now;
+            if (stat(module->fileName.c_str(), &now) != 0 || !changed(module->stamp, now))
+                continue;
+            module->stamp = now;
+            try {
+                publish(*module, compile(*module));
+                cerr << "Reloaded " << module->name << " as version " << module->versions << endl;
+            } catch (const std::exception& e) {
+                cerr << "Could not reload " << module->name << ", still serving version " << module->versions << ": " << e.what() << endl;
+            }
+        }
+    }
+
+    void watch()
+    {
+        while (!stopping.load(memory_order_relaxed)) {
+            this_thread::sleep_for(chrono::milliseconds(pollMilliseconds));
+            poll();
+            reclaim();
+        }
+    }
+
+public:
+    /**
+     * @brief Constructor - builds every module and starts watching their sources
+     *
+     * @param fileNames The module sources
+     * @param workers Number of threads that will call(), each with its own index
+     * @throws invalid_argument or runtime_error if a module cannot be built
+     */
+    ModuleServer(const vector<string>& fileNames, int workers)
+        : readers(new Reader[workers])
+        , readerCount(workers)
+    {
+        for (const string& fileName : fileNames) {
+            auto module = make_unique<Module>();
+            module->fileName = fileName;
+            module->name = moduleName(fileName);
+            if (stat(fileName.c_str(), &module->stamp) != 0)
+                throw invalid_argument("Could not open source file " + fileName);
+            if (byName.count(module->name))
+                throw invalid_argument("Two modules are called " + module->name);
+            module->current.store(compile(*module));
+            byName[module->name] = module.get();
+            modules.push_back(std::move(module));
+        }
+        watcher = thread(&ModuleServer::watch, this);
+    }
+
+    ModuleServer(const ModuleServer&) = delete;
+    ModuleServer& operator=(const ModuleServer&) = delete;
+
+    /// @brief Destructor - stops the watcher and unloads everything; no call may be running
+    ~ModuleServer()
+    {
+        stopping.store(true);
+        watcher.join();
+        for (Retired& old : retired) {
+            dlclose(old.version->library);
+            delete old.version;
+        }
+        for (auto& module : modules) {
+            Version* version = module->current.load();
+            dlclose(version->library);
+            delete version;
+        }
+    }
+
+    /**
+     * @brief Runs the current version of a module
+     *
+     * @param reader Index of the calling worker (0 to workers - 1); one call at a time per index
+     * @param name The module name
+     * @param status Set to the module's return value
+     * @param version Set to the number of the version that ran
+     * @return false if there is no such module
+     */
+    bool call(int reader, const string& name, int& status, int& version)
+    {
+        auto found = byName.find(name);
+        if (found == byName.end())
+            return false;
+        Reader& slot = readers[reader];
+        slot.epoch.store(epoch.load(memory_order_seq_cst), memory_order_seq_cst);
+        Version* current = found->second->current.load(memory_order_seq_cst);
+        status = current->entry();
+        version = current->number;
+        slot.epoch.store(0, memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Serves requests from a stream until it ends
+     *
+     * @param fileNames The module sources
+     * @param input One module name per line
+     * @param output Where the answers go
+     * @param workers Number of worker threads
+     * @return EXIT_SUCCESS
+     * @throws invalid_argument or runtime_error if a module cannot be built at startup
+     */
+    static int serve(const vector<string>& fileNames, istream& input, ostream& output, int workers = 4)
+    {
+        ModuleServer server(fileNames, workers);
+        mutex queueLock, outputLock;
+        condition_variable queueReady;
+        deque<string> requests;
+        bool done = false;
+
+        vector<thread> pool;
+        for (int reader = 0; reader < workers; reader++) {
+            pool.emplace_back([&, reader] {
+                while (true) {
+                    string request;
+                    {
+                        unique_lock<mutex> lock(queueLock);
+                        queueReady.wait(lock, [&] { return done || !requests.empty(); });
+                        if (requests.empty())
+                            return;
+                        request = std::move(requests.front());
+                        requests.pop_front();
+                    }
+                    int status, version;
+                    string answer = server.call(reader, request, status, version)
+                        ? request + " " + to_string(status) + " v" + to_string(version)
+                        : request + " unknown module";
+                    lock_guard<mutex> lock(outputLock);
+                    output << answer << endl;
+                }
+            });
+        }
+
+        string line;
+        while (getline(input, line)) {
+            if (line.empty())
+                continue;
+            {
+                lock_guard<mutex> lock(queueLock);
+                requests.push_back(line);
+            }
+            queueReady.notify_one();
+        }
+        {
+            lock_guard<mutex> lock(queueLock);
+            done = true;
+        }
+        queueReady.notify_all();
+        for (thread& worker : pool)
+            worker.join();
+        return EXIT_SUCCESS;
+    }
+};
@@ -0,0 +1,281 @@
+/**
+ * @file shaker.hpp
+ * @brief Reachability of variables from what a program observably does
+ *
+ * A HoLang program is observed through its exit status and the path it takes to
+ * get there, so a variable that neither reaches a return nor a condition, directly
+ * or through other variables, does not change anything when it is left out. The
+ * TreeShaker finds the declarations and assignments of those variables, and the
+ * CodeGenerator type checks them but emits no C for them.
+ *
+ * @author HoPiler Project
+ */
+
+#pragma once
+
+#include "expNode.hpp"
+#include "tokens.hpp"
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+using namespace std;
+
+/**
+ * @class TreeShaker
+ * @brief Finds the statements whose variables nothing observable depends on
+ *
+ * Algorithm:
+ * - One walk over the tree resolves every identifier to its declaration, with
+ *   the same block scoping as the CodeGenerator
+ * - Return values and if/elif, while, do and for conditions are roots: the
+ *   variables they read are live
+ * - A declaration or assignment that is a statement of a block only makes the
+ *   variables it reads live if its own variable is live; any other one (a for
+ *   init or step, or one that can trap) is a root for its variable and its reads
+ * - Liveness is propagated from the roots in a worklist; the candidates whose
+ *   variable stayed dead are unreachable
+ *
+ * Integer division and modulo trap when the divisor is zero (and LLONG_MIN / -1
+ * overflows), so a statement that divides by anything but a positive literal is
+ * always kept.
+ *
+ * Example:
+ * ```
+ * TreeShaker shaker(tree);
+ * bool gone = shaker.isUnreachable(statement);
+ * ```
+ *
+ * @see CodeGenerator
+ */
+class TreeShaker {
+private:
+    /**
+     * @struct Symbol
+     * @brief One declared variable
+     */
+    struct Symbol {
+        bool live = false;
+        vector<int> dependencies; // variables read by the removable statements that set this one
+    };
+
+    vector<Symbol> symbols;
+    vector<unordered_map<string, int>> scopes;
+    vector<pair<ExpressionNode*, int>> candidates; // removable statement and the variable it sets
+    vector<int> roots;
+    unordered_set<ExpressionNode*> unreachable;
+
+    /// @brief Gets the declaration an identifier refers to, or -1 if it has none (true and false)
+    int resolve(ExpressionNode* node)
+    {
+        for (int i = scopes.size() - 1; i >= 0; i--) {
+            auto found = scopes[i].find(node->getTokenValue());
+            if (found != scopes[i].end())
+                return found->second;
+        }
+        return -1;
+    }
+
+    /// @brief Adds the variables an expression reads to reads
+    void collect(ExpressionNode* node, vector<int>& reads)
+    {
+        if (node->getTokenType() == _identifier) {
+            int symbol = resolve(node);
+            if (symbol != -1)
+                reads.push_back(symbol);
+            return;
+        }
+        for (ExpressionNode* child = node->getFirstChild(); child; child = child->getNextSibling())
+            collect(child, reads);
+    }
+
+    /// @brief Makes the variables an expression reads live
+    void use(ExpressionNode* node)
+    {
+        collect(node, roots);
+    }
+
+    /// @brief Checks whether a divisor is a positive number literal
+    static bool isSafeDivisor(ExpressionNode* node)
+    {
+        if (node->getTokenType() != _literal || !(node->getToken() == _intLit || node->getToken() == _floatLit))
+            return false;
+        return stod(node->getTokenValue()) > 0;
+    }
+
+    /// @brief Checks whether evaluating an expression can stop the program
+    static bool canTrap(ExpressionNode* node)
+    {
+        if (node->getTokenType() == _operator && node->getChildCount() == 2
+            && (node->getToken() == _div || node->getToken() == _mod) && !isSafeDivisor(node->getFirstChild()->getNextSibling()))
+            return true;
+        for (ExpressionNode* child = node->getFirstChild(); child; child = child->getNextSibling())
+            if (canTrap(child))
+                return true;
+        return false;
+    }
+
+    /**
+     * @brief Records a statement that sets a variable
+     *
+     * @param node The declaration or assignment
+     * @param symbol The variable it sets
+     * @param reads The variables its value reads
+     * @param removable Whether it can be left out when the variable is dead
+     */
+    void define(ExpressionNode* node, int symbol, const vector<int>& reads, bool removable)
+    {
+        if (!removable) {
+            roots.push_back(symbol);
+            roots.insert(roots.end(), reads.begin(), reads.end());
+            return;
+        }
+        vector<int>& dependencies = symbols[symbol].dependencies;
+        dependencies.insert(dependencies.end(), reads.begin(), reads.end());
+        candidates.emplace_back(node, symbol);
+    }
+
+    /// @brief Visits a declaration; the variable is in scope after its initialiser
+    void visitDeclaration(ExpressionNode* node, bool removable)
+    {
+        ExpressionNode* child = node->getFirstChild();
+        bool initialised = child->getTokenType() == _operator;
+        ExpressionNode* nameNode = initialised ? child->getFirstChild() : child;
+
+        vector<int> reads;
+        if (initialised)
+            collect(nameNode->getNextSibling(), reads);
+        int symbol = symbols.size();
+        symbols.emplace_back();
+        scopes.back()[nameNode->getTokenValue()] = symbol;
+        define(node, symbol, reads, removable && !(initialised && canTrap(nameNode->getNextSibling())));
+    }
+
+    /// @brief Visits an assignment; /= and %= trap like the operators they stand for
+    void visitAssignment(ExpressionNode* node, bool removable)
+    {
+        ExpressionNode* target = node->getFirstChild();
+        ExpressionNode* value = target->getNextSibling();
+        int symbol = target->getTokenType() == _identifier ? resolve(target) : -1;
+        if (symbol == -1) {
+            use(node); // not assignable; the CodeGenerator reports it
+            return;
+        }
+
+        vector<int> reads;
+        collect(value, reads);
+        bool traps = canTrap(value) || ((node->getToken() == _assDiv || node->getToken() == _assMod) && !isSafeDivisor(value));
+        define(node, symbol, reads, removable && !traps);
+    }
+
+    /// @brief Visits the statements of a block in a new scope
+    void visitBlock(ExpressionNode* block)
+    {
+        scopes.emplace_back();
+        for (ExpressionNode* child = block ? block->getFirstChild() : nullptr; child; child = child->getNextSibling())
+            visitStatement(child, true);
+        scopes.pop_back();
+    }
+
+    /**
+     * @brief Visits one statement
+     *
+     * @param removable Whether a declaration or assignment here is a statement of
+     *                  a block, which the CodeGenerator can leave out
+     */
+    void visitStatement(ExpressionNode* node, bool removable)
+    {
+        if (node->getTokenType() == _expression) {
+            visitBlock(node);
+            return;
+        }
+        if (node->getTokenType() == _keyWord && node->getToken() >= _int) {
+            visitDeclaration(node, removable);
+            return;
+        }
+        if (node->getTokenType() == _operator && node->getToken() >= _ass) {
+            visitAssignment(node, removable);
+            return;
+        }
+        if (node->getTokenType() != _keyWord) {
+            use(node);
+            return;
+        }
+
+        ExpressionNode* first = node->getFirstChild();
+        switch (node->getToken()) {
+        case _if:
+            use(first);
+            visitBlock(first->getNextSibling());
+            for (ExpressionNode* arm = first->getNextSibling()->getNextSibling(); arm; arm = arm->getNextSibling()) {
+                if (arm->getToken() == _else) {
+                    visitBlock(arm->getFirstChild());
+                } else {
+                    use(arm->getFirstChild());
+                    visitBlock(arm->getFirstChild()->getNextSibling());
+                }
+            }
+            return;
+        case _while:
+            use(first);
+            visitBlock(first->getNextSibling());
+            return;
+        case _do:
+            visitBlock(first);
+            use(first->getNextSibling());
+            return;
+        case _for:
+            scopes.emplace_back();
+            visitStatement(first, false);
+            use(first->getNextSibling());
+            visitStatement(first->getNextSibling()->getNextSibling(), false);
+            visitBlock(first->getNextSibling()->getNextSibling()->getNextSibling());
+            scopes.pop_back();
+            return;
+        case _return:
+            if (first)
+                use(first);
+            return;
+        default:
+            return;
+        }
+    }
+
+public:
+    /**
+     * @brief Constructor - finds the unreachable statements of a tree
+     *
+     * @param root The root of the tree, as the CodeGenerator gets it
+     */
+    TreeShaker(ExpressionNode& root)
+    {
+        scopes.emplace_back();
+        for (ExpressionNode* child = root.getFirstChild(); child; child = child->getNextSibling())
+            visitStatement(child, true);
+
+        while (!roots.empty()) {
+            int symbol = roots.back();
+            roots.pop_back();
+            if (symbols[symbol].live)
+                continue;
+            symbols[symbol].live = true;
+            roots.insert(roots.end(), symbols[symbol].dependencies.begin(), symbols[symbol].dependencies.end());
+        }
+        for (auto& [node, symbol] : candidates)
+            if (!symbols[symbol].live)
+                unreachable.insert(node);
+    }
+
+    /// @brief Checks whether a statement sets only a variable nothing observable depends on
+    bool isUnreachable(ExpressionNode* node)
+    {
+        return unreachable.count(node);
+    }
+
+    /// @brief Gets the number of unreachable statements
+    int getUnreachableCount()
+    {
+        return unreachable.size();
+    }
+};
@@ -0,0 +1,428 @@
+/**
+ * @file snapshot.hpp
+ * @brief Heap snapshots of interpreted programs for warm starts (--snapshot)
+ *
+ * Programs often begin with a long block of declarations. HeapSnapshot stores the
+ * globals that block produces in a relocatable file, and WarmStart uses it to skip
+ * the block on later runs: the file is mmap()ed and globals are read out of it only
+ * when the program first uses them, so starting up costs the same however large
+ * the initialisation was.
+ *
+ * @author HoPiler Project
+ */
+
+#pragma once
+
+#include "interpreter.hpp"
+#include "parser.hpp"
+#include "tokenizer.hpp"
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+/**
+ * @class HeapSnapshot
+ * @brief Memory-mapped, read-only view of saved globals
+ *
+ * File layout (native endianness, every reference is an offset from the start of
+ * the file, so the mapping works at any address):
+ * - Header: magic, identity of the source file (size and modification time), where
+ *   execution resumes (byte offset and line), and the offsets of the sections below
+ * - Slots: open-addressing hash table (linear probing, power of two) of record
+ *   index + 1, 0 for an empty slot
+ * - Records: one per global, with its type, scalar payload and the offsets of its
+ *   name and string value
+ * - Bytes: all names and string values
+ *
+ * Opening a snapshot validates the header only; records are bounds-checked when
+ * they are read.
+ *
+ * Example:
+ * ```
+ * HeapSnapshot::write("init.snap", interpreter.getGlobals(), "program.ho", offset, line);
+ * HeapSnapshot snapshot("init.snap");
+ * Value value;
+ * snapshot.load("first", value);
+ * ```
+ */
+class HeapSnapshot {
+private:
+    struct Header {
+        char magic[8];
+        uint64_t sourceSize;
+        int64_t sourceSeconds;
+        int64_t sourceNanoseconds;
+        uint64_t resumeOffset;
+        uint64_t resumeLine;
+        uint64_t slotCount;
+        uint64_t slotsOffset;
+        uint64_t recordCount;
+        uint64_t recordsOffset;
+        uint64_t bytesOffset;
+        uint64_t fileSize;
+    };
+
+    struct Record {
+        uint64_t nameOffset;
+        uint64_t nameLength;
+        uint64_t textOffset;
+        uint64_t textLength;
+        int64_t intValue;
+        double floatValue;
+        uint32_t type;
+        uint32_t reserved;
+    };
+
+    static constexpr char snapshotMagic[8] = { 'H', 'O', 'S', 'N', 'A', 'P', '1', '\0' };
+
+    const char* data = nullptr;
+    size_t size = 0;
+    const Header* header = nullptr;
+
+    /// @brief Hashes a name with 64-bit FNV-1a (the same hash BatchCompiler uses for inputs)
+    static uint64_t hashName(const char* name, size_t length)
+    {
+        uint64_t hash = 14695981039346656037ULL;
+        for (size_t i = 0; i < length; i++) {
+            hash ^= (unsigned char)name[i];
+            hash *= 1099511628211ULL;
+        }
+        return hash;
+    }
+
+    /// @brief Checks that [offset, offset + length) lies inside the mapping
+    bool inBounds(uint64_t offset, uint64_t length) const
+    {
+        return offset <= size && length <= size - offset;
+    }
+
+    /// @brief Reads the size and modification time of a file
+    static bool sourceIdentity(string fileName, struct stat& info)
+    {
+        return stat(fileName.c_str(), &info) == 0;
+    }
+
+public:
+    /**
+     * @brief Constructor - maps a snapshot file
+     *
+     * @param fileName Path of the snapshot
+     * @throws invalid_argument if the file cannot be mapped or is not a valid snapshot
+     */
+    HeapSnapshot(string fileName)
+    {
+        int file = open(fileName.c_str(), O_RDONLY);
+        struct stat info;
+        if (file < 0 || fstat(file, &info) != 0 || info.st_size < (off_t)sizeof(Header)) {
+            if (file >= 0)
+                close(file);
+            throw invalid_argument("Could not open snapshot " + fileName);
+        }
+        size = info.st_size;
+        void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+        close(file);
+        if (mapping == MAP_FAILED)
+            throw invalid_argument("Could not map snapshot " + fileName);
+        data = (const char*)mapping;
+        header = (const Header*)data;
+
+        uint64_t slots = header->slotCount;
+        bool valid = memcmp(header->magic, snapshotMagic, sizeof(snapshotMagic)) == 0
+            && header->fileSize == size
+            && slots > 0 && (slots & (slots - 1)) == 0 && slots < size
+            && inBounds(header->slotsOffset, slots * sizeof(uint32_t))
+            && header->recordCount < size
+            && inBounds(header->recordsOffset, header->recordCount * sizeof(Record))
+            && header->bytesOffset <= size;
+        if (!valid) {
+            munmap((void*)data, size);
+            throw invalid_argument(fileName + " is not a HoPiler snapshot");
+        }
+    }
+
+    HeapSnapshot(const HeapSnapshot&) = delete;
+    HeapSnapshot& operator=(const HeapSnapshot&) = delete;
+
+    ~HeapSnapshot()
+    {
+        munmap((void*)data, size);
+    }
+
+    /**
+     * @brief Checks whether the snapshot was taken from the current version of a file
+     *
+     * @param sourceName Path of the source file
+     * @return true if size and modification time match the ones recorded
+     */
+    bool matches(string sourceName) const
+    {
+        struct stat info;
+        return sourceIdentity(sourceName, info)
+            && (uint64_t)info.st_size == header->sourceSize
+            && info.st_mtim.tv_sec == header->sourceSeconds
+            && info.st_mtim.tv_nsec == header->sourceNanoseconds;
+    }
+
+    /// @brief Gets the byte offset of the first statement after the snapshotted part
+    uint64_t getResumeOffset() const
+    {
+        return header->resumeOffset;
+    }
+
+    /// @brief Gets the source line of the first statement after the snapshotted part
+    int getResumeLine() const
+    {
+        return header->resumeLine;
+    }
+
+    /**
+     * @brief Reads one global out of the snapshot
+     *
+     * @param name Name of the global
+     * @param value Set to the global's value when found
+     * @return true if the snapshot has the global
+     * @throws invalid_argument if the record points outside the file
+     */
+    bool load(const string& name, Value& value) const
+    {
+        const uint32_t* slots = (const uint32_t*)(data + header->slotsOffset);
+        const Record* records = (const Record*)(data + header->recordsOffset);
+        uint64_t mask = header->slotCount - 1;
+
+        uint64_t slot = hashName(name.data(), name.size()) & mask;
+        for (uint64_t probe = 0; probe < header->slotCount; probe++, slot = (slot + 1) & mask) {
+            uint32_t entry = slots[slot];
+            if (entry == 0)
+                return false;
+            if (entry > header->recordCount)
+                throw invalid_argument("Corrupt snapshot slot");
+
+            const Record& record = records[entry - 1];
+            if (!inBounds(record.nameOffset, record.nameLength) || !inBounds(record.textOffset, record.textLength) || record.type < _int || record.type > _bool)
+                throw invalid_argument("Corrupt snapshot record");
+            if (record.nameLength != name.size() || memcmp(data + record.nameOffset, name.data(), name.size()) != 0)
+                continue;
+
+            switch (record.type) {
+            case _float:
+                value = Value::fromFloat(record.floatValue);
+                break;
+            case _string:
+                value = Value::fromString(string_view(data + record.textOffset, record.textLength));
+                break;
+            case _char:
+                value = Value::fromChar((char)record.intValue);
+                break;
+            case _bool:
+                value = Value::fromBool(record.intValue != 0);
+                break;
+            default:
+                value = Value::fromInt(record.intValue);
+            }
+            return true;
+        }
+        return false;
+    }
+
+    /**
+     * @brief Writes a snapshot of a set of globals
+     *
+     * @param fileName Path of the snapshot to write; it is replaced atomically
+     * @param globals The globals to store
+     * @param sourceName The source file the globals were computed from
+     * @param resumeOffset Byte offset in the source where execution continues
+     * @param resumeLine Source line where execution continues
+     * @throws invalid_argument if the snapshot cannot be written
+     */
+    static void write(string fileName, const unordered_map<string, Value>& globals, string sourceName, uint64_t resumeOffset, int resumeLine)
+    {
+        struct stat info;
+        if (!sourceIdentity(sourceName, info))
+            throw invalid_argument("Could not stat " + sourceName);
+
+        uint64_t slotCount = 1;
+        while (slotCount < 2 * globals.size() + 1)
+            slotCount *= 2;
+
+        vector<uint32_t> slots(slotCount, 0);
+        vector<Record> records;
+        string bytes;
+        for (auto& [name, value] : globals) {
+            Record record {};
+            record.nameOffset = bytes.size();
+            record.nameLength = name.size();
+            bytes += name;
+            record.textOffset = bytes.size();
+            if (value.isString()) {
+                record.textLength = value.getText().size();
+                bytes += value.getText();
+            } else if (value.isFloat()) {
+                record.floatValue = value.asFloat();
+            } else {
+                record.intValue = value.asInt();
+            }
+            record.type = value.getType();
+            records.push_back(record);
+
+            uint64_t slot = hashName(name.data(), name.size()) & (slotCount - 1);
+            while (slots[slot] != 0)
+                slot = (slot + 1) & (slotCount - 1);
+            slots[slot] = records.size();
+        }
+
+        Header header {};
+        memcpy(header.magic, snapshotMagic, sizeof(snapshotMagic));
+        header.sourceSize = info.st_size;
+        header.sourceSeconds = info.st_mtim.tv_sec;
+        header.sourceNanoseconds = info.st_mtim.tv_nsec;
+        header.resumeOffset = resumeOffset;
+        header.resumeLine = resumeLine;
+        header.slotCount = slotCount;
+        header.slotsOffset = sizeof(Header);
+        header.recordCount = records.size();
+        header.recordsOffset = (header.slotsOffset + slotCount * sizeof(uint32_t) + 7) & ~7ULL;
+        header.bytesOffset = header.recordsOffset + records.size() * sizeof(Record);
+        header.fileSize = header.bytesOffset + bytes.size();
+
+        // record offsets so far are relative to the byte section
+        for (Record& record : records) {
+            record.nameOffset += header.bytesOffset;
+            record.textOffset += header.bytesOffset;
+        }
+
+        string temporary = fileName + ".tmp";
+        ofstream output(temporary, ios::binary | ios::trunc);
+        if (!output.is_open())
+            throw invalid_argument("Could not write snapshot " + fileName);
+        output.write((const char*)&header, sizeof(header));
+        output.write((const char*)slots.data(), slots.size() * sizeof(uint32_t));
+        output.write(string(header.recordsOffset - header.slotsOffset - slots.size() * sizeof(uint32_t), '\0').data(), header.recordsOffset - header.slotsOffset - slots.size() * sizeof(uint32_t));
+        output.write((const char*)records.data(), records.size() * sizeof(Record));
+        output.write(bytes.data(), bytes.size());
+        output.close();
+        if (!output || rename(temporary.c_str(), fileName.c_str()) != 0)
+            throw invalid_argument("Could not write snapshot " + fileName);
+    }
+};
+
+/**
+ * @class WarmStart
+ * @brief Runs a program from a snapshot of its initialisation when one is available
+ *
+ * The initialisation of a program is its leading run of top-level declarations;
+ * they can only define globals, so their whole effect is captured by the globals
+ * they leave behind.
+ *
+ * - Cold run (no snapshot, or one taken from a different version of the source):
+ *   the whole file is tokenized and parsed, the initialisation is run, the globals
+ *   are written to the snapshot and the program continues
+ * - Warm run: the snapshot is mapped, only the source after the initialisation is
+ *   read, tokenized and parsed, and globals come out of the snapshot on first use
+ *
+ * Example:
+ * ```
+ * return WarmStart::run("program.ho", "program.snap");
+ * ```
+ */
+class WarmStart {
+private:
+    /// @brief Runs the statements of a tree starting at a given one
+    static bool runFrom(Interpreter& interpreter, ExpressionNode* statement)
+    {
+        for (; statement; statement = statement->getNextSibling()) {
+            Flow flow = interpreter.execute(statement);
+            if (flow == _returnFlow)
+                return true;
+            if (flow != _normalFlow)
+                throw runtime_error("Line " + to_string(statement->getLine()) + ": break or continue outside of a loop");
+        }
+        return false;
+    }
+
+    /// @brief Gets the byte offset where a 1-based source line starts
+    static uint64_t lineOffset(const string& sourceCode, int line)
+    {
+        uint64_t offset = 0;
+        for (int current = 1; current < line; current++) {
+            size_t newLine = sourceCode.find('\n', offset);
+            if (newLine == string::npos)
+                return sourceCode.size();
+            offset = newLine + 1;
+        }
+        return offset;
+    }
+
+    /// @brief Runs the whole program, writing the snapshot after the initialisation
+    static int coldRun(string fileName, string snapshotName)
+    {
+        ifstream fileStream(fileName);
+        if (!fileStream.is_open())
+            throw invalid_argument("Could not open source file " + fileName);
+        stringstream content;
+        content << fileStream.rdbuf();
+        string sourceCode = content.str();
+
+        Tokenizer tokenizer = Tokenizer::fromSource(fileName, sourceCode, false);
+        Parser parser(tokenizer.getTokens(), false);
+        ExpressionNode tree = parser.getTree();
+
+        ExpressionNode* statement = tree.getFirstChild();
+        Interpreter interpreter;
+        interpreter.analyseLifetimes(tree);
+        for (; statement && statement->getTokenType() == _keyWord && statement->getToken() >= _int; statement = statement->getNextSibling())
+            interpreter.execute(statement);
+
+        int resumeLine = statement ? statement->getLine() : 1;
+        uint64_t resumeOffset = statement ? lineOffset(sourceCode, resumeLine) : sourceCode.size();
+        HeapSnapshot::write(snapshotName, interpreter.getGlobals(), fileName, resumeOffset, resumeLine);
+        runFrom(interpreter, statement);
+        return interpreter.getExitStatus();
+    }
+
+public:
+    /**
+     * @brief Interprets a program, taking or using a snapshot of its initialisation
+     *
+     * @param fileName Path of the HoLang source
+     * @param snapshotName Path of the snapshot to use or create
+     * @return The program's exit status
+     * @throws runtime_error and invalid_argument on errors in the program
+     */
+    static int run(string fileName, string snapshotName)
+    {
+        struct stat info;
+        if (stat(snapshotName.c_str(), &info) != 0)
+            return coldRun(fileName, snapshotName);
+
+        HeapSnapshot snapshot(snapshotName);
+        if (!snapshot.matches(fileName))
+            return coldRun(fileName, snapshotName);
+
+        ifstream fileStream(fileName);
+        if (!fileStream.is_open())
+            throw invalid_argument("Could not open source file " + fileName);
+        fileStream.seekg(snapshot.getResumeOffset());
+        stringstream rest;
+        rest << fileStream.rdbuf();
+
+        Tokenizer tokenizer = Tokenizer::fromSource(fileName, rest.str(), false);
+        Parser parser(tokenizer.getTokens(), false, snapshot.getResumeLine());
+        ExpressionNode tree = parser.getTree();
+
+        Interpreter interpreter;
+        interpreter.analyseLifetimes(tree);
+        interpreter.setGlobalFallback([&snapshot](const string& name, Value& value) { return snapshot.load(name, value); });
+        runFrom(interpreter, tree.getFirstChild());
+        return interpreter.getExitStatus();
+    }
+};
@@ -0,0 +1,278 @@
+/**
+ * @file tiering.hpp
+ * @brief Tiered execution: interpret first, continue hot loops as native code (--run --tiered)
+ *
+ * A program starts in the Interpreter right away. A loop that keeps running is
+ * handed to a background thread, which generates C for it (CodeGenerator::tierFunction()),
+ * compiles that with the system C compiler into a shared object and loads it with
+ * dlopen. The next time the loop passes a safe point (an iteration boundary, see
+ * Interpreter::setLoopHook()) the interpreter copies the loop's variables into
+ * slots, calls the native code for the rest of the loop and copies them back.
+ *
+ * HoLang has no functions, so loops are the unit that gets hot; a loop nest is
+ * compiled as a whole once its outer loop is hot. Short runs never pay for a
+ * compile, and long loops run at the speed of the compiled C once it is ready.
+ *
+ * @author HoPiler Project
+ */
+
+#pragma once
+
+#include "codegen.hpp"
+#include "expNode.hpp"
+#include "interpreter.hpp"
+#include "native.hpp"
+#include "tokens.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <dlfcn.h>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+/**
+ * @class TieredCompiler
+ * @brief Compiles an interpreter's hot loops in the background and swaps them in
+ *
+ * A loop is not compiled if it would behave differently as C: when it uses a
+ * string variable from outside (strings cannot cross into the native code) or
+ * divides by anything but a non-zero literal (the interpreter reports division by
+ * zero, C would trap). Loops that fail to compile stay interpreted; nothing about
+ * tiering can change what a program does, only how fast it does it.
+ *
+ * Loaded objects (see NativeBuild) stay loaded until the TieredCompiler is
+ * destroyed, which waits for a compile still in progress.
+ *
+ * Example:
+ * ```
+ * Interpreter interpreter;
+ * TieredCompiler tiers(interpreter);
+ * interpreter.run(tree);
+ * ```
+ */
+class TieredCompiler {
+private:
+    static constexpr int hotChecks = 4; // loop hook calls before a loop counts as hot
+
+    union Slot { // ho_slot of the generated C
+        long long i;
+        double f;
+    };
+    typedef int (*TierFunction)(Slot* slots, int* status);
+
+    enum State { _counting,
+        _compiling,
+        _ready,
+        _failed };
+
+    /**
+     * @struct Loop
+     * @brief Tiering state of one loop
+     *
+     * Written by the interpreter thread until it is queued and by the worker until
+     * it publishes the result through state, so no field is shared unsynchronised.
+     */
+    struct Loop {
+        ExpressionNode* node = nullptr;
+        vector<pair<string, KeyWordType>> variables; // what crosses into the native code, in slot order
+        int checks = 0;
+        atomic<State> state { _counting };
+        TierFunction function = nullptr;
+        void* library = nullptr;
+    };
+
+    Interpreter& interpreter;
+    unordered_map<ExpressionNode*, unique_ptr<Loop>> loops; // interpreter thread only
+    NativeBuild build;
+
+    mutex queueLock;
+    condition_variable queueReady;
+    deque<Loop*> queue;
+    bool stopping = false;
+    thread worker;
+
+    /// @brief Checks whether a divisor is a literal other than zero
+    static bool isSafeDivisor(ExpressionNode* node)
+    {
+        if (node->getTokenType() != _literal || (node->getToken() != _intLit && node->getToken() != _floatLit))
+            return false;
+        return stod(node->getTokenValue()) != 0;
+    }
+
+    /// @brief Collects the names a loop uses and checks that its divisions cannot trap
+    static bool inspect(ExpressionNode* node, vector<string>& names)
+    {
+        if (node->getTokenType() == _identifier)
+            names.push_back(node->getTokenValue());
+        if (node->getTokenType() == _operator && node->getChildCount() == 2) {
+            int op = node->getToken();
+            if ((op == _div || op == _mod || op == _assDiv || op == _assMod) && !isSafeDivisor(node->getFirstChild()->getNextSibling()))
+                return false;
+        }
+        for (ExpressionNode* child = node->getFirstChild(); child; child = child->getNextSibling())
+            if (!inspect(child, names))
+                return false;
+        return true;
+    }
+
+    /**
+     * @brief Decides whether a loop can be compiled and which variables cross over
+     *
+     * Runs on the interpreter thread at a safe point, where every variable the loop
+     * can see from outside is in scope with its current type.
+     */
+    bool prepare(Loop& loop)
+    {
+        vector<string> names;
+        if (!inspect(loop.node, names))
+            return false;
+        for (string& name : names) {
+            Value* value = interpreter.variable(name);
+            if (!value)
+                continue; // declared inside the loop, or true/false
+            if (value->isString())
+                return false;
+            bool known = false;
+            for (auto& variable : loop.variables)
+                known = known || variable.first == name;
+            if (!known)
+                loop.variables.emplace_back(name, value->getType());
+        }
+        return true;
+    }
+
+    /// @brief Generates, compiles and loads one loop; runs on the worker thread
+    void compile(Loop& loop)
+    {
+        try {
+            string code = CodeGenerator::tierFunction(loop.node, loop.variables);
+            loop.library = build.load(code, "loop" + to_string(loop.node->getLine()) + "_" + to_string((uintptr_t)&loop));
+        } catch (const std::exception&) {
+            loop.library = nullptr;
+        }
+        if (loop.library)
+            loop.function = (TierFunction)dlsym(loop.library, "ho_tier");
+        loop.state.store(loop.function ? _ready : _failed, memory_order_release);
+    }
+
+    void work()
+    {
+        while (true) {
+            Loop* loop;
+            {
+                unique_lock<mutex> lock(queueLock);
+                queueReady.wait(lock, [this] { return stopping || !queue.empty(); });
+                if (stopping)
+                    return;
+                loop = queue.front();
+                queue.pop_front();
+            }
+            compile(*loop);
+        }
+    }
+
+    /// @brief Runs the rest of a loop as native code
+    void enter(Loop& loop, Flow& flow)
+    {
+        vector<Value*> values;
+        vector<Slot> slots(loop.variables.size());
+        for (size_t i = 0; i < slots.size(); i++) {
+            values.push_back(interpreter.variable(loop.variables[i].first));
+            if (loop.variables[i].second == _float)
+                slots[i].f = values[i]->asFloat();
+            else
+                slots[i].i = values[i]->asInt();
+        }
+
+        int status = 0;
+        bool returned = loop.function(slots.data(), &status) == 1;
+
+        for (size_t i = 0; i < slots.size(); i++) {
+            switch (loop.variables[i].second) {
+            case _float:
+                *values[i] = Value::fromFloat(slots[i].f);
+                break;
+            case _char:
+                *values[i] = Value::fromChar((char)slots[i].i);
+                break;
+            case _bool:
+                *values[i] = Value::fromBool(slots[i].i != 0);
+                break;
+            default:
+                *values[i] = Value::fromInt(slots[i].i);
+            }
+        }
+        if (returned)
+            interpreter.setExitStatus(status);
+        flow = returned ? _returnFlow : _normalFlow;
+    }
+
+    /// @brief The loop hook: counts, queues and finally enters a loop
+    bool atSafePoint(ExpressionNode* node, Flow& flow)
+    {
+        unique_ptr<Loop>& loop = loops[node];
+        if (!loop) {
+            loop = make_unique<Loop>();
+            loop->node = node;
+        }
+        switch (loop->state.load(memory_order_acquire)) {
+        case _counting:
+            if (++loop->checks < hotChecks)
+                return false;
+            if (!prepare(*loop)) {
+                loop->state.store(_failed, memory_order_relaxed);
+                return false;
+            }
+            loop->state.store(_compiling, memory_order_relaxed);
+            {
+                lock_guard<mutex> lock(queueLock);
+                queue.push_back(loop.get());
+            }
+            queueReady.notify_one();
+            return false;
+        case _ready:
+            enter(*loop, flow);
+            return true;
+        default:
+            return false;
+        }
+    }
+
+public:
+    /**
+     * @brief Constructor - starts the worker and installs the loop hook
+     *
+     * @param interpreter The interpreter whose loops are tiered; it must not run
+     *                    after the TieredCompiler is destroyed
+     * @throws runtime_error if no build directory can be created
+     */
+    TieredCompiler(Interpreter& interpreter)
+        : interpreter(interpreter)
+    {
+        worker = thread(&TieredCompiler::work, this);
+        interpreter.setLoopHook([this](ExpressionNode* node, Flow& flow) { return atSafePoint(node, flow); });
+    }
+
+    TieredCompiler(const TieredCompiler&) = delete;
+    TieredCompiler& operator=(const TieredCompiler&) = delete;
+
+    ~TieredCompiler()
+    {
+        interpreter.setLoopHook(nullptr);
+        {
+            lock_guard<mutex> lock(queueLock);
+            stopping = true;
+        }
+        queueReady.notify_one();
+        worker.join();
+        for (auto& [node, loop] : loops)
+            if (loop->library)
+                dlclose(loop->library);
+    }
+};
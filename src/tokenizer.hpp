@@ -19,6 +19,8 @@
 #pragma once
 
 #include "tokens.hpp"
+#include "utf8.hpp"
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 #include <sstream>
@@ -53,6 +55,23 @@ class Tokenizer {
 private:
     string fileName;
     vector<Token> tokens;
+    bool verbose = true;
+
+    /**
+     * @struct CommentSpan
+     * @brief Where the text of a comment (after the #) lies in the source
+     */
+    struct CommentSpan {
+        size_t offset;
+        size_t length;
+    };
+
+    bool keepComments = false; // record comment spans; off, comments are skipped without a trace
+    string source; // kept only with keepComments, the spans point into it
+    vector<CommentSpan> comments;
+
+    /// @brief Empty constructor used by fromSource(); does not tokenize anything
+    Tokenizer() { }
 
     /**
      * @brief Reads the entire source file into memory
@@ -80,7 +99,7 @@ private:
      * 
      * @param currentToken The token string to parse
      * @return A Token object of the appropriate type (keyword, operator, literal, etc.)
-     * @throws invalid_argument if the token is not recognized or is malformed
+     * @throws SyntaxError if the token is not recognized or is malformed
      * 
      * This method identifies what type of token the string represents and creates
      * the corresponding Token object. It handles:
@@ -200,14 +219,14 @@ private:
             for (char x : currentToken) {
                 if (!(isdigit(x) || x == '.')) {
                     cerr << "Invalid number(float/int) literal.\n";
-                    throw invalid_argument("Invalid number(float/int) literal.");
+                    throw SyntaxError("Invalid number(float/int) literal.");
                 }
                 if (x == '.')
                     totalDecimals++;
             }
             if (!(totalDecimals == 0 || totalDecimals == 1)) {
                 cerr << "Invalid number(float/int) literal. Only one or zero . is permitted\n";
-                throw invalid_argument("Invalid number(float/int) literal. Only one or zero . is permitted\n");
+                throw SyntaxError("Invalid number(float/int) literal. Only one or zero . is permitted\n");
             }
             LiteralType type = totalDecimals == 0 ? _intLit : _floatLit;
             return Token(type, currentToken);
@@ -215,7 +234,7 @@ private:
             for (char x : currentToken) {
                 if (!(x == '_' || isalnum(x))) {
                     cerr << "Identifiers must always start with a _ or an alphabet and contain only _ or alphabet or digits\n";
-                    throw invalid_argument("Identifiers must always start with a _ or an alphabet and contain only _ or alphabet or digits\n");
+                    throw SyntaxError("Identifiers must always start with a _ or an alphabet and contain only _ or alphabet or digits\n");
                 }
             }
             return Token::identifier(currentToken);
@@ -223,31 +242,51 @@ private:
 
         // return Token(currentToken);
         cerr << "The given token('" << currentToken << "') is invalid";
-        throw invalid_argument("The given token('" + currentToken + "') is invalid");
+        throw SyntaxError("The given token('" + currentToken + "') is invalid");
+    }
+
+    /**
+     * @brief Checks that the text of a literal or comment is valid UTF-8
+     *
+     * @param sourceCode The source being tokenized
+     * @param start First byte of the text
+     * @param end One past its last byte
+     * @param what What the text is, for the error message
+     * @throws SyntaxError naming the line if it is not valid UTF-8
+     */
+    static void validateUtf8(const string& sourceCode, size_t start, size_t end, string what)
+    {
+        if (Utf8::isValid(sourceCode.data() + start, end - start))
+            return;
+        int line = 1 + count(sourceCode.begin(), sourceCode.begin() + start, '\n');
+        cerr << "Invalid UTF-8 in " << what << " on line " << line << ".";
+        throw SyntaxError("Line " + to_string(line) + ": invalid UTF-8 in " + what);
     }
 
     /**
      * @brief Main tokenization loop - converts source code to token stream
      * 
+     * @param sourceCode The complete source text to tokenize
+     * 
      * This method implements the core tokenization algorithm that:
-     * 1. Reads the entire source code via readCode()
+     * 1. Takes the source code (read via readCode() or handed in by fromSource())
      * 2. Iterates through each character
-     * 3. Maintains parsing state flags for comments, strings, characters, and escape sequences
+     * 3. Maintains parsing state flags for strings, characters, and escape sequences
      * 4. Accumulates characters into tokens
      * 5. Calls parseCurrentToken() when token boundaries are reached
      * 6. Produces tokens representing:
      *    - Keywords, operators, delimiters, literals, identifiers
-     *    - Comments and whitespace
+     *    - Whitespace
      * 
      * State tracking:
      * - escapeMode: True when the previous character was a backslash
-     * - commentMode: True when parsing a comment (until end of line)
      * - stringMode: True when parsing a string literal (between quotes)
      * - charMode: True when parsing a character literal (between single quotes)
      * 
      * Special handling:
      * - Escape sequences: \\n, \\t, \\r, \\b, \\v, \\f, \\0, \\', \\", \\\\
-     * - Comments: Start with # and continue until newline
+     * - Comments: Start with # and continue until newline; the rest of the line is skipped
+     *   with one newline search and produces no token (only a span when keepComments is set)
      * - Strings: Enclosed in double quotes, can contain escape sequences
      * - Characters: Enclosed in single quotes, must be exactly 1 character (or escape sequence)
      * - Newlines: Act as statement delimiters in the language
@@ -261,18 +300,22 @@ private:
      * @note The method clears the tokens vector at the start
      * @note Errors are caught and printed but don't stop tokenization
      */
-    void _getTokens()
+    void _getTokens(string sourceCode)
     {
-        string sourceCode = readCode();
         string currentToken;
         char current;
 
         tokens.clear();
+        comments.clear();
+        if (keepComments)
+            source = sourceCode;
 
         bool escapeMode = false; // true if any escape character present
-        bool commentMode = false; // true if currently parsing a comment
         bool stringMode = false; // true if currently parsing a string
         bool charMode = false; // true if currently parsing a character
+        bool literalEscaped = false; // true if the literal being read has a byte C needs escaped
+        bool ascii = Utf8::isAscii(sourceCode.data(), sourceCode.size()); // then no span needs UTF-8 validation
+        size_t spanStart = 0; // where the text of the current literal starts
 
         for (int i = 0; i < sourceCode.length(); i++) {
             char current = sourceCode.at(i);
@@ -282,49 +325,63 @@ private:
                 continue;
             }
 
-            if (current == '#' && !(stringMode || charMode || commentMode)) {
+            if (current == '#' && !(stringMode || charMode)) {
                 currentToken.clear(); // TODO: have better error handling, this will cause problems in future, here just for initial testing purposes
-                commentMode = true;
+                size_t end = sourceCode.find('\n', i + 1);
+                if (end == string::npos)
+                    end = sourceCode.size();
+                if (!ascii)
+                    validateUtf8(sourceCode, i + 1, end, "a comment");
+                if (keepComments)
+                    comments.push_back({ (size_t)i + 1, end - i - 1 });
+                i = end - 1; // the newline ending the comment is handled as usual
                 continue;
-            } // if # is found and we are not parsing a string, then the current token is a comment, so comment mode is turned on.
+            } // if # is found and we are not parsing a string, the rest of the line is a comment: skipped in one step, it never becomes a token
 
-            if (current == '"' && !(commentMode || charMode || escapeMode)) {
+            if (current == '"' && !(charMode || escapeMode)) {
                 if (stringMode) {
                     stringMode = false;
+                    if (!ascii)
+                        validateUtf8(sourceCode, spanStart, i, "a string literal");
                     tokens.push_back(Token(LiteralType { _stringLit }, currentToken));
+                    tokens.back().setEscaped(literalEscaped);
                     currentToken.clear();
                     continue;
                     // if stringmode is on and " is found, it means the string is ending
                 } else {
                     currentToken.clear(); // TODO: have better error handling, this will cause problems in future, here just for initial testing purposes
                     stringMode = true;
+                    literalEscaped = false;
+                    spanStart = i + 1;
                     // starting to parse a string
                     continue;
                 }
             } // if " is found and we are not parsing a comment, then the current token is a string, so string mode is turned on. there are two possibilities, either the string is starting or ending, both cases are handled inside the code.
 
-            if (current == '\'' && !(commentMode || stringMode || escapeMode)) {
+            if (current == '\'' && !(stringMode || escapeMode)) {
                 if (charMode) {
                     charMode = false;
+                    if (!ascii)
+                        validateUtf8(sourceCode, spanStart, i, "a char literal");
                     if (currentToken.length() != 1 && !(currentToken.length() == 2 && currentToken.at(0) == '\\')) {
                         cerr << "The length of a character should exactly be 1.";
-                        throw invalid_argument("The length of the character should exactly be 1.");
+                        throw SyntaxError("The length of the character should exactly be 1.");
                     } // if the given character token does not have one character, then it is invalid.
                     tokens.push_back(Token(LiteralType { _charLit }, currentToken));
+                    tokens.back().setEscaped(literalEscaped);
                     currentToken.clear();
                     continue;
                 } else {
                     currentToken.clear(); // TODO: have better error handling, this will cause problems in future, here just for initial testing purposes
                     charMode = true;
+                    literalEscaped = false;
+                    spanStart = i + 1;
                     continue;
                 }
             } // same logic used for string parsing
 
             if (current == '\n') {
-                if (commentMode) {
-                    commentMode = false;
-                    tokens.push_back(Token(currentToken));
-                } else if (!(commentMode || charMode || stringMode || currentToken.empty())) {
+                if (!(charMode || stringMode || currentToken.empty())) {
                     try {
                         tokens.push_back(parseCurrentToken(currentToken));
                     } catch (const std::exception& e) {
@@ -335,12 +392,10 @@ private:
                 currentToken.clear();
             } // terminating a comment and any leftover token
 
-            if (!(commentMode || charMode || stringMode) && (current == '\t' || current == ' ' || current == '\n')) {
-                WhiteSpaceType type = _tab;
-                if (current == ' ') {
-                    type = _space;
-                    tokens.push_back(parseCurrentToken(currentToken));
-                }
+            if (!(charMode || stringMode) && (current == '\t' || current == ' ' || current == '\n')) {
+                WhiteSpaceType type = current == ' ' ? _space : _tab;
+                if (!currentToken.empty())
+                    tokens.push_back(parseCurrentToken(currentToken)); // indentation and runs of spaces leave nothing to parse
                 tokens.push_back(Token(type));
                 currentToken.clear();
                 continue;
@@ -376,14 +431,16 @@ private:
                     break;
                 default:
                     cerr << "Invalid character after \\ (escape character).";
-                    throw invalid_argument("Invalid character after \\ (escape character).");
+                    throw SyntaxError("Invalid character after \\ (escape character).");
                 }
                 escapeMode = false;
             } // formatting escape characters
 
             currentToken.push_back(current); // pushing the current character to the
+            if (stringMode || charMode)
+                literalEscaped = literalEscaped || Token::needsCEscape(current, stringMode ? '"' : '\''); // decided once here, so the code generator can copy plain literals
 
-            if (!(commentMode || stringMode || charMode)) {
+            if (!(stringMode || charMode)) {
                 WhiteSpaceType whitespace;
                 switch (current) {
                 case '\n':
@@ -403,10 +460,7 @@ private:
             } // parsing whitespace tokens
         }
 
-        if (commentMode) {
-            commentMode = false;
-            tokens.push_back(Token(currentToken));
-        } else if (!(commentMode || charMode || stringMode || currentToken.empty())) {
+        if (!(charMode || stringMode || currentToken.empty())) {
             try {
                 tokens.push_back(parseCurrentToken(currentToken));
             } catch (const std::exception& e) {
@@ -420,6 +474,8 @@ public:
      * @brief Constructor - initializes tokenizer and tokenizes the input file
      * 
      * @param fileName Path to the HoPiler source file to tokenize (.ho extension expected)
+     * @param verbose If false, the initialization message and token dump are not printed
+     * @param keepComments If true, the comments are recorded for getComments()
      * 
      * Upon construction:
      * 1. Stores the filename
@@ -429,13 +485,46 @@ public:
      * 
      * Example: Tokenizer tokenizer("program.ho");
      */
-    Tokenizer(string fileName)
+    Tokenizer(string fileName, bool verbose = true, bool keepComments = false)
     {
         this->fileName = fileName;
-        cout << "Initialized Tokenizer" << endl;
-        this->_getTokens();
-        cout << "Tokens generated:" << endl;
-        printTokens();
+        this->verbose = verbose;
+        this->keepComments = keepComments;
+        if (verbose)
+            cout << "Initialized Tokenizer" << endl;
+        this->_getTokens(readCode());
+        if (verbose) {
+            cout << "Tokens generated:" << endl;
+            printTokens();
+        }
+    }
+
+    /**
+     * @brief Factory method to tokenize source code that is already in memory
+     * 
+     * @param fileName Name used to identify the source (not read from disk)
+     * @param sourceCode The complete source text to tokenize
+     * @param verbose If true, prints the generated tokens like the file constructor does
+     * @param keepComments If true, the comments are recorded for getComments()
+     * @return A Tokenizer holding the tokens of sourceCode
+     * 
+     * Used by batch mode, which has already read every input to hash it and
+     * should not hit the disk a second time.
+     * 
+     * Example: Tokenizer tokenizer = Tokenizer::fromSource("a.ho", "int x = 5");
+     */
+    static Tokenizer fromSource(string fileName, string sourceCode, bool verbose = true, bool keepComments = false)
+    {
+        Tokenizer tokenizer;
+        tokenizer.fileName = fileName;
+        tokenizer.verbose = verbose;
+        tokenizer.keepComments = keepComments;
+        tokenizer._getTokens(sourceCode);
+        if (verbose) {
+            cout << "Tokens generated:" << endl;
+            tokenizer.printTokens();
+        }
+        return tokenizer;
     }
 
     /**
@@ -451,11 +540,27 @@ public:
         return this->tokens;
     }
 
+    /**
+     * @brief Gets the text of every comment, without the #, in source order
+     *
+     * @return The comments; empty unless the tokenizer was created with keepComments
+     *
+     * Comments never become tokens, so tools that need them (documentation, formatting)
+     * ask for them here. The texts are built from the recorded spans on demand.
+     */
+    vector<string> getComments()
+    {
+        vector<string> texts;
+        texts.reserve(comments.size());
+        for (CommentSpan& comment : comments)
+            texts.push_back(source.substr(comment.offset, comment.length));
+        return texts;
+    }
+
     /**
      * @brief Prints all tokens to standard output in human-readable format
      * 
      * Iterates through all tokens and prints information about each:
-     * - Comments: "Comment: [value]"
      * - Literals: "Literal: [value]"
      * - Whitespace: "Whitespace Type enum: [enum value]"
      * - Keywords: "Keyword type: [enum value]"
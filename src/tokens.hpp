@@ -3,6 +3,7 @@
  * @brief Defines all token-related enumerations and classes for the HoPiler transpiler
  * 
  * This header file contains:
+ * - SyntaxError: the exception the Tokenizer and Parser throw
  * - Token type enumerations (TokenType, KeyWordType, LiteralType, etc.)
  * - _Token: Low-level token representation struct
  * - Token: High-level wrapper class for managing different token types
@@ -15,9 +16,22 @@
 
 #pragma once
 
+#include <stdexcept>
 #include <string>
 using namespace std;
 
+/**
+ * @class SyntaxError
+ * @brief An error in the source found by the Tokenizer or Parser
+ *
+ * Both print the message to stderr before they throw, so whoever catches one only
+ * has to fail, not report it again.
+ */
+class SyntaxError : public invalid_argument {
+public:
+    using invalid_argument::invalid_argument;
+};
+
 enum TokenType { _keyWord,
     _identifier,
     _literal,
@@ -151,12 +165,14 @@ public:
 class Token {
 private:
     TokenType tokenType;
-    KeyWordType keywordType;
-    LiteralType literalType;
-    OperatorType operatorType;
-    DelimiterType delimiterType;
-    WhiteSpaceType whiteSpaceType;
+    KeyWordType keywordType = _if;
+    LiteralType literalType = _intLit;
+    OperatorType operatorType = _add;
+    DelimiterType delimiterType = _bracketOpen;
+    WhiteSpaceType whiteSpaceType = _space;
     string token;
+    int line = 0;
+    bool escaped = true; // string and char literals: some byte needs an escape in C (assumed unless the lexer says otherwise)
 
 public:
     // Associativity for operators
@@ -237,7 +253,7 @@ public:
      */
     _Token get()
     {
-        int token;
+        int token = 0;
         switch (this->tokenType) {
         case _keyWord:
             token = this->keywordType;
@@ -287,11 +303,45 @@ public:
      */
     int getPriority() const
     {
-        // this method was generated by ai 
         if (this->tokenType != _operator) {
             return 0;
         }
-        switch (this->operatorType) {
+        return priorityOf(this->operatorType);
+    }
+
+    /**
+     * @brief Gets the associativity of this operator token
+     * 
+     * @return The associativity direction (left-to-right, right-to-left, or non-associative)
+     * 
+     * Associativity rules:
+     * - Right-associative: Power, NOT, all assignment operators
+     * - Left-associative: Most binary operators (arithmetic, comparison, logical)
+     * - Non-associative: Non-operator tokens
+     * 
+     * This is used during expression parsing to determine evaluation order when multiple
+     * operators of the same precedence are present.
+     * 
+     * @note This method was typically generated by AI
+     */
+    Associativity getAssociativity() const
+    {
+        if (this->tokenType != _operator) {
+            return NonAssoc;
+        }
+        return associativityOf(this->operatorType);
+    }
+
+    /**
+     * @brief Gets the precedence of an operator, see getPriority()
+     * 
+     * constexpr so that the compile-time parser (embedded.hpp) climbs with the
+     * same table as Parser.
+     */
+    static constexpr int priorityOf(OperatorType operatorType)
+    {
+        // this method was generated by ai 
+        switch (operatorType) {
         case _pow:
             return 80;
         case _mul:
@@ -330,28 +380,11 @@ public:
         }
     }
 
-    /**
-     * @brief Gets the associativity of this operator token
-     * 
-     * @return The associativity direction (left-to-right, right-to-left, or non-associative)
-     * 
-     * Associativity rules:
-     * - Right-associative: Power, NOT, all assignment operators
-     * - Left-associative: Most binary operators (arithmetic, comparison, logical)
-     * - Non-associative: Non-operator tokens
-     * 
-     * This is used during expression parsing to determine evaluation order when multiple
-     * operators of the same precedence are present.
-     * 
-     * @note This method was typically generated by AI
-     */
-    Associativity getAssociativity() const
+    /// @brief Gets the associativity of an operator, see getAssociativity()
+    static constexpr Associativity associativityOf(OperatorType operatorType)
     {
         // this method was generated by ai 
-        if (this->tokenType != _operator) {
-            return NonAssoc;
-        }
-        switch (this->operatorType) {
+        switch (operatorType) {
         // right-associative operators
         case _pow:
         case _not:
@@ -384,6 +417,47 @@ public:
         }
     }
 
+    /**
+     * @brief Checks whether a byte of a literal has to be escaped in C
+     *
+     * @param c The decoded byte
+     * @param quote The quote of the C literal it goes into (" or ')
+     */
+    static bool needsCEscape(unsigned char c, char quote)
+    {
+        return c < 0x20 || c == 0x7f || c == '\\' || c == (unsigned char)quote;
+    }
+
+    /// @brief Records whether a string or char literal contains a byte that needs escaping in C
+    void setEscaped(bool escaped)
+    {
+        this->escaped = escaped;
+    }
+
+    /// @brief Checks whether a literal has to be escaped for C, or can be copied as it is
+    bool isEscaped() const
+    {
+        return this->escaped;
+    }
+
+    /// @brief Gets the text of the token (the decoded value of a literal) without copying it
+    const string& getText() const
+    {
+        return this->token;
+    }
+
+    /// @brief Sets the source line the token was read from (1-based)
+    void setLine(int line)
+    {
+        this->line = line;
+    }
+
+    /// @brief Gets the source line the token was read from, or 0 if unknown
+    int getLine() const
+    {
+        return this->line;
+    }
+
     /**
      * @brief Factory method to create identifier tokens
      * 
@@ -0,0 +1,222 @@
+/**
+ * @file utf8.hpp
+ * @brief Vectorized UTF-8 validation for the tokenizer
+ *
+ * String and char literals and comments are the only places where a HoLang source
+ * can hold non-ASCII bytes, and literals are copied into the generated C. The
+ * Tokenizer checks those spans with Utf8::isValid() so that invalid UTF-8 is
+ * reported at the source instead of ending up in the C.
+ *
+ * Two levels keep the common case cheap:
+ * - isAscii() tests 16 bytes per step (SSE2 is part of x86-64, so it needs no
+ *   dispatch); a source that is all ASCII skips validation altogether
+ * - isValid() uses the lookup algorithm of simdjson/simdutf (Keiser and Lemire,
+ *   "Validating UTF-8 In Less Than One Instruction Per Byte") with SSSE3 shuffles,
+ *   picked at run time, and a scalar decoder elsewhere
+ *
+ * @author HoPiler Project
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HO_UTF8_X86
+#endif
+
+using namespace std;
+
+/**
+ * @class Utf8
+ * @brief ASCII and UTF-8 checks over byte spans
+ *
+ * The vector validator looks at each 16-byte block together with the last three
+ * bytes of the previous one. Three table lookups (on the high nibble of the
+ * previous byte, its low nibble and the high nibble of the current byte) flag
+ * every two-byte pattern that cannot occur in UTF-8: overlong forms, surrogates,
+ * code points above U+10FFFF, a lead byte without continuation or a continuation
+ * without lead. Whether the third and fourth byte of a sequence must be a
+ * continuation is checked separately, and a sequence cut off at the end of the
+ * span is an error too. Errors are OR-ed together and tested once at the end.
+ *
+ * Example:
+ * ```
+ * if (!Utf8::isAscii(text.data(), text.size()) && !Utf8::isValid(text.data(), text.size()))
+ *     throw invalid_argument("invalid UTF-8");
+ * ```
+ */
+class Utf8 {
+private:
+#ifdef HO_UTF8_X86
+    // Error bits of the lookup tables; a byte pair is invalid when all three lookups share a bit
+    static constexpr uint8_t tooShort = 1 << 0; // lead byte followed by a lead or ASCII
+    static constexpr uint8_t tooLong = 1 << 1; // ASCII followed by a continuation
+    static constexpr uint8_t overlong3 = 1 << 2;
+    static constexpr uint8_t tooLarge = 1 << 3;
+    static constexpr uint8_t surrogate = 1 << 4;
+    static constexpr uint8_t overlong2 = 1 << 5;
+    static constexpr uint8_t tooLarge1000 = 1 << 6;
+    static constexpr uint8_t overlong4 = 1 << 6;
+    static constexpr uint8_t twoContinuations = 1 << 7;
+    static constexpr uint8_t carry = tooShort | tooLong | twoContinuations; // decided by the high nibble alone
+
+    __attribute__((target("ssse3"))) static __m128i lookup(__m128i table, __m128i nibbles)
+    {
+        return _mm_shuffle_epi8(table, nibbles);
+    }
+
+    __attribute__((target("ssse3"))) static __m128i highNibbles(__m128i bytes)
+    {
+        return _mm_and_si128(_mm_srli_epi16(bytes, 4), _mm_set1_epi8(0x0F));
+    }
+
+    /// @brief Gets the errors of one block, given the block before it
+    __attribute__((target("ssse3"))) static __m128i blockErrors(__m128i input, __m128i previous)
+    {
+        const __m128i byte1HighTable = _mm_setr_epi8(
+            tooLong, tooLong, tooLong, tooLong, tooLong, tooLong, tooLong, tooLong, // 0___ ASCII
+            twoContinuations, twoContinuations, twoContinuations, twoContinuations, // 10__ continuation
+            tooShort | overlong2, // 1100
+            tooShort, // 1101
+            tooShort | overlong3 | surrogate, // 1110
+            tooShort | tooLarge | tooLarge1000 | overlong4); // 1111
+        const __m128i byte1LowTable = _mm_setr_epi8(
+            carry | overlong3 | overlong2 | overlong4, // ____0000
+            carry | overlong2, // ____0001
+            carry, carry, // ____001_
+            carry | tooLarge, // ____0100
+            carry | tooLarge | tooLarge1000, carry | tooLarge | tooLarge1000, carry | tooLarge | tooLarge1000,
+            carry | tooLarge | tooLarge1000, carry | tooLarge | tooLarge1000, carry | tooLarge | tooLarge1000,
+            carry | tooLarge | tooLarge1000, carry | tooLarge | tooLarge1000,
+            carry | tooLarge | tooLarge1000 | surrogate, // ____1101
+            carry | tooLarge | tooLarge1000, carry | tooLarge | tooLarge1000);
+        const __m128i byte2HighTable = _mm_setr_epi8(
+            tooShort, tooShort, tooShort, tooShort, tooShort, tooShort, tooShort, tooShort, // 0___ ASCII
+            tooLong | overlong2 | twoContinuations | overlong3 | tooLarge1000 | overlong4, // 1000
+            tooLong | overlong2 | twoContinuations | overlong3 | tooLarge, // 1001
+            tooLong | overlong2 | twoContinuations | surrogate | tooLarge, // 1010
+            tooLong | overlong2 | twoContinuations | surrogate | tooLarge, // 1011
+            tooShort, tooShort, tooShort, tooShort); // 11__ lead
+
+        __m128i previous1 = _mm_alignr_epi8(input, previous, 15);
+        __m128i special = _mm_and_si128(_mm_and_si128(lookup(byte1HighTable, highNibbles(previous1)),
+                                            lookup(byte1LowTable, _mm_and_si128(previous1, _mm_set1_epi8(0x0F)))),
+            lookup(byte2HighTable, highNibbles(input)));
+
+        __m128i previous2 = _mm_alignr_epi8(input, previous, 14);
+        __m128i previous3 = _mm_alignr_epi8(input, previous, 13);
+        __m128i thirdByte = _mm_subs_epu8(previous2, _mm_set1_epi8((char)(0xE0 - 0x80))); // only 111_____ reaches 0x80
+        __m128i fourthByte = _mm_subs_epu8(previous3, _mm_set1_epi8((char)(0xF0 - 0x80))); // only 1111____ reaches 0x80
+        __m128i mustContinue = _mm_and_si128(_mm_or_si128(thirdByte, fourthByte), _mm_set1_epi8((char)0x80));
+        return _mm_xor_si128(mustContinue, special);
+    }
+
+    /// @brief Gets non-zero lanes where a sequence starting in the block's last three bytes is cut off
+    __attribute__((target("ssse3"))) static __m128i incompleteAtEnd(__m128i input)
+    {
+        const __m128i limit = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+            (char)(0xF0 - 1), (char)(0xE0 - 1), (char)(0xC0 - 1));
+        return _mm_subs_epu8(input, limit);
+    }
+
+    __attribute__((target("ssse3"))) static bool isValidSsse3(const unsigned char* data, size_t length)
+    {
+        __m128i error = _mm_setzero_si128(), previous = _mm_setzero_si128(), previousIncomplete = _mm_setzero_si128();
+        for (size_t i = 0; i < length; i += 16) {
+            __m128i input;
+            if (i + 16 <= length) {
+                input = _mm_loadu_si128((const __m128i*)(data + i));
+            } else {
+                unsigned char tail[16] = {}; // ASCII padding ends any cut-off sequence with an error
+                memcpy(tail, data + i, length - i);
+                input = _mm_loadu_si128((const __m128i*)tail);
+            }
+            if (_mm_movemask_epi8(input) == 0) {
+                error = _mm_or_si128(error, previousIncomplete);
+            } else {
+                error = _mm_or_si128(error, blockErrors(input, previous));
+                previousIncomplete = incompleteAtEnd(input);
+            }
+            previous = input;
+        }
+        error = _mm_or_si128(error, previousIncomplete);
+        return _mm_movemask_epi8(_mm_cmpeq_epi8(error, _mm_setzero_si128())) == 0xFFFF;
+    }
+
+    static bool hasSsse3()
+    {
+        static const bool supported = __builtin_cpu_supports("ssse3");
+        return supported;
+    }
+#endif
+
+public:
+    /// @brief Validates with a plain decoder, one sequence at a time; constexpr for embedded.hpp
+    static constexpr bool isValidScalar(const char* data, size_t length)
+    {
+        for (size_t i = 0; i < length;) {
+            unsigned char lead = (unsigned char)data[i];
+            if (lead < 0x80) {
+                i++;
+                continue;
+            }
+            size_t size = 0;
+            if (lead >= 0xC2 && lead <= 0xDF)
+                size = 2;
+            else if (lead >= 0xE0 && lead <= 0xEF)
+                size = 3;
+            else if (lead >= 0xF0 && lead <= 0xF4)
+                size = 4;
+            if (size == 0 || i + size > length)
+                return false;
+            for (size_t j = 1; j < size; j++)
+                if (((unsigned char)data[i + j] & 0xC0) != 0x80)
+                    return false;
+            unsigned char second = (unsigned char)data[i + 1];
+            if ((lead == 0xE0 && second < 0xA0) || (lead == 0xED && second > 0x9F) // overlong, surrogate
+                || (lead == 0xF0 && second < 0x90) || (lead == 0xF4 && second > 0x8F)) // overlong, above U+10FFFF
+                return false;
+            i += size;
+        }
+        return true;
+    }
+
+    /// @brief Checks whether a span holds only ASCII bytes
+    static bool isAscii(const char* data, size_t length)
+    {
+        size_t i = 0;
+#ifdef HO_UTF8_X86
+        __m128i seen = _mm_setzero_si128();
+        for (; i + 16 <= length; i += 16)
+            seen = _mm_or_si128(seen, _mm_loadu_si128((const __m128i*)(data + i)));
+        if (_mm_movemask_epi8(seen) != 0)
+            return false;
+#endif
+        for (; i + 8 <= length; i += 8) {
+            uint64_t word;
+            memcpy(&word, data + i, 8);
+            if (word & 0x8080808080808080ULL)
+                return false;
+        }
+        for (; i < length; i++)
+            if ((unsigned char)data[i] >= 0x80)
+                return false;
+        return true;
+    }
+
+    /// @brief Checks whether a span is valid UTF-8 (ASCII spans take the fast path)
+    static bool isValid(const char* data, size_t length)
+    {
+        if (isAscii(data, length))
+            return true;
+#ifdef HO_UTF8_X86
+        if (hasSsse3())
+            return isValidSsse3((const unsigned char*)data, length);
+#endif
+        return isValidScalar(data, length);
+    }
+};
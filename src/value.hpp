@@ -0,0 +1,372 @@
+/**
+ * @file value.hpp
+ * @brief NaN-boxed run-time values of the interpreter
+ *
+ * Every HoLang value fits in 8 bytes. A double is stored as itself; everything else
+ * is hidden in the payload of a negative quiet NaN, which no arithmetic result can
+ * produce once NaNs are canonicalised:
+ *
+ * ```
+ *  63      51 50  48 47                                            0
+ * [1 11111111111 1][tag][                 payload (48 bits)        ]
+ * ```
+ *
+ * | tag | meaning   | payload                                   |
+ * |-----|-----------|-------------------------------------------|
+ * | 1   | int       | the value, sign-extended from 48 bits     |
+ * | 2   | char      | the character, sign-extended              |
+ * | 3   | bool      | 0 or 1                                    |
+ * | 4   | string    | pointer to a HeapCell holding the text    |
+ * | 5   | large int | pointer to a HeapCell holding the int     |
+ *
+ * HoLang ints are 64-bit like the generated C; the rare ones that need more than
+ * 48 bits are boxed (tag 5) instead of losing precision. Heap cells are reference
+ * counted, so copying a Value is a bit copy plus, for pointers only, an increment.
+ * A string can also be made in a Region: its cell is pinned (never counted) and
+ * lives exactly as long as the region, which the interpreter guarantees outlasts it.
+ *
+ * @author HoPiler Project
+ */
+
+#pragma once
+
+#include "region.hpp"
+#include "tokens.hpp"
+#include <cstdint>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+using namespace std;
+
+/**
+ * @struct HeapCell
+ * @brief Out-of-line part of a string or large int Value
+ *
+ * The characters of a string follow the cell in the same allocation, so a string
+ * costs one allocation and the cell is trivially destructible (region-safe).
+ */
+struct HeapCell {
+    static constexpr size_t pinned = SIZE_MAX; // reference count of a cell owned by a Region
+
+    size_t references;
+    long long integer;
+    size_t length;
+
+    char* text()
+    {
+        return (char*)(this + 1);
+    }
+
+    /// @brief Allocates a cell with room for length characters, on the heap or in a region
+    static HeapCell* allocate(size_t length, Region* region)
+    {
+        size_t size = sizeof(HeapCell) + length;
+        HeapCell* cell = (HeapCell*)(region ? region->allocate(size) : ::operator new(size));
+        cell->references = region ? pinned : 1;
+        cell->integer = 0;
+        cell->length = length;
+        return cell;
+    }
+
+    /// @brief Frees a cell from the heap; cells in a region go with the region
+    static void free(HeapCell* cell)
+    {
+        if (cell->references == pinned)
+            return;
+        ::operator delete(cell);
+    }
+};
+
+/**
+ * @class Value
+ * @brief A HoLang value at run time, one 64-bit word
+ *
+ * Type checks are bit tests on the word: isFloat() is one mask and compare,
+ * bothInts() compares the top 16 bits of two words at once, which is what
+ * the interpreter's arithmetic fast path uses.
+ *
+ * Example:
+ * ```
+ * Value sum = Value::fromInt(40);
+ * if (Value::bothInts(sum, other)) ...
+ * ```
+ */
+class Value {
+private:
+    static constexpr uint64_t boxedMask = 0xFFF8000000000000ULL;
+    static constexpr int tagShift = 48;
+    static constexpr uint64_t payloadMask = (1ULL << tagShift) - 1;
+    static constexpr uint64_t canonicalNaN = 0x7FF8000000000000ULL;
+    static constexpr long long smallIntLimit = 1LL << 47;
+
+    enum Tag { _intTag = 1,
+        _charTag,
+        _boolTag,
+        _stringTag,
+        _largeIntTag };
+
+    uint64_t bits;
+
+    explicit Value(uint64_t bits)
+        : bits(bits)
+    {
+    }
+
+    static constexpr uint64_t box(uint64_t tag, uint64_t payload)
+    {
+        return boxedMask | tag << tagShift | (payload & payloadMask);
+    }
+
+    bool isBoxed() const
+    {
+        return (bits & boxedMask) == boxedMask;
+    }
+
+    uint64_t tag() const
+    {
+        return (bits >> tagShift) & 7;
+    }
+
+    bool isPointer() const
+    {
+        return isBoxed() && tag() >= _stringTag;
+    }
+
+    HeapCell* cell() const
+    {
+        return (HeapCell*)(uintptr_t)(bits & payloadMask);
+    }
+
+    long long payload() const
+    {
+        return (long long)(bits << (64 - tagShift)) >> (64 - tagShift);
+    }
+
+    /// @brief Boxes a heap cell; user-space pointers fit in the 48-bit payload
+    static Value fromCell(HeapCell* cell, Tag tag)
+    {
+        if ((uintptr_t)cell & ~payloadMask) {
+            HeapCell::free(cell);
+            throw runtime_error("Heap address does not fit in a NaN-boxed value");
+        }
+        return Value(box(tag, (uintptr_t)cell));
+    }
+
+    void retain() const
+    {
+        if (isPointer() && cell()->references != HeapCell::pinned)
+            cell()->references++;
+    }
+
+    void release() const
+    {
+        if (isPointer() && cell()->references != HeapCell::pinned && --cell()->references == 0)
+            HeapCell::free(cell());
+    }
+
+public:
+    /// @brief Constructor - the int 0
+    Value()
+        : bits(box(_intTag, 0))
+    {
+    }
+
+    Value(const Value& other)
+        : bits(other.bits)
+    {
+        retain();
+    }
+
+    Value(Value&& other) noexcept
+        : bits(other.bits)
+    {
+        other.bits = box(_intTag, 0);
+    }
+
+    Value& operator=(const Value& other)
+    {
+        other.retain();
+        release();
+        bits = other.bits;
+        return *this;
+    }
+
+    Value& operator=(Value&& other) noexcept
+    {
+        if (this != &other) {
+            release();
+            bits = other.bits;
+            other.bits = box(_intTag, 0);
+        }
+        return *this;
+    }
+
+    ~Value()
+    {
+        release();
+    }
+
+    static Value fromInt(long long value)
+    {
+        if (value >= -smallIntLimit && value < smallIntLimit)
+            return Value(box(_intTag, (uint64_t)value));
+        HeapCell* cell = HeapCell::allocate(0, nullptr);
+        cell->integer = value;
+        return fromCell(cell, _largeIntTag);
+    }
+
+    static Value fromFloat(double value)
+    {
+        uint64_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        return Value(value != value ? canonicalNaN : bits);
+    }
+
+    static Value fromChar(char value)
+    {
+        return Value(box(_charTag, (uint64_t)(long long)value));
+    }
+
+    static Value fromBool(bool value)
+    {
+        return Value(box(_boolTag, value));
+    }
+
+    /**
+     * @brief Makes a string
+     *
+     * @param text The characters, copied into the cell
+     * @param region Where the cell goes; nullptr for a reference-counted heap cell
+     */
+    static Value fromString(string_view text, Region* region = nullptr)
+    {
+        HeapCell* cell = HeapCell::allocate(text.size(), region);
+        memcpy(cell->text(), text.data(), text.size());
+        return fromCell(cell, _stringTag);
+    }
+
+    /// @brief Concatenates two strings into one new cell, without an intermediate copy
+    static Value concat(const Value& left, const Value& right, Region* region = nullptr)
+    {
+        string_view a = left.getText(), b = right.getText();
+        HeapCell* cell = HeapCell::allocate(a.size() + b.size(), region);
+        memcpy(cell->text(), a.data(), a.size());
+        memcpy(cell->text() + a.size(), b.data(), b.size());
+        return fromCell(cell, _stringTag);
+    }
+
+    /// @brief Makes the zero value of a data type ("" for strings)
+    static Value zero(KeyWordType type)
+    {
+        switch (type) {
+        case _float:
+            return fromFloat(0);
+        case _string:
+            return fromString("");
+        case _char:
+            return fromChar(0);
+        case _bool:
+            return fromBool(false);
+        default:
+            return fromInt(0);
+        }
+    }
+
+    /// @brief Checks whether both values are ints that fit inline, with one compare
+    static bool bothInts(const Value& left, const Value& right)
+    {
+        constexpr uint64_t intHigh = box(_intTag, 0) >> tagShift;
+        return ((left.bits >> tagShift) ^ intHigh) == 0 && ((right.bits >> tagShift) ^ intHigh) == 0;
+    }
+
+    /// @brief Gets the payload of an inline int without checking the tag
+    long long smallInt() const
+    {
+        return payload();
+    }
+
+    bool isFloat() const
+    {
+        return !isBoxed();
+    }
+
+    bool isString() const
+    {
+        return isBoxed() && tag() == _stringTag;
+    }
+
+    /// @brief Gets the HoLang type of the value
+    KeyWordType getType() const
+    {
+        if (!isBoxed())
+            return _float;
+        switch (tag()) {
+        case _charTag:
+            return _char;
+        case _boolTag:
+            return _bool;
+        case _stringTag:
+            return _string;
+        default:
+            return _int;
+        }
+    }
+
+    /// @brief Gets an int, char or bool as an integer (a float is truncated)
+    long long asInt() const
+    {
+        if (!isBoxed()) {
+            double value;
+            memcpy(&value, &bits, sizeof(value));
+            return (long long)value;
+        }
+        return tag() == _largeIntTag ? cell()->integer : payload();
+    }
+
+    /// @brief Gets the value as a number, converting integers to double
+    double asFloat() const
+    {
+        if (isBoxed())
+            return (double)asInt();
+        double value;
+        memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    /// @brief Gets the text of a string value
+    string_view getText() const
+    {
+        return string_view(cell()->text(), cell()->length);
+    }
+
+    /// @brief Gets the value as a truth value
+    bool isTrue() const
+    {
+        return isBoxed() ? asInt() != 0 : asFloat() != 0;
+    }
+
+    /// @brief Formats the value the way the REPL shows it
+    string toString() const
+    {
+        switch (getType()) {
+        case _float: {
+            ostringstream number;
+            number << asFloat();
+            return number.str();
+        }
+        case _string:
+            return "\"" + string(getText()) + "\"";
+        case _char:
+            return string("'") + (char)asInt() + "'";
+        case _bool:
+            return asInt() ? "true" : "false";
+        default:
+            return to_string(asInt());
+        }
+    }
+};
+
+static_assert(sizeof(Value) == 8, "a Value is one NaN-boxed word");